@@ -0,0 +1,62 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define BASE        0
+#define SHOULDER    1
+#define ELBOW       2
+#define WHRIST      3
+#define GRIPPER     4
+
+#define NO  0
+#define YES 1
+
+#define MIN_PULSE_WIDTH 600
+#define MAX_PULSE_WIDTH 2200
+
+#define ANGLE_MAP_SIZE  54  /* 3 x 3 grid, 6 levels */
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+    int   p;
+} coordinate_t;
+
+typedef struct {
+    float tn;
+    float j1;
+    float j2;
+    float j3;
+} arm_angles_t;
+
+typedef struct {
+    float           z_offset;
+    float           coxa;
+    float           fermur;
+    float           tibia;
+    coordinate_t    coord;
+    arm_angles_t    angles;
+    arm_angles_t*   angles_ptr;
+} arm_context_t;
+
+extern arm_angles_t angleMap[ANGLE_MAP_SIZE];
+
+uint8_t calculateAngles (arm_context_t& ctx);
+uint8_t findAnglesMap (arm_context_t& ctx);
+
+static inline int
+angleToPulseWidth (int angle) {
+	float notches = ((float)(MAX_PULSE_WIDTH - MIN_PULSE_WIDTH) / 180);
+    return notches * (float) angle + MIN_PULSE_WIDTH;
+}
+
+static inline int
+pulseWidthToAngle (int width) {
+    return (width - MIN_PULSE_WIDTH) * 180 / (MAX_PULSE_WIDTH - MIN_PULSE_WIDTH);
+}
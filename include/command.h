@@ -0,0 +1,90 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <semaphore.h>
+
+#define COORDINATE  1
+#define SERVO       2
+
+/*
+ * Control requests on the IPC socket are frames whose first byte is at
+ * least CONTROL_BASE; they are answered on the same connection instead of
+ * going to the motion thread.
+ */
+#define CONTROL_BASE        0x80
+#define CONTROL_TELEMETRY   0x80    /* reply: uint32_t ring size + SCM_RIGHTS fd */
+#define CONTROL_STATS       0x81    /* reply: latency histograms as JSON */
+#define CONTROL_TICKS       0x82    /* [path] reply: tick jitter as JSON, trace dumped to path */
+#define CONTROL_HISTORY     0x83    /* history_query_wire_t, reply: history as JSON, see query.h */
+#define CONTROL_PROFILE     0x84    /* profile_control_wire_t [path], reply: profiler state as JSON */
+
+#define COMMAND_RING_SIZE           64      /* must be a power of two */
+
+#define COMMAND_SOURCE_REDIS        0
+#define COMMAND_SOURCE_IPC          1
+
+/*
+ * Binary command as sent by local clients over the IPC socket. Every frame
+ * is a native-endian uint32_t payload length followed by this structure.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t     handler;    /* COORDINATE or SERVO */
+    uint8_t     id;         /* SERVO: servo id, 1 based */
+    int16_t     angle;      /* SERVO: target angle */
+    float       x;          /* COORDINATE */
+    float       y;
+    float       z;
+    int32_t     p;
+} command_wire_t;
+
+typedef struct {
+    uint8_t     handler;
+    uint8_t     source;
+    uint8_t     id;
+    int16_t     angle;
+    float       x;
+    float       y;
+    float       z;
+    int32_t     p;
+    uint64_t    receivedAt;     /* CLOCK_MONOTONIC ns, see stats.h */
+    uint64_t    parsedAt;
+    uint64_t    enqueuedAt;
+} command_t;
+
+bool commandFromJson (const char* json, command_t& cmd);
+bool commandFromWire (const unsigned char* data, uint32_t len, command_t& cmd);
+void commandToWire (const command_t& cmd, command_wire_t& wire);
+void servoMsgFactory (char* buffer, int id, int angle);
+
+/*
+ * Bounded multi-producer, single-consumer queue between the ingress threads
+ * (Redis subscriber, IPC server) and the motion thread. Producers never
+ * block; push fails when the ring is full.
+ */
+class CommandRing {
+    public:
+        CommandRing ();
+        ~CommandRing ();
+
+        bool push (const command_t& cmd);
+        bool pop (command_t& cmd);
+        void wait ();
+        bool wait (int timeoutMs);
+        uint32_t depth ();
+
+    private:
+        typedef struct {
+            volatile uint32_t   sequence;
+            command_t           cmd;
+        } slot_t;
+
+        slot_t              slots[COMMAND_RING_SIZE];
+        volatile uint32_t   head;
+        volatile uint32_t   tail;
+        sem_t               ready;
+};
@@ -0,0 +1,195 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#define HISTORY_MAGIC           0x53484252  /* "RBHS" */
+#define HISTORY_VERSION         3
+#define HISTORY_SEGMENT_ROWS    65536
+#define HISTORY_SEGMENT_NS      (3600ULL * 1000000000ULL)   /* rotate at least hourly */
+#define HISTORY_MAX_SEGMENTS    720                         /* oldest are deleted */
+#define HISTORY_MAX_MAPPED      8                           /* read-only mappings kept, LRU */
+#define HISTORY_SUFFIX          ".rbh"
+
+#define HISTORY_ROLLUP_MINUTE   0
+#define HISTORY_ROLLUP_SECOND   1
+#define HISTORY_ROLLUP_LEVELS   2
+#define HISTORY_ROLLUP_NS       (60ULL * 1000000000ULL)     /* coarsest level */
+#define HISTORY_ROLLUP_SLOTS    (HISTORY_SEGMENT_NS / HISTORY_ROLLUP_NS + 1)
+
+#define HISTORY_ROLLUP_RETRIES  4096    /* reads of a slot that stays mid-update */
+
+/* HistorySegment::rollup results */
+#define HISTORY_ROLLUP_EMPTY        0
+#define HISTORY_ROLLUP_READY        1
+#define HISTORY_ROLLUP_UNAVAILABLE  2   /* left mid-update, use the rows */
+
+#define HISTORY_OK              0   /* command carried out */
+#define HISTORY_REJECTED        1   /* unreachable coordinate, bad servo id */
+
+#define HISTORY_COL_TIMESTAMP   0   /* uint64_t, CLOCK_REALTIME ns */
+#define HISTORY_COL_HANDLER     1   /* uint8_t */
+#define HISTORY_COL_OUTCOME     2   /* uint8_t */
+#define HISTORY_COL_X           3   /* float, target */
+#define HISTORY_COL_Y           4
+#define HISTORY_COL_Z           5
+#define HISTORY_COL_P           6   /* int32_t */
+#define HISTORY_COL_ANGLE       7   /* int16_t x 4 joints, columns 7 to 10 */
+#define HISTORY_COL_LATENCY     11  /* uint32_t us, receipt to command done */
+#define HISTORY_COLUMNS         12
+
+typedef struct {
+    uint64_t    timestamp;
+    uint8_t     handler;
+    uint8_t     outcome;
+    float       x;
+    float       y;
+    float       z;
+    int32_t     p;
+    int16_t     angles[4];
+    uint32_t    latencyUs;
+} history_row_t;
+
+/*
+ * Running aggregate over a set of rows: what rollups store and what
+ * downsampling returns per bucket.
+ */
+typedef struct {
+    uint32_t    count;
+    uint32_t    ok;
+    uint32_t    rejected;
+    uint32_t    latencyMaxUs;
+    uint64_t    latencySumUs;
+    int16_t     min[4];
+    int16_t     max[4];
+    int64_t     sum[4];
+} history_aggregate_t;
+
+typedef struct {
+    volatile uint32_t       sequence;   /* odd while the writer updates it */
+    uint32_t                reserved;
+    history_aggregate_t     aggregate;
+} history_rollup_t;
+
+uint64_t historyRollupNanos (int level);
+uint32_t historyRollupSlots (int level);
+
+void historyAggregateReset (history_aggregate_t& a);
+void historyAggregateAdd (history_aggregate_t& a, const history_row_t& row);
+void historyAggregateMerge (history_aggregate_t& a, const history_aggregate_t& b);
+
+/*
+ * A segment is one file: this header, then one fixed-capacity array per
+ * column. The file is sized for HISTORY_SEGMENT_ROWS up front (sparse on
+ * disk) and mapped, so appending is plain stores into the columns followed
+ * by a release store of rows; readers in any process map it read-only and
+ * see every row below rows. Timestamps only grow within a segment, so the
+ * timestamp column is its own time index.
+ *
+ * After the columns come the rollups, updated on every append: per minute,
+ * slot n covering minute rollupBase + n, and per second, slot n covering
+ * second rollupBase * 60 + n.
+ */
+typedef struct {
+    uint32_t            magic;
+    uint16_t            version;
+    uint16_t            columns;
+    uint32_t            capacity;
+    volatile uint32_t   rows;
+    uint64_t            firstTimestamp;
+    volatile uint64_t   lastTimestamp;
+    uint64_t            offsets[HISTORY_COLUMNS];
+    uint64_t            rollupOffsets[HISTORY_ROLLUP_LEVELS];
+    uint64_t            rollupBase;     /* firstTimestamp / HISTORY_ROLLUP_NS */
+    uint8_t             reserved[256 - 32 - (HISTORY_COLUMNS + HISTORY_ROLLUP_LEVELS + 1) * 8];
+} history_header_t;
+
+#if __cplusplus >= 201103L
+static_assert (sizeof (history_header_t) == 256, "history_header_t is part of the segment format");
+#else
+typedef char history_header_size_check[(sizeof (history_header_t) == 256) ? 1 : -1];
+#endif
+
+class HistorySegment {
+    public:
+        HistorySegment ();
+        ~HistorySegment ();
+
+        bool create (const std::string& path, uint64_t firstTimestamp);
+        bool open (const std::string& path, bool writable);
+        void close ();
+
+        bool append (const history_row_t& row);
+        void read (uint32_t index, history_row_t& row);
+        uint32_t lowerBound (uint64_t timestamp);
+        int rollup (int level, uint32_t slot, history_aggregate_t& aggregate);
+        uint32_t repairRollups ();
+        uint64_t rollupStart (int level);
+
+        uint32_t rows ();
+        uint32_t capacity ();
+        uint64_t firstTimestamp ();
+        uint64_t lastTimestamp ();
+        const void* column (int column);
+        const std::string& getPath ();
+
+    private:
+        bool map (int fd, size_t size, bool writable);
+
+        std::string         path;
+        history_header_t*   header;
+        unsigned char*      base;
+        size_t              size;
+        bool                writable;
+};
+
+typedef void (*history_row_callback_t) (const history_row_t& row, void* priv);
+
+typedef struct {
+    uint64_t        firstTimestamp;
+    std::string     path;
+} history_segment_info_t;
+
+/*
+ * The set of segments in one directory, ordered by first timestamp (which
+ * is also the file name). One writer process appends to the newest
+ * segment and rotates; any number of readers can open the same directory.
+ * Besides the segment being written, at most HISTORY_MAX_MAPPED segments
+ * stay mapped, the least recently used are unmapped, so a pointer from
+ * segment () is only good until the next call.
+ */
+class MotionHistory {
+    public:
+        MotionHistory ();
+        ~MotionHistory ();
+
+        bool open (const std::string& dir, bool writable);
+        bool append (history_row_t& row);
+        uint64_t scan (uint64_t from, uint64_t to, history_row_callback_t callback, void* priv);
+        void refresh ();
+
+        const std::vector<history_segment_info_t>& segments ();
+        HistorySegment* segment (size_t index);
+
+    private:
+        bool rotate (uint64_t timestamp);
+        uint64_t lastTimestamp ();
+        void unmapIdle ();
+
+        std::string                         dir;
+        bool                                writable;
+        std::vector<history_segment_info_t> index;
+        std::vector<HistorySegment*>        mapped;
+        std::vector<uint64_t>               lastUse;
+        uint64_t                            uses;
+        HistorySegment*                     current;
+};
+
+uint64_t historyNow ();
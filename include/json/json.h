@@ -127,6 +127,9 @@ license you like.
 /// std::map
 /// as Value container.
 //#  define JSON_USE_CPPTL_SMALLMAP 1
+/// If defined, indicates that Json::FlatMap (a sorted vector with a hash index
+/// for large objects) should be used instead of std::map as Value container.
+//#  define JSON_USE_FLAT_MAP 1
 /// If defined, indicates that Json specific container should be used
 /// (hash table & simple deque container with customizable allocator).
 /// THIS FEATURE IS STILL EXPERIMENTAL! There is know bugs: See #3177332
@@ -199,6 +202,23 @@ license you like.
 #define JSONCPP_DEPRECATED(message)
 #endif // if !defined(JSONCPP_DEPRECATED)
 
+/// If non-zero, Value and its internals can be moved instead of deep copied.
+#ifndef JSON_HAS_RVALUE_REFERENCES
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#define JSON_HAS_RVALUE_REFERENCES 1
+#else
+#define JSON_HAS_RVALUE_REFERENCES 0
+#endif
+#endif // ifndef JSON_HAS_RVALUE_REFERENCES
+
+// Move constructors must not throw, or std::vector copies instead of moving
+// when it grows.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+#define JSONCPP_NOEXCEPT noexcept
+#else
+#define JSONCPP_NOEXCEPT throw()
+#endif
+
 namespace Json {
 typedef int Int;
 typedef unsigned int UInt;
@@ -375,6 +395,8 @@ public:
 #if !defined(JSON_IS_AMALGAMATION)
 #include "forwards.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
+#include <cstddef>
+#include <new>
 #include <string>
 #include <vector>
 
@@ -383,6 +405,9 @@ public:
 #else
 #include <cpptl/smallmap.h>
 #endif
+#ifdef JSON_USE_FLAT_MAP
+#include <algorithm>
+#endif
 #ifdef JSON_USE_CPPTL
 #include <cpptl/forwards.h>
 #endif
@@ -450,6 +475,304 @@ private:
   const char* str_;
 };
 
+/** \brief Where the storage of Value trees comes from.
+ *
+ * Object and array storage, long strings, member names that are not
+ * interned, and comments are taken from the current thread's allocator
+ * (see ValueAllocatorScope), by default system(). Every block remembers the
+ * allocator it came from and goes back to it, whichever thread or scope
+ * frees it, so Values built under different allocators can be mixed.
+ *
+ * Implementations get the size of each block back in release(); they must
+ * return memory aligned for a double.
+ */
+class JSON_API ValueAllocator {
+public:
+  virtual ~ValueAllocator();
+
+  virtual void* allocate(size_t size) = 0;
+  virtual void release(void* memory, size_t size) = 0;
+
+  /// malloc() and free().
+  static ValueAllocator* system();
+  /// The calling thread's pool: size classes of up to 1 KB served from
+  /// free lists, larger blocks from malloc(). Blocks freed by other threads
+  /// are handed back to the owning thread. Pools keep the memory they have
+  /// carved; the pool of a thread that exits goes to the next new one.
+  static ValueAllocator* threadPool();
+  /// The allocator Values created on this thread use now.
+  static ValueAllocator* current();
+
+  /// A block from current(), tagged with its owner. Throws std::bad_alloc.
+  static void* allocateBlock(size_t size);
+  /// Returns a block from allocateBlock() to its owner. Accepts 0.
+  static void releaseBlock(void* memory);
+};
+
+/** \brief Makes allocator current() on this thread until the scope ends.
+ *
+ * \code
+ * Json::ValueArena arena;
+ * {
+ *   Json::ValueAllocatorScope scope(&arena);
+ *   Json::Value& doc = *arena.newValue();
+ *   reader.parse(text, doc);
+ *   ...
+ * }
+ * arena.reset(); // the whole document, in one go
+ * \endcode
+ */
+class JSON_API ValueAllocatorScope {
+public:
+  explicit ValueAllocatorScope(ValueAllocator* allocator);
+  ~ValueAllocatorScope();
+
+private:
+  ValueAllocatorScope(const ValueAllocatorScope&);
+  ValueAllocatorScope& operator=(const ValueAllocatorScope&);
+
+  ValueAllocator* previous_;
+};
+
+/** \brief Monotonic arena for Value trees that die together.
+ *
+ * allocate() bumps a pointer through blocks of blockSize bytes and
+ * release() does nothing; reset() frees everything at once. Values made with
+ * newValue() are never destroyed, so a document built in one with the arena
+ * current is torn down by reset() without walking it. Anything else from
+ * the arena must be gone by then. Not thread safe.
+ */
+class JSON_API ValueArena : public ValueAllocator {
+public:
+  explicit ValueArena(size_t blockSize = 16384);
+  virtual ~ValueArena();
+
+  virtual void* allocate(size_t size);
+  virtual void release(void* memory, size_t size);
+
+  /// A Value living in the arena until reset().
+  Value* newValue();
+  /// Frees all blocks but the first, which is kept for reuse.
+  void reset();
+  /// Bytes handed out since the last reset().
+  size_t used() const;
+
+private:
+  ValueArena(const ValueArena&);
+  ValueArena& operator=(const ValueArena&);
+
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  Block* blocks_;
+  char* current_;
+  char* end_;
+  size_t blockSize_;
+  size_t used_;
+};
+
+/** \brief Standard allocator over ValueAllocator::allocateBlock(), for the
+ * containers inside Values. Stateless: any instance frees any block.
+ */
+template <class T> class ValueStlAllocator {
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <class U> struct rebind { typedef ValueStlAllocator<U> other; };
+
+  ValueStlAllocator() {}
+  template <class U> ValueStlAllocator(const ValueStlAllocator<U>&) {}
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+  pointer allocate(size_type count, const void* = 0) {
+    return static_cast<pointer>(
+        ValueAllocator::allocateBlock(count * sizeof(T)));
+  }
+  void deallocate(pointer memory, size_type) {
+    ValueAllocator::releaseBlock(memory);
+  }
+  size_type max_size() const { return size_t(-1) / sizeof(T) / 2; }
+  void construct(pointer memory, const T& value) { new (memory) T(value); }
+  void destroy(pointer memory) { memory->~T(); }
+#if JSON_HAS_RVALUE_REFERENCES
+  template <class U, class... Args> void construct(U* memory, Args&&... args) {
+    new (memory) U(static_cast<Args&&>(args)...);
+  }
+  template <class U> void destroy(U* memory) { memory->~U(); }
+#endif
+
+  template <class U> bool operator==(const ValueStlAllocator<U>&) const {
+    return true;
+  }
+  template <class U> bool operator!=(const ValueStlAllocator<U>&) const {
+    return false;
+  }
+};
+
+#ifdef JSON_USE_FLAT_MAP
+/// Objects with at least this many members get a hash index.
+#ifndef JSON_FLAT_MAP_HASH_THRESHOLD
+#define JSON_FLAT_MAP_HASH_THRESHOLD 16
+#endif
+/// Room made on the first insert, enough for a typical message in one go.
+#ifndef JSON_FLAT_MAP_INITIAL_CAPACITY
+#define JSON_FLAT_MAP_INITIAL_CAPACITY 8
+#endif
+
+/** \brief Map used as Value::ObjectValues when JSON_USE_FLAT_MAP is defined.
+ *
+ * Members are kept in one contiguous array in key order, so a small object
+ * costs a single allocation and a lookup touches a few cache lines instead of
+ * chasing tree nodes. Once an object reaches JSON_FLAT_MAP_HASH_THRESHOLD
+ * members an open-addressing table of positions, keyed by Key::hash(), makes
+ * find() constant time. Iteration is in key order, as with std::map.
+ *
+ * Only the part of the std::map interface Value needs is provided. Unlike
+ * std::map, inserting into or erasing from an object invalidates iterators
+ * and references to that object's members.
+ */
+template <class Key, class T, class Allocator> class FlatMap {
+public:
+  typedef Key key_type;
+  typedef T mapped_type;
+  typedef std::pair<Key, T> value_type;
+
+private:
+  typedef std::vector<
+      value_type,
+      typename Allocator::template rebind<value_type>::other> Items;
+  typedef std::vector<
+      unsigned int,
+      typename Allocator::template rebind<unsigned int>::other> Index;
+
+public:
+  typedef typename Items::iterator iterator;
+  typedef typename Items::const_iterator const_iterator;
+  typedef typename Items::size_type size_type;
+
+  iterator begin() { return items_.begin(); }
+  iterator end() { return items_.end(); }
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+  size_type size() const { return items_.size(); }
+  bool empty() const { return items_.empty(); }
+
+  void clear() {
+    items_.clear();
+    index_.clear();
+  }
+
+  iterator lower_bound(const Key& key) {
+    return std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+  }
+  iterator find(const Key& key) { return items_.begin() + position(key); }
+  const_iterator find(const Key& key) const {
+    return items_.begin() + position(key);
+  }
+
+  /// hint must be lower_bound(value.first), as Value always passes.
+  iterator insert(iterator hint, const value_type& value) {
+    return insertAt(hint - items_.begin(), value);
+  }
+#if JSON_HAS_RVALUE_REFERENCES
+  iterator emplace_hint(iterator hint, const Key& key, T&& value) {
+    return insertAt(hint - items_.begin(), value_type(key, std::move(value)));
+  }
+#endif
+
+  void erase(iterator it) {
+    items_.erase(it);
+    reindex();
+  }
+  size_type erase(const Key& key) {
+    size_type at = position(key);
+    if (at == items_.size())
+      return 0;
+    erase(items_.begin() + at);
+    return 1;
+  }
+
+  bool operator==(const FlatMap& other) const { return items_ == other.items_; }
+  bool operator<(const FlatMap& other) const { return items_ < other.items_; }
+
+private:
+  struct KeyLess {
+    bool operator()(const value_type& item, const Key& key) const {
+      return item.first < key;
+    }
+  };
+
+#if JSON_HAS_RVALUE_REFERENCES
+  iterator insertAt(size_type at, value_type&& value) {
+    if (items_.capacity() == 0)
+      items_.reserve(JSON_FLAT_MAP_INITIAL_CAPACITY);
+    items_.insert(items_.begin() + at, std::move(value));
+#else
+  iterator insertAt(size_type at, const value_type& value) {
+    if (items_.capacity() == 0)
+      items_.reserve(JSON_FLAT_MAP_INITIAL_CAPACITY);
+    items_.insert(items_.begin() + at, value);
+#endif
+    // Appends, the common case for arrays and sorted input, keep the index.
+    if (at + 1 == items_.size() && !index_.empty() &&
+        items_.size() * 2 <= index_.size())
+      indexAdd(at);
+    else
+      reindex();
+    return items_.begin() + at;
+  }
+
+  /// Position of key, or size() when it is not there.
+  size_type position(const Key& key) const {
+    if (index_.empty()) {
+      const_iterator it =
+          std::lower_bound(items_.begin(), items_.end(), key, KeyLess());
+      return (it != items_.end() && it->first == key) ? it - items_.begin()
+                                                      : items_.size();
+    }
+    size_type mask = index_.size() - 1;
+    for (size_type slot = key.hash() & mask;; slot = (slot + 1) & mask) {
+      if (index_[slot] == 0)
+        return items_.size();
+      if (items_[index_[slot] - 1].first == key)
+        return index_[slot] - 1;
+    }
+  }
+
+  void indexAdd(size_type at) {
+    size_type mask = index_.size() - 1;
+    size_type slot = items_[at].first.hash() & mask;
+    while (index_[slot] != 0)
+      slot = (slot + 1) & mask;
+    index_[slot] = (unsigned int)(at + 1);
+  }
+
+  void reindex() {
+    index_.clear();
+    if (items_.size() < JSON_FLAT_MAP_HASH_THRESHOLD)
+      return;
+    size_type slots = 2 * JSON_FLAT_MAP_HASH_THRESHOLD;
+    while (slots < items_.size() * 4)
+      slots *= 2;
+    index_.resize(slots, 0);
+    for (size_type at = 0; at < items_.size(); ++at)
+      indexAdd(at);
+  }
+
+  Items items_;
+  Index index_; // position + 1 per slot, 0 when free
+};
+#endif // ifdef JSON_USE_FLAT_MAP
+
 /** \brief Represents a <a HREF="http://www.json.org">JSON</a> value.
  *
  * This class is a discriminated union wrapper that can represents a:
@@ -481,6 +804,7 @@ private:
  */
 class JSON_API Value {
   friend class ValueIteratorBase;
+  friend class Path;
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   friend class ValueInternalLink;
   friend class ValueInternalMap;
@@ -531,11 +855,17 @@ private:
     enum DuplicationPolicy {
       noDuplication = 0,
       duplicate,
-      duplicateOnCopy
+      duplicateOnCopy,
+      interned // shared, immortal copy from the key intern table
     };
     CZString(ArrayIndex index);
     CZString(const char* cstr, DuplicationPolicy allocate);
+    /// A key whose hash is already known; noDuplication or interned only.
+    CZString(const char* cstr, unsigned int hash, DuplicationPolicy allocate);
     CZString(const CZString& other);
+#if JSON_HAS_RVALUE_REFERENCES
+    CZString(CZString&& other) JSONCPP_NOEXCEPT;
+#endif
     ~CZString();
     CZString& operator=(CZString other);
     bool operator<(const CZString& other) const;
@@ -543,16 +873,25 @@ private:
     ArrayIndex index() const;
     const char* c_str() const;
     bool isStaticString() const;
+    unsigned int hash() const;
 
   private:
     void swap(CZString& other);
+    void own();
     const char* cstr_;
     ArrayIndex index_;
+    unsigned int hash_;
   };
 
 public:
-#ifndef JSON_USE_CPPTL_SMALLMAP
-  typedef std::map<CZString, Value> ObjectValues;
+#if defined(JSON_USE_FLAT_MAP)
+  typedef FlatMap<CZString, Value, ValueStlAllocator<Value> > ObjectValues;
+#elif !defined(JSON_USE_CPPTL_SMALLMAP)
+  typedef std::map<CZString,
+                   Value,
+                   std::less<CZString>,
+                   ValueStlAllocator<std::pair<const CZString, Value> > >
+      ObjectValues;
 #else
   typedef CppTL::SmallMap<CZString, Value> ObjectValues;
 #endif // ifndef JSON_USE_CPPTL_SMALLMAP
@@ -602,8 +941,14 @@ Json::Value obj_value(Json::objectValue); // {}
 #endif
   Value(bool value);
   Value(const Value& other);
+#if JSON_HAS_RVALUE_REFERENCES
+  /// Takes over the other value's storage and comments, leaving it null.
+  Value(Value&& other) JSONCPP_NOEXCEPT;
+#endif
   ~Value();
 
+  /// Copies or takes over other, comments included: FlatMap shifts members
+  /// by assignment, and their comments have to move with them.
   Value& operator=(Value other);
   /// Swap values.
   /// \note Currently, comments are intentionally not swapped, for
@@ -712,6 +1057,9 @@ Json::Value obj_value(Json::objectValue); // {}
   ///
   /// Equivalent to jsonvalue[jsonvalue.size()] = value;
   Value& append(const Value& value);
+#if JSON_HAS_RVALUE_REFERENCES
+  Value& append(Value&& value);
+#endif
 
   /// Access an object value by name, create a null member if it does not exist.
   Value& operator[](const char* key);
@@ -807,6 +1155,15 @@ Json::Value obj_value(Json::objectValue); // {}
 
 private:
   Value& resolveReference(const char* key, bool isStatic);
+  void setString(const char* value, unsigned int length);
+  /// The member named key, or 0. hash is key's, as PathArgument keeps it;
+  /// interned says key is the intern table's copy.
+  const Value* findMember(const char* key, unsigned int hash,
+                          bool interned) const;
+
+  inline const char* stringData() const {
+    return inlineString_ ? value_.chars_ : value_.string_;
+  }
 
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   inline bool isItemAvailable() const { return itemIsUsed_ == 0; }
@@ -845,6 +1202,7 @@ private:
     double real_;
     bool bool_;
     char* string_;
+    char chars_[sizeof(LargestUInt)]; // short strings, see inlineString_
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
     ValueInternalArray* array_;
     ValueInternalMap* map_;
@@ -854,6 +1212,7 @@ private:
   } value_;
   ValueType type_ : 8;
   int allocated_ : 1; // Notes: if declared as bool, bitfield is useless.
+  unsigned int inlineString_ : 1; // string is held in value_.chars_
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
   unsigned int itemIsUsed_ : 1; // used by the ValueInternalMap container.
   int memberNameIsStatic_ : 1;  // used by the ValueInternalMap container.
@@ -866,8 +1225,11 @@ private:
   size_t limit_;
 };
 
-/** \brief Experimental and untested: represents an element of the "path" to
- * access a node.
+/** \brief Represents an element of the "path" to access a node.
+ *
+ * A key is hashed, and interned while the intern table has room, when the
+ * argument is made, so lookups along a path never hash or compare it
+ * again more than they must.
  */
 class JSON_API PathArgument {
 public:
@@ -884,12 +1246,21 @@ private:
     kindIndex,
     kindKey
   };
+
+  void compileKey();
+
   std::string key_;
   ArrayIndex index_;
   Kind kind_;
+  const char* name_;  // the interned copy of key_, or 0
+  unsigned int hash_; // of key_
 };
 
-/** \brief Experimental and untested: represents a "path" to access a node.
+/** \brief Represents a "path" to access a node.
+ *
+ * The path string is parsed once, when the Path is made; find() and
+ * resolve() then walk the compiled arguments without allocating. Keep
+ * Paths that are used again, or get them from a PathCache.
  *
  * Syntax:
  * - "." => root node
@@ -909,6 +1280,10 @@ public:
        const PathArgument& a4 = PathArgument(),
        const PathArgument& a5 = PathArgument());
 
+  /// The node at the path, or 0 when some part of it does not exist or
+  /// the path is invalid: malformed, or a % without a matching argument.
+  const Value* find(const Value& root) const;
+  /// The node at the path, or Value::null.
   const Value& resolve(const Value& root) const;
   Value resolve(const Value& root, const Value& defaultValue) const;
   /// Creates the "path" to access the specified node and returns a reference on
@@ -929,6 +1304,35 @@ private:
   Args args_;
 };
 
+/** \brief Compiled Paths by path string, for lookups repeated with the same
+ * few paths, such as configuration keys or command dispatch.
+ *
+ * Direct mapped: a path string hashes to one of the slots and a miss
+ * compiles it into that slot, replacing the path that was there. A hit
+ * allocates nothing. There is no way to pass % arguments, so a path with
+ * % finds nothing. Not thread safe; give each thread its own cache.
+ */
+class JSON_API PathCache {
+public:
+  explicit PathCache(unsigned int slots = 64);
+
+  /// The compiled path, valid until the next get().
+  const Path& get(const char* path);
+  const Path& get(const std::string& path);
+
+private:
+  struct Entry {
+    Entry();
+
+    std::string text;
+    Path path;
+  };
+
+  const Path& get(const char* path, size_t length);
+
+  std::vector<Entry> entries_;
+};
+
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
 /** \brief Allocator to customize Value internal map.
  * Below is an example of a simple implementation (default implementation
@@ -1682,6 +2086,258 @@ private:
   std::string commentsBefore_;
   Features features_;
   bool collectComments_;
+
+  friend class EventReader;
+  friend class LazyDocument;
+};
+
+/** \brief Receives the events of an EventReader.
+ *
+ * Each callback returns \c true to go on or \c false to stop parsing.
+ * Strings and member names arrive as [begin, end) UTF-8 byte ranges that
+ * are only valid during the call. The default implementations ignore the
+ * event.
+ */
+class JSON_API ReaderHandler {
+public:
+  virtual ~ReaderHandler();
+
+  virtual bool onStartObject();
+  virtual bool onKey(const char* begin, const char* end);
+  virtual bool onEndObject();
+  virtual bool onStartArray();
+  virtual bool onEndArray();
+  virtual bool onString(const char* begin, const char* end);
+  virtual bool onInt(LargestInt value);
+  virtual bool onUInt(LargestUInt value);
+  virtual bool onReal(double value);
+  virtual bool onBool(bool value);
+  virtual bool onNull();
+};
+
+/** \brief Incremental, event based <a HREF="http://www.json.org">JSON</a>
+ * parser.
+ *
+ * Where Reader builds a Value tree, this calls a ReaderHandler for each
+ * value as it is read and builds nothing. The document may arrive in
+ * pieces of any size, as read from a socket:
+ * \code
+ * Json::EventReader reader(handler);
+ * while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+ *   if (!reader.feed(buffer, buffer + n))
+ *     break;
+ * if (!reader.finish())
+ *   std::cerr << reader.getFormattedErrorMessages();
+ * \endcode
+ * Only a token that straddles two pieces is copied. Nesting is tracked on
+ * the heap, one byte per level, so deep documents do not recurse. Strings
+ * and numbers are decoded exactly as Reader does; comments are skipped when
+ * the features allow them.
+ */
+class JSON_API EventReader {
+public:
+  EventReader(ReaderHandler& handler);
+  EventReader(ReaderHandler& handler, const Features& features);
+
+  /** \brief Parses the next piece of the document.
+   * \return \c false once the document is found invalid or the handler
+   *         stopped it; later calls do nothing and return \c false too.
+   */
+  bool feed(const char* begin, const char* end);
+
+  /** \brief Ends the input.
+   * \return \c true if exactly one complete document was read.
+   */
+  bool finish();
+
+  /// \brief Gets ready for a new document.
+  void reset();
+
+  /** \brief The error that stopped parsing, formatted like
+   * Reader::getFormattedErrorMessages(). Empty if there was none.
+   */
+  std::string getFormattedErrorMessages() const;
+
+private:
+  enum State {
+    stateValue,      // a value must follow
+    stateFirstValue, // after '[', a value or ']'
+    stateFirstKey,   // after '{', a member name or '}'
+    stateKey,        // after ',' in an object
+    stateColon,      // after a member name
+    stateNext,       // after a member or element, ',' or the closing bracket
+    stateDone,       // after the root value
+    stateError
+  };
+
+  enum Pending {
+    pendingNone = 0,
+    pendingString,
+    pendingNumber,
+    pendingLiteral,
+    pendingCommentStart, // '/'
+    pendingCStyleComment,
+    pendingCppStyleComment
+  };
+
+  const char* scan(const char* current, const char* end);
+  const char* scanString(const char* current, const char* end);
+  const char* scanWord(const char* current, const char* end);
+  const char* scanComment(const char* current, const char* end);
+  const char* startValue(char c, const char* current, const char* end);
+  void startToken(Pending kind, const char* current);
+  size_t offsetOf(const char* location) const;
+  bool emitString(const char* begin, const char* end);
+  bool emitNumber(const char* begin, const char* end);
+  bool emitLiteral(const char* begin, const char* end);
+  bool endContainer(char c);
+  bool valueDone();
+  bool handled(bool result);
+  bool fail(const std::string& message);
+  bool failDecoding();
+
+  ReaderHandler& handler_;
+  Reader decoder_;
+  std::vector<char> stack_;
+  std::string pending_;
+  std::string decoded_;
+  std::string error_;
+  State state_;
+  Pending pendingKind_;
+  bool pendingIsKey_;
+  bool escaped_;
+  bool sawEscape_;
+  bool sawStar_;
+  const char* piece_;      // start of the piece being fed
+  const char* tokenStart_; // in the piece, 0 once the token is in pending_
+  size_t offset_;      // of the start of the current piece
+  size_t tokenOffset_; // of the token being read
+  size_t line_;
+  size_t lineStart_;
+};
+
+class LazyDocument;
+
+/** \brief A value inside a LazyDocument.
+ *
+ * A small handle: copying it copies two words. Member and element lookups
+ * walk the document's index; scalars are decoded the first time one of the
+ * as*() functions, type() or get() asks for them and cached in the
+ * document. Conversions follow Value's. A handle to a missing member
+ * behaves as null. Handles are only valid while the document and its input
+ * are, and, since decoding updates the document, a document should only be
+ * read from one thread at a time.
+ */
+class JSON_API LazyValue {
+public:
+  LazyValue();
+
+  ValueType type() const;
+  bool isNull() const;
+  bool isBool() const;
+  bool isNumeric() const;
+  bool isString() const;
+  bool isArray() const;
+  bool isObject() const;
+
+  /// Members of an object or elements of an array, 0 for anything else.
+  ArrayIndex size() const;
+  bool isMember(const char* key) const;
+  bool isMember(const std::string& key) const;
+  /// The member, or a missing value that reads as null.
+  LazyValue operator[](const char* key) const;
+  LazyValue operator[](const std::string& key) const;
+  /// The element, or a missing value that reads as null. Linear in index.
+  LazyValue operator[](ArrayIndex index) const;
+  LazyValue operator[](int index) const;
+  /// Like Value::get(): the member decoded, or defaultValue.
+  Value get(const char* key, const Value& defaultValue) const;
+  Value get(const std::string& key, const Value& defaultValue) const;
+
+  std::string asString() const;
+  Value::Int asInt() const;
+  Value::UInt asUInt() const;
+#if defined(JSON_HAS_INT64)
+  Value::Int64 asInt64() const;
+  Value::UInt64 asUInt64() const;
+#endif
+  LargestInt asLargestInt() const;
+  LargestUInt asLargestUInt() const;
+  float asFloat() const;
+  double asDouble() const;
+  bool asBool() const;
+
+  /// Decodes the whole subtree into a Value.
+  Value toValue() const;
+
+private:
+  friend class LazyDocument;
+
+  LazyValue(const LazyDocument* document, unsigned int node);
+  const Value& scalar() const;
+
+  const LazyDocument* document_;
+  unsigned int node_;
+};
+
+/** \brief Parses <a HREF="http://www.json.org">JSON</a> on demand.
+ *
+ * parse() only checks the structure and records where each value lies in
+ * the input; strings and numbers are decoded when a LazyValue is read, so a
+ * caller that reads three fields of a large message pays for three fields.
+ * The input is not copied and must outlive the document and its values.
+ * Accepts strict JSON only: no comments, no leading zeros, and numbers are
+ * checked against the grammar. A document can be reused; its buffers are
+ * kept between parses.
+ */
+class JSON_API LazyDocument {
+public:
+  LazyDocument();
+
+  bool parse(const char* begin, const char* end);
+  LazyValue root() const;
+
+  /// The error of the last parse() formatted like
+  /// Reader::getFormattedErrorMessages(), or an empty string.
+  std::string getFormattedErrorMessages() const;
+
+private:
+  friend class LazyValue;
+
+  enum Kind {
+    kindNull = 0,
+    kindFalse,
+    kindTrue,
+    kindNumber,
+    kindString,
+    kindArray,
+    kindObject
+  };
+
+  // One per value and per member name, in document order. A container's
+  // children follow it; next skips the whole subtree.
+  struct Node {
+    unsigned int start;   // offset of the first byte
+    unsigned int end;     // offset past the last byte
+    unsigned int next;    // index of the node after this subtree
+    unsigned int parent;  // while parsing: the enclosing container
+    unsigned int size;    // children of a container; 1 for an escaped string
+    unsigned int decoded; // 1 + index into decoded_, 0 until decoded
+    unsigned char kind;
+  };
+
+  unsigned int push(Kind kind, const char* start);
+  void close(unsigned int node, const char* end);
+  bool fail(const char* location, const char* message);
+  unsigned int find(unsigned int object, const char* key, size_t length) const;
+  const Value& decode(unsigned int node) const;
+  Value materialize(unsigned int node) const;
+
+  const char* begin_;
+  const char* end_;
+  std::vector<Node> nodes_;
+  mutable std::vector<Value> decoded_;
+  std::string error_;
 };
 
 /** \brief Read from 'sin' into 'root'.
@@ -1756,6 +2412,70 @@ namespace Json {
 
 class Value;
 
+/** \brief A reusable chain of output chunks for writers.
+ *
+ * Writers append to the last chunk and start a new, larger one when it is
+ * full, so nothing written is ever moved or copied again. clear() keeps the
+ * chunks: once a buffer has held a document of some size, writing another
+ * one like it allocates nothing. The chunks can be handed to writev() or
+ * sendmsg() as they are with toIovec().
+ */
+class JSON_API OutputBuffer {
+public:
+  OutputBuffer();
+  ~OutputBuffer();
+
+  /// Drops the contents but keeps the chunks for reuse.
+  void clear();
+  size_t size() const;
+  bool empty() const;
+
+  void append(const char* data, size_t length);
+  void append(char c);
+  /// Returns room for at least length contiguous bytes at the end;
+  /// commit() then adds the ones actually written.
+  char* reserve(size_t length);
+  void commit(size_t length);
+  /// Drops everything past the first size bytes, keeping the chunks.
+  void truncate(size_t size);
+
+  /// Chunks holding data, in order.
+  size_t chunkCount() const;
+  const char* chunkData(size_t index) const;
+  size_t chunkSize(size_t index) const;
+
+  /// Fills up to max entries of anything with iov_base and iov_len members
+  /// (struct iovec) with the chunks. Returns the number of entries filled.
+  template <typename IoVec> size_t toIovec(IoVec* iov, size_t max) const {
+    size_t count = chunkCount();
+    if (count > max)
+      count = max;
+    for (size_t index = 0; index < count; ++index) {
+      iov[index].iov_base = const_cast<char*>(chunks_[index].data);
+      iov[index].iov_len = chunks_[index].size;
+    }
+    return count;
+  }
+
+  std::string toString() const;
+
+private:
+  OutputBuffer(const OutputBuffer&);
+  OutputBuffer& operator=(const OutputBuffer&);
+
+  struct Chunk {
+    char* data;
+    size_t size;
+    size_t capacity;
+  };
+
+  char* grow(size_t length);
+
+  std::vector<Chunk> chunks_;
+  size_t current_; // chunk written to; the ones after it are spare
+  size_t size_;
+};
+
 /** \brief Abstract class for writers.
  */
 class JSON_API Writer {
@@ -1792,10 +2512,14 @@ public:
 public: // overridden from Writer
   virtual std::string write(const Value& root);
 
+  /// Appends root to out, formatting numbers and escaping strings in
+  /// place. Nothing is allocated once out has grown to the size needed.
+  void write(const Value& root, OutputBuffer& out);
+
 private:
-  void writeValue(const Value& value);
+  void writeValue(const Value& value, OutputBuffer& out);
 
-  std::string document_;
+  OutputBuffer document_;
   bool yamlCompatiblityEnabled_;
   bool dropNullPlaceholders_;
   bool omitEndingLineFeed_;
@@ -0,0 +1,213 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+
+#define LOG_LEVEL_DEBUG     0
+#define LOG_LEVEL_INFO      1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_ERROR     3
+
+/*
+ * Anything below LOG_MIN_LEVEL compiles to nothing, arguments included.
+ * Build with -DLOG_MIN_LEVEL=LOG_LEVEL_INFO to drop the per-command traces.
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL       LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_MAX_ARGS        8
+#define LOG_STRING_BYTES    128     /* copied string arguments, per record */
+#define LOG_RING_SIZE       128     /* records per thread, power of two */
+#define LOG_MAX_THREADS     16
+#define LOG_FLUSH_MS        50
+
+#define LOG_ARG_INT         0
+#define LOG_ARG_UINT        1
+#define LOG_ARG_DOUBLE      2
+#define LOG_ARG_STRING      3
+#define LOG_ARG_POINTER     4
+
+/*
+ * One log call as captured on the calling thread: the format string (which
+ * must be a literal, only the pointer is kept) and the raw arguments.
+ * String arguments are copied into strings[] since the caller's buffer is
+ * gone by the time the flusher formats the record.
+ */
+typedef struct {
+    uint64_t        timestamp;
+    const char*     format;
+    uint8_t         level;
+    uint8_t         count;
+    uint8_t         types[LOG_MAX_ARGS];
+    uint16_t        stringsUsed;
+    union {
+        int64_t     i;
+        uint64_t    u;
+        double      d;
+        const void* p;
+        uint16_t    offset;     /* into strings[] */
+    } args[LOG_MAX_ARGS];
+    char            strings[LOG_STRING_BYTES];
+} log_record_t;
+
+log_record_t*   logReserve (uint8_t level, const char* format);
+void            logCommit (log_record_t* record);
+void            logStart ();
+void            logStop ();
+uint64_t        logDropped ();
+
+static inline void
+logArgument (log_record_t* r, uint8_t type) {
+    r->types[r->count++] = type;
+}
+
+static inline void logArg (log_record_t* r, int v)                  { r->args[r->count].i = v; logArgument (r, LOG_ARG_INT); }
+static inline void logArg (log_record_t* r, long v)                 { r->args[r->count].i = v; logArgument (r, LOG_ARG_INT); }
+static inline void logArg (log_record_t* r, long long v)            { r->args[r->count].i = v; logArgument (r, LOG_ARG_INT); }
+static inline void logArg (log_record_t* r, unsigned int v)         { r->args[r->count].u = v; logArgument (r, LOG_ARG_UINT); }
+static inline void logArg (log_record_t* r, unsigned long v)        { r->args[r->count].u = v; logArgument (r, LOG_ARG_UINT); }
+static inline void logArg (log_record_t* r, unsigned long long v)   { r->args[r->count].u = v; logArgument (r, LOG_ARG_UINT); }
+static inline void logArg (log_record_t* r, double v)               { r->args[r->count].d = v; logArgument (r, LOG_ARG_DOUBLE); }
+static inline void logArg (log_record_t* r, const void* v)          { r->args[r->count].p = v; logArgument (r, LOG_ARG_POINTER); }
+
+static inline void
+logArg (log_record_t* r, const char* v) {
+    size_t room = LOG_STRING_BYTES - r->stringsUsed;
+    size_t len  = (v != NULL) ? strlen (v) : 0;
+
+    if (room == 0) {
+        r->args[r->count].offset = LOG_STRING_BYTES - 1;
+    } else {
+        if (len >= room) {
+            len = room - 1; /* truncated, not dropped */
+        }
+        memcpy (r->strings + r->stringsUsed, v, len);
+        r->strings[r->stringsUsed + len] = '\0';
+        r->args[r->count].offset = r->stringsUsed;
+        r->stringsUsed += len + 1;
+    }
+    logArgument (r, LOG_ARG_STRING);
+}
+
+static inline void logArg (log_record_t* r, char* v)                { logArg (r, (const char*) v); }
+
+/*
+ * Never blocks and never allocates: a full ring drops the record and
+ * counts it, formatting and I/O happen on the flusher thread. One overload
+ * per argument count up to LOG_MAX_ARGS, so C++98 builds take it too.
+ */
+static inline void
+logWrite (uint8_t level, const char* format) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logCommit (r);
+    }
+}
+
+template <typename A>
+static inline void
+logWrite (uint8_t level, const char* format, A a) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C, typename D>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c, D d) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c); logArg (r, d);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C, typename D, typename E>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c, D d, E e) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c); logArg (r, d); logArg (r, e);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c, D d, E e, F f) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c); logArg (r, d); logArg (r, e); logArg (r, f);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c, D d, E e, F f, G g) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c); logArg (r, d); logArg (r, e); logArg (r, f);
+        logArg (r, g);
+        logCommit (r);
+    }
+}
+
+template <typename A, typename B, typename C, typename D, typename E, typename F, typename G, typename H>
+static inline void
+logWrite (uint8_t level, const char* format, A a, B b, C c, D d, E e, F f, G g, H h) {
+    log_record_t* r = logReserve (level, format);
+    if (r != NULL) {
+        logArg (r, a); logArg (r, b); logArg (r, c); logArg (r, d); logArg (r, e); logArg (r, f);
+        logArg (r, g); logArg (r, h);
+        logCommit (r);
+    }
+}
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...)  logWrite (LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...)  do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...)   logWrite (LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...)   do {} while (0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(...)   logWrite (LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...)   do {} while (0)
+#endif
+
+#define LOG_ERROR(...)  logWrite (LOG_LEVEL_ERROR, __VA_ARGS__)
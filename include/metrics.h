@@ -0,0 +1,51 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "tick.h"
+
+#define METRICS_SOURCES     2   /* COMMAND_SOURCE_REDIS, COMMAND_SOURCE_IPC */
+#define METRICS_HANDLERS    2   /* COORDINATE, SERVO */
+#define METRICS_JOINTS      4
+#define METRICS_CLIENTS     2
+
+#define METRICS_PUBLISHER   0
+#define METRICS_SUBSCRIBER  1
+
+/*
+ * Process-wide counters. Every update is a single relaxed atomic add from
+ * whichever thread sees the event; the scraper reads them the same way, so
+ * nothing here ever takes a lock.
+ */
+typedef struct {
+    volatile uint64_t   commands[METRICS_SOURCES][METRICS_HANDLERS];
+    volatile uint64_t   parseFailures[METRICS_SOURCES];
+    volatile uint64_t   dropped[METRICS_SOURCES];
+    volatile uint64_t   ikMisses;
+    volatile uint64_t   pwmWrites[METRICS_JOINTS];
+    volatile uint64_t   redisReconnects[METRICS_CLIENTS];
+} robe_metrics_t;
+
+/*
+ * Values that are read off their owners at scrape time.
+ */
+typedef struct {
+    uint32_t        queueDepth;
+    bool            redisConnected;
+    TickProfiler*   ticks;          /* may be NULL */
+} metrics_gauges_t;
+
+extern robe_metrics_t metrics;
+
+static inline void
+metricsCount (volatile uint64_t& counter) {
+    __atomic_fetch_add (&counter, 1, __ATOMIC_RELAXED);
+}
+
+void metricsToText (std::string& out, const metrics_gauges_t& gauges);
@@ -0,0 +1,90 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "arm.h"
+#include "command.h"
+#include "pwm.h"
+#include "recorder.h"
+#include "telemetry.h"
+#include "tick.h"
+
+#define PWM_BASE 	    3
+#define PWM_SHOULDER 	5
+#define PWM_ELBOW 	    6
+#define PWM_WHRIST      9
+#define PWM_GRIPPER     4
+
+#define ENABLE 		1
+#define DISABLE  	0
+
+#define PERIOD_WIDTH	19800
+
+#define SERVO_SPEED_LOW       0
+#define SERVO_SPEED_MIDDLE    1
+#define SERVO_SPEED_HIGH      2
+
+#define SERVO_STEP_WIDTH      10      /* us per tick at SERVO_SPEED_LOW */
+#define SERVO_STEP_DELAY_US   5000    /* time between ticks */
+
+typedef struct {
+    int              currentAngle;
+    int              currentWidth;
+    uint8_t          joint;
+} servo_context_t;
+
+typedef void (*motion_publish_callback_t) (char* msg, void* priv);
+
+/*
+ * Stamps a decoded command and hands it to the motion thread. Shared by
+ * every ingress path so they all account for the parse stage the same way.
+ * Returns false when the ring is full and the command was dropped. With a
+ * recorder every inbound command is logged, dropped or not.
+ */
+bool motionEnqueue (CommandRing& ring, command_t& cmd, uint8_t source, uint64_t receivedAt,
+                    Recorder* recorder = NULL);
+
+/*
+ * Everything the motion thread does with a command: angle lookup, stepping
+ * the servos through the PWM backend, telemetry and the MODULE-INFO updates.
+ * robe runs it on the board; the load generator runs it on SimulatedPwm.
+ */
+class MotionController {
+    public:
+        MotionController ();
+
+        void setBackend (PwmBackend* pwm);
+        void setTelemetry (TelemetryRing* ring);
+        void setPublishCallback (motion_publish_callback_t callback, void* priv);
+        void setStepDelay (int us);
+        void setTickProfiler (TickProfiler* profiler);
+        void setRecorder (Recorder* recorder);
+
+        void start ();
+        bool execute (command_t& cmd);
+        int  getAngle (int joint);
+
+    private:
+        void setAngle (servo_context_t& ctx, int angle, uint8_t speed);
+        void pwmWrite (servo_context_t& ctx, int width);
+        void publish (int id, int angle);
+        void step (servo_context_t& ctx, int width, uint64_t& scheduled, int delayUs);
+
+        arm_context_t               arm;
+        servo_context_t             servos[4];
+        PwmBackend*                 pwm;
+        TelemetryRing*              telemetry;
+        TickProfiler*               profiler;
+        Recorder*                   recorder;
+        motion_publish_callback_t   publishCallback;
+        void*                       publishPriv;
+        int                         stepDelayUs;
+        command_t                   activeCommand;
+        uint64_t                    firstPwmAt;
+        uint64_t                    lastPwmAt;
+};
@@ -0,0 +1,81 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PROFILE_RING_SIZE       4096    /* samples kept, must be a power of two */
+#define PROFILE_MAX_DEPTH       32      /* frames per sample */
+#define PROFILE_DEFAULT_HZ      499     /* odd, so it does not beat with the 200 Hz tick */
+#define PROFILE_PATH            "/tmp/robe-profile.folded"
+
+#define PROFILE_STAGE_OTHER     0
+#define PROFILE_STAGE_PARSE     1   /* JSON and wire command decoding */
+#define PROFILE_STAGE_IK        2   /* angle lookup */
+#define PROFILE_STAGE_PUBLISH   3   /* state updates to Redis */
+#define PROFILE_STAGE_COUNT     4
+
+#define PROFILE_OP_STOP         0
+#define PROFILE_OP_START        1
+#define PROFILE_OP_DUMP         2
+
+/*
+ * CONTROL_PROFILE request on the IPC socket: stop, start sampling at hz
+ * (0 for PROFILE_DEFAULT_HZ), or dump the samples so far as folded stacks
+ * to the path that follows the header (PROFILE_PATH when there is none).
+ * Every op replies with profileToJson.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t     control;    /* CONTROL_PROFILE */
+    uint8_t     op;
+    uint16_t    hz;
+} profile_control_wire_t;
+
+typedef struct {
+    volatile uint64_t   allocs;
+    volatile uint64_t   frees;
+    volatile uint64_t   bytes;      /* requested by allocs */
+} profile_alloc_t;
+
+/*
+ * Sampling CPU profiler for the field. While running, ITIMER_PROF fires
+ * SIGPROF every 1/hz of process CPU time and the handler stores the
+ * interrupted thread's stack and current stage into a lock-free ring; the
+ * newest PROFILE_RING_SIZE samples are kept. Symbols are only resolved
+ * when dumping, so the cost while running is one walk up the frame
+ * pointers per sample.
+ *
+ * Binaries linked with allochooks.cpp (robe and robe_bench) also have
+ * malloc and friends wrapped and, while the profiler runs, counted against
+ * the calling thread's stage. Counting can also be switched on alone with
+ * profileCountAllocations. Without the hooks the counts stay 0.
+ */
+void        profileStart (uint32_t hz);
+void        profileStop ();
+bool        profileRunning ();
+void        profileCountAllocations (bool enable);
+uint64_t    profileAllocations ();
+int         profileDump (const char* path);
+int         profileToJson (char* buffer, size_t size);
+const char* profileStageName (int stage);
+
+extern profile_alloc_t   profileAllocs[PROFILE_STAGE_COUNT];
+extern volatile uint32_t profileCounting;       /* for the allocation hooks */
+extern __thread int      profileCurrentStage;
+
+/*
+ * Attributes samples and allocations on this thread to stage until the
+ * scope ends.
+ */
+class ProfileStage {
+    public:
+        ProfileStage (int stage);
+        ~ProfileStage ();
+
+    private:
+        int previous;
+};
@@ -0,0 +1,63 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define PWM_MAX_CHANNELS    8
+
+/*
+ * Where pulse widths end up. robe drives the servos through MraaPwm on the
+ * board; SimulatedPwm keeps the state in memory so the pipeline can run
+ * (and be measured) on any machine.
+ */
+class PwmBackend {
+    public:
+        virtual ~PwmBackend () {}
+
+        virtual bool init (int channel, int pin) = 0;
+        virtual void period (int channel, int us) = 0;
+        virtual void enable (int channel, bool enable) = 0;
+        virtual void pulseWidth (int channel, int us) = 0;
+        virtual const char* name () = 0;
+};
+
+class SimulatedPwm : public PwmBackend {
+    public:
+        SimulatedPwm ();
+
+        bool init (int channel, int pin);
+        void period (int channel, int us);
+        void enable (int channel, bool enable);
+        void pulseWidth (int channel, int us);
+        const char* name ();
+
+        int      getPulseWidth (int channel);
+        uint64_t getWrites (int channel);
+
+    private:
+        int                 widths[PWM_MAX_CHANNELS];
+        volatile uint64_t   writes[PWM_MAX_CHANNELS];
+};
+
+#ifdef HAVE_MRAA
+#include "mraa.h"
+
+class MraaPwm : public PwmBackend {
+    public:
+        MraaPwm ();
+        ~MraaPwm ();
+
+        bool init (int channel, int pin);
+        void period (int channel, int us);
+        void enable (int channel, bool enable);
+        void pulseWidth (int channel, int us);
+        const char* name ();
+
+    private:
+        mraa_pwm_context    contexts[PWM_MAX_CHANNELS];
+};
+#endif
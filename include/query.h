@@ -0,0 +1,45 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "history.h"
+
+namespace Json {
+    class OutputBuffer;
+}
+
+#define QUERY_MAX_BUCKETS   1024
+#define QUERY_MAX_ROWS      4096    /* raw queries are cut off here */
+
+/*
+ * CONTROL_HISTORY request on the IPC socket. With buckets set the reply is
+ * the range downsampled into that many equal buckets, otherwise it is the
+ * raw rows. Times are CLOCK_REALTIME ns, from inclusive and to exclusive;
+ * to = 0 means now. Buckets may come back a little wider and starting a
+ * little earlier than asked, see historyBucketWidth; the reply says.
+ * Replies are cut to what the transport takes in one message: a reply
+ * with "truncated":true carries "next", the from to ask again with.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t     control;    /* CONTROL_HISTORY */
+    uint8_t     reserved;
+    uint16_t    buckets;
+    uint64_t    from;
+    uint64_t    to;
+} history_query_wire_t;
+
+uint64_t historyBucketWidth (uint64_t& from, uint64_t to, uint32_t buckets);
+uint64_t historyDownsample (MotionHistory& history, uint64_t from, uint64_t width,
+                            uint32_t buckets, history_aggregate_t* out);
+uint32_t historyBucketsToJson (Json::OutputBuffer& out, uint64_t from, uint64_t width,
+                               uint32_t buckets, const history_aggregate_t* aggregates, size_t maxBytes);
+uint64_t historyRowsToJson (Json::OutputBuffer& out, MotionHistory& history, uint64_t from, uint64_t to,
+                            uint32_t limit, size_t maxBytes);
+void     historyQueryToJson (Json::OutputBuffer& out, MotionHistory& history, history_query_wire_t query,
+                             size_t maxBytes);
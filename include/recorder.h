@@ -0,0 +1,100 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "command.h"
+
+#define RECORDING_MAGIC         0x43524252  /* "RBRC" */
+#define RECORDING_VERSION       2   /* 1 is still read, it has no loss markers */
+#define RECORDING_RING_SIZE     4096        /* must be a power of two */
+#define RECORDING_FLUSH_MS      20
+
+#define RECORDING_COMMAND       1
+#define RECORDING_PWM           2
+#define RECORDING_LOST          3
+
+/*
+ * On disk a recording is a recording_header_t followed by entries, each a
+ * type byte, a CLOCK_MONOTONIC ns timestamp and then:
+ *
+ *   RECORDING_COMMAND   uint8_t source, command_wire_t     (26 bytes total)
+ *   RECORDING_PWM       uint8_t joint, uint16_t width      (12 bytes total)
+ *   RECORDING_LOST      uint8_t 0, uint32_t entries        (14 bytes total)
+ *
+ * Command timestamps are the receive time, PWM ones the write time. Only
+ * commands that made it into the command ring are recorded. A loss marker
+ * stands for entries the recorder itself dropped since the previous one,
+ * written when the writer noticed. The file is only ever appended to, so a
+ * crash loses at most the unflushed tail.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    wireSize;   /* sizeof (command_wire_t) */
+} recording_header_t;
+
+typedef struct {
+    uint8_t         type;
+    uint8_t         source;     /* COMMAND: source, PWM: joint */
+    uint16_t        width;
+    uint32_t        lost;       /* LOST: entries dropped */
+    uint64_t        timestamp;
+    command_wire_t  wire;
+} recording_entry_t;
+
+/*
+ * Any thread records into a bounded MPSC ring (same scheme as CommandRing);
+ * a writer thread appends the ring to the file. A full ring drops the entry
+ * and counts it rather than stall the command path.
+ */
+class Recorder {
+    public:
+        Recorder ();
+        ~Recorder ();
+
+        bool open (const char* path);
+        void close ();
+
+        void command (const command_t& cmd);
+        void pwm (uint8_t joint, uint16_t width, uint64_t timestamp);
+        uint64_t getDropped ();
+
+    private:
+        typedef struct {
+            volatile uint32_t   sequence;
+            recording_entry_t   entry;
+        } slot_t;
+
+        static void* writer (void* arg);
+        void push (const recording_entry_t& entry);
+        bool drain ();
+        void markLost ();
+
+        slot_t              slots[RECORDING_RING_SIZE];
+        volatile uint32_t   head;
+        uint32_t            tail;
+        volatile uint64_t   dropped;
+        uint64_t            marked;     /* dropped entries already in the file */
+        volatile bool       running;
+        FILE*               file;
+        pthread_t           thread;
+};
+
+class RecordingReader {
+    public:
+        RecordingReader ();
+        ~RecordingReader ();
+
+        bool open (const char* path);
+        bool next (recording_entry_t& entry);
+
+    private:
+        FILE*   file;
+};
@@ -0,0 +1,79 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define HISTOGRAM_SUB_BITS      4   /* 16 sub-buckets per power of two, ~6% error */
+#define HISTOGRAM_SUB_COUNT     (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS       ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+#define STAGE_PARSE         0   /* receipt -> decoded command */
+#define STAGE_QUEUE         1   /* enqueue -> motion thread picks it up */
+#define STAGE_IK            2   /* dequeue -> joint angles known */
+#define STAGE_FIRST_PWM     3   /* receipt -> first PWM write */
+#define STAGE_FINAL_PWM     4   /* receipt -> last PWM write */
+#define STAGE_PUBLISH       5   /* time spent publishing state to Redis */
+#define STAGE_COUNT         6
+
+#define STATS_INTERVAL_MS   10000
+
+static inline uint64_t
+monotonicNanos () {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+ * Absolute CLOCK_MONOTONIC sleep, so periodic loops do not accumulate the
+ * drift a relative usleep() adds every iteration.
+ */
+static inline void
+sleepUntilNanos (uint64_t deadline) {
+    struct timespec ts;
+
+    ts.tv_sec  = deadline / 1000000000ULL;
+    ts.tv_nsec = deadline % 1000000000ULL;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+/*
+ * Log-linear (HDR style) histogram of nanosecond values. Recording is a
+ * single relaxed atomic increment so any thread can record without locks;
+ * readers scan the buckets and may see a histogram that is a few samples
+ * behind, which is fine for percentiles.
+ */
+class LatencyHistogram {
+    public:
+        LatencyHistogram ();
+
+        void     record (uint64_t value);
+        void     reset ();
+        uint64_t count ();
+        uint64_t sum ();
+        uint64_t max ();
+        uint64_t percentile (double p);
+        uint64_t countAtOrBelow (uint64_t value);
+
+    private:
+        static uint32_t bucketOf (uint64_t value);
+        static uint64_t bucketValue (uint32_t bucket);
+
+        uint32_t            buckets[HISTOGRAM_BUCKETS];
+        volatile uint64_t   total;
+        volatile uint64_t   totalValue;
+        volatile uint64_t   highest;
+};
+
+extern LatencyHistogram latencyStats[STAGE_COUNT];
+
+const char* stageName (int stage);
+int         statsToJson (char* buffer, size_t size);
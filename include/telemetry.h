@@ -0,0 +1,90 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define TELEMETRY_MAGIC         0x45424f52  /* "ROBE" */
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_RING_SIZE     1024        /* must be a power of two */
+#define TELEMETRY_JOINTS        4
+
+/*
+ * One motion tick as seen by the motion thread. Records are written into a
+ * shared memory ring that local processes map read-only; the file
+ * descriptor is handed out over the IPC socket (see CONTROL_TELEMETRY).
+ */
+typedef struct {
+    uint64_t    index;                      /* position in the stream, 0 based */
+    uint64_t    timestamp;                  /* CLOCK_MONOTONIC, ns */
+    uint8_t     handler;                    /* command being executed */
+    uint8_t     source;
+    uint8_t     joint;                      /* servo written on this tick */
+    uint8_t     reserved;
+    int16_t     angles[TELEMETRY_JOINTS];   /* degrees */
+    uint16_t    widths[TELEMETRY_JOINTS];   /* pulse width, us */
+    float       x;                          /* COORDINATE target */
+    float       y;
+    float       z;
+} telemetry_record_t;
+
+typedef struct {
+    volatile uint32_t   sequence;   /* seqlock, odd while the slot is written */
+    uint32_t            pad;
+    telemetry_record_t  record;
+} telemetry_slot_t;
+
+typedef struct {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            recordSize;
+    uint32_t            slotCount;
+    volatile uint64_t   head;       /* number of records written */
+    uint8_t             pad[40];    /* keep slots off the header cache line */
+    telemetry_slot_t    slots[TELEMETRY_RING_SIZE];
+} telemetry_shm_t;
+
+/*
+ * Single writer side, lives in robe's motion thread.
+ */
+class TelemetryRing {
+    public:
+        TelemetryRing ();
+        ~TelemetryRing ();
+
+        int  create ();
+        void publish (telemetry_record_t& record);
+        int  getReadOnlyFd ();
+
+    private:
+        int                 fd;
+        telemetry_shm_t*    shm;
+};
+
+/*
+ * Reader side for local consumers. Reading never makes a syscall; a reader
+ * that falls more than TELEMETRY_RING_SIZE records behind loses the
+ * overwritten ones and read() reports TELEMETRY_LOST.
+ */
+#define TELEMETRY_OK        0
+#define TELEMETRY_EMPTY     1
+#define TELEMETRY_LOST      2
+
+class TelemetryReader {
+    public:
+        TelemetryReader ();
+        ~TelemetryReader ();
+
+        bool     attach (int fd);
+        int      read (telemetry_record_t& record);
+        uint64_t head ();
+        uint64_t next ();
+        void     seek (uint64_t index);
+
+    private:
+        const telemetry_shm_t*  shm;
+        uint64_t                cursor;
+};
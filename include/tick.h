@@ -0,0 +1,64 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stats.h"
+
+#define TICK_TRACE_SIZE         8192    /* must be a power of two */
+#define TICK_DEADLINE_US        1000    /* later than this counts as a miss */
+#define TICK_TRACE_PATH         "/tmp/robe-trace.json"
+
+#define TICK_EVENT_STEP         0
+#define TICK_EVENT_COMMAND      1
+
+typedef struct {
+    uint64_t    scheduled;  /* STEP: when the tick was due, COMMAND: dequeue */
+    uint64_t    actual;     /* STEP: when it ran, COMMAND: done */
+    uint16_t    value;      /* STEP: pulse width, COMMAND: handler */
+    uint8_t     joint;
+    uint8_t     type;
+} tick_trace_t;
+
+/*
+ * Scheduled against actual time of every servo step the motion thread
+ * makes. Lateness always goes into a histogram and the miss counter; with
+ * tracing on, steps and whole commands also go into a ring that can be
+ * written out as a Chrome trace (chrome://tracing, Perfetto).
+ *
+ * Only the motion thread records. Dumping from another thread copies the
+ * ring and drops whatever the writer may have overwritten meanwhile.
+ */
+class TickProfiler {
+    public:
+        TickProfiler ();
+
+        void setDeadline (int us);
+        void setTracing (bool enabled);
+
+        void tick (uint8_t joint, uint16_t width, uint64_t scheduled, uint64_t actual);
+        void command (uint8_t handler, uint64_t start, uint64_t end);
+
+        uint64_t getTicks ();
+        uint64_t getMisses ();
+        LatencyHistogram& getJitter ();
+
+        int toJson (char* buffer, size_t size);
+        int dumpChromeTrace (const char* path);
+
+    private:
+        void trace (const tick_trace_t& event);
+
+        LatencyHistogram    jitter;
+        volatile uint64_t   ticks;
+        volatile uint64_t   misses;
+        uint64_t            deadlineNs;
+        volatile bool       tracing;
+        tick_trace_t        events[TICK_TRACE_SIZE];
+        volatile uint64_t   head;
+};
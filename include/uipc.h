@@ -6,9 +6,11 @@
 #pragma once
 
 #include <iostream>
+#include <map>
+#include <vector>
+#include <stdint.h>
 #include <sys/socket.h>
-#include <sys/ioctl.h>
-#include <linux/sockios.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 using namespace std;
@@ -17,26 +19,89 @@ using namespace std;
 #define ERROR_OPEN_SOCKET	-10
 #define ERROR_BIND_SOCKET	-11
 #define ERROR_LISTEN_SOCKET	-12
+#define ERROR_EPOLL     	-13
 
-#define MESSAGE_SIZE        42
+#define IPC_STREAM          0
+#define IPC_SEQPACKET       1
 
+#define IPC_HEADER_SIZE     sizeof(uint32_t)
+#define IPC_MAX_MESSAGE     (16 * 1024 * 1024)
+#define IPC_MAX_PACKET      8192    /* largest message in IPC_SEQPACKET mode */
+#define IPC_BATCH           32      /* messages per recvmmsg/sendmmsg */
+#define IPC_READ_CHUNK      4096
+#define IPC_MAX_EVENTS      64
+
+class WiseIPC;
+
+typedef void (*ipc_message_callback_t) (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len, void* priv);
+typedef void (*ipc_client_callback_t) (WiseIPC* ipc, int client, void* priv);
+
+/*
+ * In IPC_STREAM mode every message on the socket is a native-endian
+ * uint32_t payload length followed by the payload. IPC_SEQPACKET mode uses
+ * SOCK_SEQPACKET, where the kernel keeps message boundaries, so there is no
+ * header on the wire and up to IPC_BATCH messages move per recvmmsg or
+ * sendmmsg call. Empty messages are not allowed in IPC_SEQPACKET mode since
+ * a zero length read means the peer hung up.
+ *
+ * In server mode the listening socket and all clients are non-blocking and
+ * multiplexed on a single epoll set; each client keeps its own read and
+ * write buffer so a slow or half-written peer never blocks the others.
+ * Client mode is a plain blocking socket.
+ */
 class WiseIPC {
     public:
-        WiseIPC (string socket_path);
+        WiseIPC (string socket_path, int mode = IPC_STREAM);
         ~WiseIPC ();
 
-        void setBuffer (unsigned char * buff);
-        int  listenIPC ();
         int  setServer ();
         int  setClient ();
-        bool sendMsg (unsigned int len);
-        void readMsg (int socket, unsigned int len);
-		int  getUnreadDataLength ();
+        int  poll (int timeoutMs);
+        void setMessageCallback (ipc_message_callback_t callback, void* priv);
+        void setClientCallbacks (ipc_client_callback_t onConnect, ipc_client_callback_t onDisconnect);
 
-        unsigned char *     buff;
+        bool sendMsg (int client, const void* data, uint32_t len);
+        bool sendMsgs (int client, const struct iovec* msgs, int count);
+        bool sendMsgv (int client, const struct iovec* parts, int count);
+        bool sendFd (int client, int fd, const void* data, uint32_t len);
+        bool sendMsg (const void* data, uint32_t len);
+        bool sendMsgs (const struct iovec* msgs, int count);
+        int  readMsg (vector<unsigned char>& msg, int* fd = NULL);
+        int  getSocket ();
+        int  getClientCount ();
+        uint32_t maxMessage ();
+        void closeClient (int client);
 
     private:
-        int                 fd_sock;
-        struct sockaddr_un  addr;
-        string              socketPath;
+        typedef struct {
+            int                     fd;
+            vector<unsigned char>   rbuf;
+            size_t                  rlen;
+            vector<unsigned char>   wbuf;   /* always length-prefixed frames */
+            size_t                  wpos;
+            bool                    writing;
+        } client_t;
+
+        int  acceptClients ();
+        bool readClient (client_t* client);
+        bool readPackets (client_t* client);
+        bool flushClient (client_t* client);
+        bool flushPackets (client_t* client);
+        void updateEvents (client_t* client);
+        int  frameMsgs (const struct iovec* msgs, int count);
+
+        int                     mode;
+        int                     fd_sock;
+        int                     fd_epoll;
+        struct sockaddr_un      addr;
+        string                  socketPath;
+        map<int, client_t*>     clients;
+        vector<unsigned char>   packets;
+        vector<struct iovec>    iovs;
+        vector<uint32_t>        lengths;
+
+        ipc_message_callback_t  onMessage;
+        ipc_client_callback_t   onConnect;
+        ipc_client_callback_t   onDisconnect;
+        void*                   priv;
 };
@@ -1,8 +1,6 @@
 var sqlite3 = require('sqlite3').verbose();
 var console;
 
-//TODO: protect against SQL injection (escape user input)
-
 function SqliteAdapter(dbFile) {
     var self = this;
     this.db = new sqlite3.Database(dbFile);
@@ -22,7 +20,8 @@ SqliteAdapter.prototype.ArchiveRobeMotion = function(coordinates) {
     var sql = this.db;
     sql.serialize(function() {
         sql.run("INSERT INTO `robe_history` (`record_id`, `coor_x`, `coor_y`, `coor_z`, `coor_p`) " +
-            "VALUES (NULL," + coordinates.x + "," + coordinates.y + "," + coordinates.z +  "," + coordinates.p + ");");
+            "VALUES (NULL, ?, ?, ?, ?);",
+            [coordinates.x, coordinates.y, coordinates.z, coordinates.p]);
     });
 }
 
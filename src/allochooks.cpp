@@ -0,0 +1,102 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Allocation hooks for the profiler. glibc exports its allocator under
+ * __libc_* as well, so defining the public names here wraps every
+ * allocation in the process, C++ new and hiredis included, at the cost of
+ * one relaxed load while the profiler is off. Kept out of robecore: only
+ * the binaries that list this file get their allocator wrapped.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+
+#include "profile.h"
+
+#ifdef __GLIBC__
+extern "C" {
+    void* __libc_malloc (size_t size);
+    void* __libc_calloc (size_t count, size_t size);
+    void* __libc_realloc (void* ptr, size_t size);
+    void* __libc_memalign (size_t alignment, size_t size);
+    void  __libc_free (void* ptr);
+}
+
+static inline void
+countAlloc (size_t size) {
+    if (__atomic_load_n (&profileCounting, __ATOMIC_RELAXED)) {
+        profile_alloc_t& a = profileAllocs[profileCurrentStage];
+
+        __atomic_fetch_add (&a.allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add (&a.bytes, size, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void
+countFree (void* ptr) {
+    if (ptr != NULL && __atomic_load_n (&profileCounting, __ATOMIC_RELAXED)) {
+        __atomic_fetch_add (&profileAllocs[profileCurrentStage].frees, 1, __ATOMIC_RELAXED);
+    }
+}
+
+extern "C" void*
+malloc (size_t size) {
+    countAlloc (size);
+    return __libc_malloc (size);
+}
+
+extern "C" void*
+calloc (size_t count, size_t size) {
+    countAlloc (count * size);
+    return __libc_calloc (count, size);
+}
+
+extern "C" void*
+realloc (void* ptr, size_t size) {
+    countFree (ptr);
+    if (size > 0) {
+        countAlloc (size);
+    }
+    return __libc_realloc (ptr, size);
+}
+
+/*
+ * The aligned ones too, or their blocks would show up as frees only.
+ */
+extern "C" void*
+memalign (size_t alignment, size_t size) {
+    countAlloc (size);
+    return __libc_memalign (alignment, size);
+}
+
+extern "C" void*
+aligned_alloc (size_t alignment, size_t size) {
+    countAlloc (size);
+    return __libc_memalign (alignment, size);
+}
+
+extern "C" int
+posix_memalign (void** ptr, size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment % sizeof (void*) != 0) {
+        return EINVAL;
+    }
+
+    void* block = __libc_memalign (alignment, size);
+    if (block == NULL) {
+        return ENOMEM;
+    }
+
+    countAlloc (size);
+    *ptr = block;
+    return 0;
+}
+
+extern "C" void
+free (void* ptr) {
+    countFree (ptr);
+    __libc_free (ptr);
+}
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <iostream>
+#include <cmath>
+
+#include "arm.h"
+
+arm_angles_t angleMap[ANGLE_MAP_SIZE] = {
+    {  95.0, 105.0, 170.0, 140.0 },
+    { 100.0, 120.0, 150.0, 145.0 },
+    { 105.0, 135.0, 115.0, 145.0 },
+    { 130.0, 105.0, 175.0, 135.0 },
+    { 120.0, 120.0, 140.0, 145.0 },
+    { 120.0, 140.0, 105.0, 140.0 },
+    { 155.0, 120.0, 140.0, 150.0 },
+    { 140.0, 130.0, 120.0, 150.0 },
+    { 125.0, 140.0, 105.0, 125.0 },
+
+    {  95.0,  65.0, 165.0, 165.0 },
+    { 100.0,  90.0, 120.0, 165.0 },
+    { 100.0, 120.0,  80.0, 165.0 },
+    { 130.0,  90.0, 120.0, 180.0 },
+    { 120.0, 110.0,  95.0, 180.0 },
+    { 120.0, 110.0,  95.0, 150.0 },
+    { 155.0,  85.0, 125.0, 155.0 },
+    { 140.0,  90.0, 120.0, 150.0 },
+    { 125.0, 120.0,  90.0, 130.0 },
+    
+    { 105.0,  60.0, 125.0, 180.0 },
+    { 105.0,  80.0, 110.0, 165.0 },
+    { 105.0, 100.0,  85.0, 155.0 },
+    { 125.0,  65.0, 120.0, 180.0 },
+    { 125.0,  80.0, 115.0, 170.0 },
+    { 120.0, 105.0,  85.0, 155.0 },
+    { 155.0,  70.0, 125.0, 165.0 },
+    { 135.0, 100.0,  80.0, 180.0 },
+    { 125.0, 120.0,  55.0, 155.0 },
+    
+    {  95.0,   45.0, 135.0, 160.0 },
+    {  95.0,   55.0, 125.0, 150.0 },
+    {  95.0,   85.0, 115.0, 130.0 },
+    { 125.0,   50.0, 115.0, 180.0 },
+    { 120.0,   65.0, 115.0, 155.0 },
+    { 115.0,   90.0,  85.0, 150.0 },
+    { 155.0,   55.0, 120.0, 155.0 },
+    { 140.0,   70.0, 120.0, 140.0 },
+    { 125.0,  100.0,  75.0, 140.0 },
+    
+    {  95.0,   50.0, 120.0, 130.0 },
+    {  95.0,   65.0, 115.0, 120.0 },
+    {  95.0,   90.0,  90.0,  95.0 },
+    { 125.0,   55.0, 105.0, 145.0 },
+    { 120.0,   70.0, 115.0, 120.0 },
+    { 115.0,   85.0, 115.0,  80.0 },
+    { 155.0,   65.0,  90.0, 145.0 },
+    { 140.0,   75.0, 100.0, 115.0 },
+    { 130.0,   90.0, 100.0,  75.0 },
+    
+    {  95.0,   65.0, 105.0,  85.0 },
+    {  95.0,   80.0,  95.0, 110.0 },
+    {   0.0,    0.0,   0.0,   0.0 },
+    { 125.0,   65.0, 105.0,  95.0 },
+    { 120.0,   85.0,  90.0,  90.0 },
+    {   0.0,    0.0,   0.0,   0.0 },
+    { 155.0,   75.0,  90.0, 100.0 },
+    { 145.0,   85.0,  90.0,  90.0 },
+    {   0.0,    0.0,   0.0,   0.0 },
+};
+
+uint8_t
+findAnglesMap (arm_context_t& ctx) {
+    int index = ((ctx.coord.z - 1) * 9) + ((ctx.coord.y - 1) * 3) + ctx.coord.x - 1;
+    if (ctx.coord.x < 1 || ctx.coord.x > 3 || ctx.coord.y < 1 || ctx.coord.y > 3 ||
+        index < 0 || index >= ANGLE_MAP_SIZE) {
+        return NO;
+    }
+    ctx.angles_ptr = (arm_angles_t*) &angleMap[index];
+    
+    if (ctx.angles_ptr->tn + ctx.angles_ptr->j1 + ctx.angles_ptr->j2 + ctx.angles_ptr->j3 == 0) {
+        return NO;
+    }
+    
+    return YES;
+}
+
+uint8_t
+calculateAngles (arm_context_t& ctx) {
+    float a0, a1, a2, a3, a12, aG;
+    float wT, w1, w2, z1, z2, l12;
+    
+    a0 = atan(ctx.coord.y / ctx.coord.x);
+    wT = sqrt(ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
+    
+    aG = -0.785398163;
+    w2 = wT;
+    z2 = ctx.coord.z;
+    
+    l12 = sqrt((w2*w2) + (z2*z2));
+    a12 = atan (z2/w2);
+    
+    /*if (l12 > ctx.coxa + ctx.fermur) {
+        return NO;
+    }*/
+    
+    a1 = acos(((ctx.coxa*ctx.coxa) + (l12*l12) - (ctx.fermur*ctx.fermur)) / (2 * ctx.coxa * l12 )) + a12;
+    
+    w1 = ctx.coxa * cos(a1);
+    z1 = ctx.coxa * sin(a1);
+    a2 = atan ((z2 - z1) / (w2 - w1)) - a1;
+    a3 = aG - a1 - a2;
+    
+    ctx.angles.tn = a0 * 180 / 3.14;
+    ctx.angles.j1 = a1 * 180 / 3.14;
+    ctx.angles.j2 = a2 * 180 / 3.14;
+
+    /*float a0, a1, a2, a3, a12, aG;
+    float wT, w1, w2, z1, z2, l12;
+    
+    a0 = atan(ctx.coord.y / ctx.coord.x);
+    wT = sqrt(ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
+    
+    aG = -0.785398163;
+    w2 = wT - ctx.tibia * cos(aG);
+    z2 = ctx.coord.z - ctx.tibia * sin(aG);
+    
+    l12 = sqrt((w2*w2) + (z2*z2));
+    a12 = atan (z2/w2);
+    
+    std::cout   << "L12 (" << l12 << ") ";
+    if (l12 > ctx.coxa + ctx.fermur) {
+        return NO;
+    }
+    
+    a1 = acos(((ctx.coxa*ctx.coxa) + (l12*l12) - (ctx.fermur*ctx.fermur)) / (2 * ctx.coxa * l12 )) + a12;
+    
+    w1 = ctx.coxa * cos(a1);
+    z1 = ctx.coxa * sin(a1);
+    a2 = atan ((z2 - z1) / (w2 - w1)) - a1;
+    a3 = aG - a1 - a2;
+    
+    ctx.angles.tn = a0 * 180 / 3.14;
+    ctx.angles.j1 = a1 * 180 / 3.14;
+    ctx.angles.j2 = a2 * 180 / 3.14;
+    ctx.angles.j3 = a3 * 180 / 3.14;*/
+
+    /*float xt    = ctx.coord.x;
+    float l     = sqrt (ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
+    float c     = 0;
+    float theta = 0;
+    float ang   = 0;
+    float x1    = 0;
+    float z1    = 0;
+    float d     = 0;
+
+    std::cout   << "COORDINATE_T ("
+                        << ctx.coord.x << "," << ctx.coord.y << "," 
+                        << ctx.coord.z << "," << ctx.coord.p << ")\n";
+
+    // tn angle
+    ctx.angles.tn = atan(ctx.coord.y / ctx.coord.x);
+
+    // j2 angle
+    ctx.coord.x = l;
+    ctx.coord.z += ctx.tibia;
+    c = sqrt (ctx.coord.x*ctx.coord.x + ctx.coord.z*ctx.coord.z);
+    ctx.angles.j2 = acos ((ctx.fermur*ctx.fermur + ctx.coxa*ctx.coxa - c*c) / (2 * ctx.fermur * ctx.coxa)) * 180 / 3.14;
+
+    // j1 angle
+    theta = acos ((c*c + ctx.coxa*ctx.coxa - ctx.fermur*ctx.fermur) / (2 * c * ctx.coxa));
+    ang = atan (ctx.coord.z / ctx.coord.x) + theta;
+    ctx.angles.j1 = (atan (ctx.coord.z / ctx.coord.x) + theta) * 180 / 3.14;
+
+    // j3 angle
+    x1 = ctx.coxa * cos (ang);
+    z1 = ctx.coxa * sin (ang);
+    d = sqrt ((ctx.coord.x - x1)*(ctx.coord.x - x1) + (ctx.coord.z - ctx.tibia - z1)*(ctx.coord.z - ctx.tibia - z1));
+    ctx.angles.j3 = acos ((ctx.fermur*ctx.fermur + ctx.tibia*ctx.tibia - d*d) / (2 * ctx.fermur * ctx.tibia)) * 180 / 3.14;
+    ctx.angles.tn = atan(ctx.coord.y / xt) * 180 / 3.14;*/
+
+    return YES;
+}
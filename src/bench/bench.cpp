@@ -0,0 +1,794 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Microbenchmarks for the robe hot paths. Builds without mraa or Redis and
+ * prints one JSON document so runs can be compared between releases:
+ *
+ *   robe_bench [-t min_ms] [-f filter] [-o output.json]
+ *
+ * allocs_per_op counts heap allocations in the timed run, from every thread.
+ * Parsers also report mb_per_sec of input.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "arm.h"
+#include "command.h"
+#include "history.h"
+#include "json/json.h"
+#include "profile.h"
+#include "query.h"
+#include "pwm.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "uipc.h"
+
+using namespace std;
+
+typedef void (*bench_fn_t) (uint64_t iterations, void* priv);
+
+typedef struct {
+    const char* name;
+    bench_fn_t  fn;
+    void*       priv;
+    size_t      bytes;      /* input per op, for mb_per_sec; 0 when it does not apply */
+} bench_t;
+
+static volatile uint64_t sink;
+static int               minTimeMs = 200;
+static const char*       filter    = NULL;
+
+static const char* coordinateJson = "{\"handler\":1,\"x\":2,\"y\":3,\"z\":4,\"p\":0}";
+static const char* servoJson      = "{\"handler\":2,\"id\":3,\"angle\":120}";
+static const char* realsJson      = "{\"handler\":1,\"x\":12.5,\"y\":-3.25,\"z\":0.1,\"p\":1e-3}";
+
+static void
+benchJsonDecode (uint64_t iterations, void* priv) {
+    command_t cmd;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        commandFromJson ((const char*) priv, cmd);
+        sink += cmd.handler;
+    }
+}
+
+/*
+ * Builds a state update the way callers do, member by member.
+ */
+static void
+buildState (Json::Value& state, uint64_t i) {
+    state["type"]     = "SERVO";
+    state["id"]       = (int) (i % 4) + 1;
+    state["angle"]    = (int) (i % 180);
+    state["pulse_us"] = 600 + (int) (i % 1800);
+    state["moving"]   = (i & 1) != 0;
+}
+
+static void
+benchJsonBuild (uint64_t iterations, void* priv) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::Value state;
+
+        buildState (state, i);
+        sink += state.size ();
+    }
+}
+
+/*
+ * One op is one batch of 16 updates gathered into an array.
+ */
+static void
+benchJsonAppend (uint64_t iterations, void* priv) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::Value batch (Json::arrayValue);
+
+        for (int n = 0; n < 16; n++) {
+            Json::Value state;
+
+            buildState (state, i + n);
+#if JSON_HAS_RVALUE_REFERENCES
+            batch.append (std::move (state));
+#else
+            batch.append (state);
+#endif
+        }
+        sink += batch.size ();
+    }
+}
+
+/*
+ * json_append_array with the Values on this thread's pool.
+ */
+static void
+benchJsonAppendPool (uint64_t iterations, void* priv) {
+    Json::ValueAllocatorScope scope (Json::ValueAllocator::threadPool ());
+
+    benchJsonAppend (iterations, priv);
+}
+
+/*
+ * One op is one hit and one miss by name, as commandFromJson does.
+ */
+static void
+benchJsonLookup (uint64_t iterations, void* priv) {
+    Json::Value& object = *(Json::Value*) priv;
+    static const char* names[] = { "type", "id", "angle", "pulse_us", "moving",
+                                   "k7", "k23", "k42", "k63" };
+    size_t count = object.size () > 8 ? 9 : 5;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += object.get (names[i % count], 0).isNull ();
+        sink += object.isMember ("missing");
+    }
+}
+
+static void
+benchJsonWrite (uint64_t iterations, void* priv) {
+    Json::FastWriter writer;
+    Json::Value      state;
+
+    buildState (state, 7);
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += writer.write (state).size ();
+    }
+}
+
+/*
+ * The same state as json_write_fast, into a buffer kept across writes.
+ */
+static void
+benchJsonWriteBuffer (uint64_t iterations, void* priv) {
+    Json::FastWriter   writer;
+    Json::OutputBuffer buffer;
+    Json::Value        state;
+
+    buildState (state, 7);
+    for (uint64_t i = 0; i < iterations; i++) {
+        buffer.clear ();
+        writer.write (state, buffer);
+        sink += buffer.size ();
+    }
+}
+
+static void
+benchJsonWriteReals (uint64_t iterations, void* priv) {
+    Json::FastWriter writer;
+    Json::Value      pose;
+
+    pose["x"] = 12.5;
+    pose["y"] = -3.25;
+    pose["z"] = 0.1;
+    pose["p"] = 1.0 / 3.0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += writer.write (pose).size ();
+    }
+}
+
+/*
+ * Arm settings nested the way a configuration file would hold them. One op
+ * is one lookup three levels down.
+ */
+static void
+buildSettings (Json::Value& settings) {
+    static const char* joints[] = { "base", "shoulder", "elbow", "wrist" };
+
+    for (int i = 0; i < 4; i++) {
+        Json::Value& joint = settings["arm"]["joints"][i];
+
+        joint["name"]         = joints[i];
+        joint["min_angle"]    = 0;
+        joint["max_angle"]    = 180;
+        joint["min_pulse_us"] = 600;
+        joint["max_pulse_us"] = 2400;
+    }
+    settings["arm"]["coxa"]   = 5.5;
+    settings["arm"]["fermur"] = 5.5;
+    settings["arm"]["tibia"]  = 8;
+}
+
+#define BENCH_SETTINGS_PATH ".arm.joints[2].max_pulse_us"
+
+static void
+benchJsonPathParse (uint64_t iterations, void* priv) {
+    const Json::Value& settings = *(const Json::Value*) priv;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += Json::Path (BENCH_SETTINGS_PATH).resolve (settings).asInt ();
+    }
+}
+
+static void
+benchJsonPathCompiled (uint64_t iterations, void* priv) {
+    const Json::Value& settings = *(const Json::Value*) priv;
+    Json::Path         path (BENCH_SETTINGS_PATH);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += path.find (settings)->asInt ();
+    }
+}
+
+static void
+benchJsonPathCached (uint64_t iterations, void* priv) {
+    const Json::Value& settings = *(const Json::Value*) priv;
+    Json::PathCache    cache;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += cache.get (BENCH_SETTINGS_PATH).find (settings)->asInt ();
+    }
+}
+
+#define BENCH_TRAJECTORY_POINTS  2000
+#define BENCH_FEED_BYTES         4096
+
+/*
+ * A trajectory upload: an array of coordinate commands.
+ */
+static void
+buildTrajectory (string& json) {
+    char point[128];
+
+    json = "[";
+    for (int i = 0; i < BENCH_TRAJECTORY_POINTS; i++) {
+        snprintf (point, sizeof (point), "%s{\"handler\":1,\"x\":%.2f,\"y\":%.2f,\"z\":%.2f,\"p\":%d}",
+                  (i > 0) ? "," : "", 10.0 + i * 0.01, -5.0 + i * 0.02, 3.5, i % 90);
+        json += point;
+    }
+    json += "]";
+}
+
+static void
+benchJsonTrajectoryDom (uint64_t iterations, void* priv) {
+    const string& json = *(const string*) priv;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::Reader reader;
+        Json::Value  root;
+
+        reader.parse (json.data (), json.data () + json.size (), root, false);
+        sink += root.size ();
+    }
+}
+
+static void
+benchJsonTrajectoryPool (uint64_t iterations, void* priv) {
+    Json::ValueAllocatorScope scope (Json::ValueAllocator::threadPool ());
+
+    benchJsonTrajectoryDom (iterations, priv);
+}
+
+/*
+ * Each document is built in an arena and dropped with one reset, without
+ * destroying the tree.
+ */
+static void
+benchJsonTrajectoryArena (uint64_t iterations, void* priv) {
+    const string&   json = *(const string*) priv;
+    Json::ValueArena arena (65536);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::Reader reader;
+        {
+            Json::ValueAllocatorScope scope (&arena);
+            Json::Value&              root = *arena.newValue ();
+
+            reader.parse (json.data (), json.data () + json.size (), root, false);
+            sink += root.size ();
+        }
+        arena.reset ();
+    }
+}
+
+static void
+benchJsonParse (uint64_t iterations, void* priv) {
+    const string& json = *(const string*) priv;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::Reader reader;
+        Json::Value  root;
+
+        reader.parse (json.data (), json.data () + json.size (), root, false);
+        sink += root.size ();
+    }
+}
+
+/* Counts the coordinates as they stream past. */
+class TrajectoryCounter : public Json::ReaderHandler {
+    public:
+        uint64_t points;
+
+        TrajectoryCounter () : points (0) {}
+
+        bool onEndObject () {
+            this->points++;
+            return true;
+        }
+};
+
+static void
+benchJsonTrajectoryEvents (uint64_t iterations, void* priv) {
+    const string& json = *(const string*) priv;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        TrajectoryCounter counter;
+        Json::EventReader reader (counter);
+
+        for (size_t offset = 0; offset < json.size (); offset += BENCH_FEED_BYTES) {
+            size_t length = min ((size_t) BENCH_FEED_BYTES, json.size () - offset);
+            reader.feed (json.data () + offset, json.data () + offset + length);
+        }
+        reader.finish ();
+        sink += counter.points;
+    }
+}
+
+/*
+ * Reads the last point out of the upload, as a caller after one field of a
+ * large message would.
+ */
+static void
+benchJsonTrajectoryLazy (uint64_t iterations, void* priv) {
+    const string& json = *(const string*) priv;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        Json::LazyDocument doc;
+
+        doc.parse (json.data (), json.data () + json.size ());
+        Json::LazyValue root = doc.root ();
+        sink += root[root.size () - 1]["x"].asInt ();
+    }
+}
+
+static void
+benchWireDecode (uint64_t iterations, void* priv) {
+    command_t      cmd;
+    command_wire_t wire;
+
+    memset (&cmd, 0, sizeof (cmd));
+    cmd.handler = COORDINATE;
+    cmd.x = 2; cmd.y = 3; cmd.z = 4;
+    commandToWire (cmd, wire);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        commandFromWire ((const unsigned char*) &wire, sizeof (wire), cmd);
+        sink += cmd.handler;
+    }
+}
+
+static void
+benchFindAnglesMap (uint64_t iterations, void* priv) {
+    arm_context_t ctx;
+
+    memset (&ctx, 0, sizeof (ctx));
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx.coord.x = 1 + i % 3;
+        ctx.coord.y = 1 + (i / 3) % 3;
+        ctx.coord.z = 1 + (i / 9) % 6;
+        sink += findAnglesMap (ctx);
+    }
+}
+
+static void
+benchIkSolve (uint64_t iterations, void* priv) {
+    arm_context_t ctx;
+
+    memset (&ctx, 0, sizeof (ctx));
+    ctx.coxa   = 5.5;
+    ctx.fermur = 5.5;
+    ctx.tibia  = 8;
+    for (uint64_t i = 0; i < iterations; i++) {
+        ctx.coord.x = 3 + (i % 5);
+        ctx.coord.y = 1 + (i % 7);
+        ctx.coord.z = 2 + (i % 3);
+        calculateAngles (ctx);
+        sink += (uint64_t) ctx.angles.j1;
+    }
+}
+
+static void
+benchPulseWidth (uint64_t iterations, void* priv) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        sink += angleToPulseWidth (i % 181);
+    }
+}
+
+static void
+benchTelemetryFormat (uint64_t iterations, void* priv) {
+    char msg[128];
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        servoMsgFactory (msg, 1 + i % 4, i % 181);
+        sink += msg[0];
+    }
+}
+
+static void
+benchTelemetryRing (uint64_t iterations, void* priv) {
+    TelemetryRing       ring;
+    telemetry_record_t  record;
+
+    memset (&record, 0, sizeof (record));
+    ring.create ();
+    for (uint64_t i = 0; i < iterations; i++) {
+        record.widths[0] = i;
+        ring.publish (record);
+    }
+}
+
+static void
+benchCommandRing (uint64_t iterations, void* priv) {
+    CommandRing ring;
+    command_t   cmd;
+
+    memset (&cmd, 0, sizeof (cmd));
+    for (uint64_t i = 0; i < iterations; i++) {
+        ring.push (cmd);
+        ring.pop (cmd);
+        ring.wait ();
+    }
+}
+
+static void
+benchSimulatedPwm (uint64_t iterations, void* priv) {
+    SimulatedPwm pwm;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        pwm.pulseWidth (i & 3, MIN_PULSE_WIDTH + i % 1600);
+    }
+    sink += pwm.getWrites (0);
+}
+
+static void
+removeDirectory (const char* path) {
+    DIR*           d = opendir (path);
+    struct dirent* e;
+    char           file[PATH_MAX];
+
+    while (d != NULL && (e = readdir (d)) != NULL) {
+        if (e->d_name[0] != '.') {
+            int len = snprintf (file, sizeof (file), "%s/%s", path, e->d_name);
+            if (len > 0 && (size_t) len < sizeof (file)) {
+                unlink (file);
+            }
+        }
+    }
+
+    if (d != NULL) {
+        closedir (d);
+    }
+    rmdir (path);
+}
+
+static void
+historyRow (history_row_t& row, uint64_t i) {
+    row.timestamp = 1000000000ULL + i * 1000000ULL;
+    row.handler   = COORDINATE;
+    row.outcome   = HISTORY_OK;
+    row.x         = 1 + i % 3;
+    row.y         = 1 + (i / 3) % 3;
+    row.z         = 1 + (i / 9) % 6;
+    row.p         = 0;
+    for (int joint = 0; joint < 4; joint++) {
+        row.angles[joint] = (i + joint * 40) % 180;
+    }
+    row.latencyUs = 100 + i % 1000;
+}
+
+/*
+ * Appends into one segment, starting over in a fresh one when it is full
+ * so the run never needs more than a segment of disk.
+ */
+static void
+benchHistoryAppend (uint64_t iterations, void* priv) {
+    char           path[64];
+    history_row_t  row;
+    HistorySegment segment;
+
+    snprintf (path, sizeof (path), "/tmp/robe-bench-%d.rbh", getpid ());
+    unlink (path);
+    segment.create (path, 0);
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        historyRow (row, i);
+        if (!segment.append (row)) {
+            segment.close ();
+            unlink (path);
+            segment.create (path, row.timestamp);
+            segment.append (row);
+        }
+    }
+
+    segment.close ();
+    unlink (path);
+}
+
+#define BENCH_HISTORY_ROWS  (4 * HISTORY_SEGMENT_ROWS)
+
+/*
+ * One op is one row visited by a full time-range scan.
+ */
+static void
+countRow (const history_row_t& row, void* priv) {
+    sink += row.angles[0];
+}
+
+static void
+benchHistoryScan (uint64_t iterations, void* priv) {
+    MotionHistory* history = (MotionHistory*) priv;
+    uint64_t       visited = 0;
+
+    while (visited < iterations) {
+        visited += history->scan (0, UINT64_MAX, countRow, NULL);
+    }
+}
+
+/*
+ * One op is one dashboard query: the whole history in 60 buckets, mostly
+ * served from rollups.
+ */
+static void
+benchHistoryDownsample (uint64_t iterations, void* priv) {
+    MotionHistory*      history = (MotionHistory*) priv;
+    history_aggregate_t buckets[60];
+    Json::OutputBuffer  json;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t from  = 1000000000ULL;
+        uint64_t width = historyBucketWidth (from, from + BENCH_HISTORY_ROWS * 1000000ULL, 60);
+
+        historyDownsample (*history, from, width, 60, buckets);
+        json.clear ();
+        historyBucketsToJson (json, from, width, 60, buckets, IPC_MAX_MESSAGE);
+        sink += json.size ();
+    }
+}
+
+/*
+ * One op is a raw CONTROL_HISTORY reply of 1000 rows into a reused buffer.
+ */
+static void
+benchHistoryExport (uint64_t iterations, void* priv) {
+    MotionHistory*     history = (MotionHistory*) priv;
+    Json::OutputBuffer json;
+
+    for (uint64_t i = 0; i < iterations; i++) {
+        json.clear ();
+        historyRowsToJson (json, *history, 0, UINT64_MAX, 1000, IPC_MAX_MESSAGE);
+        sink += json.size ();
+    }
+}
+
+typedef struct {
+    WiseIPC*        server;
+    volatile bool   stop;
+} echo_server_t;
+
+static void
+echoCallback (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len, void* priv) {
+    ipc->sendMsg (client, data, len);
+}
+
+static void *
+echoServer (void* arg) {
+    echo_server_t* echo = (echo_server_t*) arg;
+
+    while (!echo->stop) {
+        echo->server->poll (10);
+    }
+
+    return NULL;
+}
+
+static void
+benchIpcRoundTrip (uint64_t iterations, void* priv) {
+    int                     mode = *(int*) priv;
+    char                    path[64];
+    echo_server_t           echo;
+    pthread_t               thread;
+    command_wire_t          wire;
+    vector<unsigned char>   reply;
+
+    snprintf (path, sizeof (path), "/tmp/robe-bench-%d.sock", getpid ());
+    WiseIPC server (path, mode);
+    WiseIPC client (path, mode);
+
+    server.setMessageCallback (echoCallback, NULL);
+    if (server.setServer () != SUCCESS) {
+        return;
+    }
+
+    echo.server = &server;
+    echo.stop   = false;
+    pthread_create (&thread, NULL, echoServer, &echo);
+
+    if (client.setClient () == 0) {
+        memset (&wire, 0, sizeof (wire));
+        wire.handler = SERVO;
+        for (uint64_t i = 0; i < iterations; i++) {
+            client.sendMsg (&wire, sizeof (wire));
+            client.readMsg (reply);
+        }
+    }
+
+    echo.stop = true;
+    pthread_join (thread, NULL);
+    unlink (path);
+}
+
+/*
+ * Doubles the iteration count until one run takes at least minTimeMs.
+ */
+static bool
+runBench (bench_t& bench, FILE* out, bool first) {
+    uint64_t iterations = 1;
+    uint64_t elapsed    = 0;
+
+    if (filter != NULL && strstr (bench.name, filter) == NULL) {
+        return false;
+    }
+
+    uint64_t allocs;
+    for (;;) {
+        uint64_t before = profileAllocations ();
+        uint64_t start  = monotonicNanos ();
+        bench.fn (iterations, bench.priv);
+        elapsed = monotonicNanos () - start;
+        allocs  = profileAllocations () - before;
+
+        if (elapsed >= (uint64_t) minTimeMs * 1000000ULL || iterations >= (1ULL << 40)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double nsPerOp = (double) elapsed / iterations;
+    fprintf (out, "%s\n    {\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"ops_per_sec\":%.0f,\"allocs_per_op\":%.2f",
+             first ? "" : ",", bench.name, (unsigned long long) iterations,
+             nsPerOp, 1e9 / nsPerOp, (double) allocs / iterations);
+    if (bench.bytes > 0) {
+        fprintf (out, ",\"mb_per_sec\":%.1f", bench.bytes * 1e3 / nsPerOp);
+    }
+    fprintf (out, "}");
+    fflush (out);
+
+    return true;
+}
+
+int
+main (int argc, char **argv) {
+    const char* output = NULL;
+    int         opt;
+    int         stream    = IPC_STREAM;
+    int         seqpacket = IPC_SEQPACKET;
+
+    while ((opt = getopt (argc, argv, "t:f:o:")) != -1) {
+        switch (opt) {
+            case 't':
+                minTimeMs = atoi (optarg);
+            break;
+            case 'f':
+                filter = optarg;
+            break;
+            case 'o':
+                output = optarg;
+            break;
+            default:
+                fprintf (stderr, "Usage: %s [-t min_ms] [-f filter] [-o output.json]\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    FILE* out = (output != NULL) ? fopen (output, "w") : stdout;
+    if (out == NULL) {
+        perror (output);
+        exit (EXIT_FAILURE);
+    }
+
+    char          historyDir[64];
+    MotionHistory history;
+    history_row_t row;
+
+    snprintf (historyDir, sizeof (historyDir), "/tmp/robe-bench-history-%d", getpid ());
+    removeDirectory (historyDir);
+    history.open (historyDir, true);
+    for (uint64_t i = 0; i < BENCH_HISTORY_ROWS; i++) {
+        historyRow (row, i);
+        history.append (row);
+    }
+
+    Json::Value smallObject;
+    Json::Value largeObject;
+    buildState (smallObject, 7);
+    buildState (largeObject, 7);
+    for (int i = 0; i < 59; i++) {
+        char name[8];
+        snprintf (name, sizeof (name), "k%d", i + 5);
+        largeObject[name] = i;
+    }
+
+    Json::Value settings;
+    buildSettings (settings);
+
+    string trajectory;
+    buildTrajectory (trajectory);
+
+    // Parse inputs: one command, a history export as CONTROL_HISTORY
+    // replies it, and indented state updates as a person would write them.
+    string command = coordinateJson;
+    Json::OutputBuffer historyRows;
+    historyRowsToJson (historyRows, history, 0, UINT64_MAX, 1000, IPC_MAX_MESSAGE);
+    string historyJson = historyRows.toString ();
+    Json::Value states (Json::arrayValue);
+    for (int i = 0; i < 200; i++) {
+        buildState (states.append (Json::Value ()), i);
+    }
+    string styledJson = Json::StyledWriter ().write (states);
+
+    profileCountAllocations (true);
+
+    bench_t benches[] = {
+        { "json_decode_coordinate", benchJsonDecode,      (void*) coordinateJson, 0 },
+        { "json_decode_servo",      benchJsonDecode,      (void*) servoJson, 0 },
+        { "json_decode_reals",      benchJsonDecode,      (void*) realsJson, 0 },
+        { "json_build_object",      benchJsonBuild,       NULL, 0 },
+        { "json_append_array",      benchJsonAppend,      NULL, 0 },
+        { "json_append_array_pool", benchJsonAppendPool,  NULL, 0 },
+        { "json_lookup_small",      benchJsonLookup,      &smallObject, 0 },
+        { "json_lookup_large",      benchJsonLookup,      &largeObject, 0 },
+        { "json_write_fast",        benchJsonWrite,       NULL, 0 },
+        { "json_write_buffer",      benchJsonWriteBuffer, NULL, 0 },
+        { "json_write_reals",       benchJsonWriteReals,  NULL, 0 },
+        { "json_path_parse",        benchJsonPathParse,   &settings, 0 },
+        { "json_path_compiled",     benchJsonPathCompiled, &settings, 0 },
+        { "json_path_cached",       benchJsonPathCached,  &settings, 0 },
+        { "json_trajectory_dom",    benchJsonTrajectoryDom,    &trajectory, trajectory.size () },
+        { "json_trajectory_pool",   benchJsonTrajectoryPool,   &trajectory, trajectory.size () },
+        { "json_trajectory_arena",  benchJsonTrajectoryArena,  &trajectory, trajectory.size () },
+        { "json_trajectory_events", benchJsonTrajectoryEvents, &trajectory, trajectory.size () },
+        { "json_trajectory_lazy",   benchJsonTrajectoryLazy,   &trajectory, trajectory.size () },
+        { "json_parse_command",     benchJsonParse,       &command,     command.size () },
+        { "json_parse_history",     benchJsonParse,       &historyJson, historyJson.size () },
+        { "json_parse_styled",      benchJsonParse,       &styledJson,  styledJson.size () },
+        { "wire_decode",            benchWireDecode,      NULL, 0 },
+        { "find_angles_map",        benchFindAnglesMap,   NULL, 0 },
+        { "ik_solve",               benchIkSolve,         NULL, 0 },
+        { "pulse_width",            benchPulseWidth,      NULL, 0 },
+        { "telemetry_format",       benchTelemetryFormat, NULL, 0 },
+        { "telemetry_ring_publish", benchTelemetryRing,   NULL, 0 },
+        { "command_ring_push_pop",  benchCommandRing,     NULL, 0 },
+        { "pwm_write_simulated",    benchSimulatedPwm,    NULL, 0 },
+        { "history_append",         benchHistoryAppend,   NULL, 0 },
+        { "history_scan",           benchHistoryScan,     &history, 0 },
+        { "history_downsample",     benchHistoryDownsample, &history, 0 },
+        { "history_export",         benchHistoryExport,   &history, historyJson.size () },
+        { "ipc_roundtrip_stream",   benchIpcRoundTrip,    &stream, 0 },
+        { "ipc_roundtrip_seqpacket",benchIpcRoundTrip,    &seqpacket, 0 },
+    };
+
+    fprintf (out, "{\"benchmark\":\"robe\",\"min_time_ms\":%d,\"results\":[", minTimeMs);
+    bool first = true;
+    for (size_t i = 0; i < sizeof (benches) / sizeof (benches[0]); i++) {
+        if (runBench (benches[i], out, first)) {
+            first = false;
+        }
+    }
+    fprintf (out, "\n]}\n");
+    removeDirectory (historyDir);
+
+    if (out != stdout) {
+        fclose (out);
+    }
+
+    return 0;
+}
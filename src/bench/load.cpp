@@ -0,0 +1,537 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Closed-loop load generator. Runs robe's ingress, command ring and motion
+ * controller in-process on the simulated PWM backend and drives them with a
+ * synthetic or recorded command stream:
+ *
+ *   robe_load [-m constant|bursty|walk|replay] [-r rate] [-b burst]
+ *             [-d seconds] [-t redis|ipc] [-q] [-R replay_file] [-F]
+ *             [-o output.json]
+ *
+ * The redis transport goes through a loopback stand-in for the ROBE-IN
+ * subscription (JSON payloads over a socketpair), the ipc transport through
+ * a WiseIPC server with command_wire_t frames, exactly as robe does.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+#include "arm.h"
+#include "command.h"
+#include "motion.h"
+#include "pwm.h"
+#include "stats.h"
+#include "uipc.h"
+
+#define LOAD_CONSTANT       0
+#define LOAD_BURSTY         1
+#define LOAD_WALK           2
+#define LOAD_REPLAY         3
+
+#define LOAD_REDIS          0
+#define LOAD_IPC            1
+
+#define LOAD_DRAIN_MS       5000    /* how long to wait for the ring to empty */
+#define LOAD_REPORT_MS      1000
+
+using namespace std;
+
+typedef struct {
+    uint64_t    offsetNs;
+    string      json;
+} replay_entry_t;
+
+typedef struct {
+    int             mode;
+    int             transport;
+    int             ipcMode;
+    double          rate;
+    int             burst;
+    double          duration;
+    bool            fast;
+    const char*     replayPath;
+    const char*     output;
+    const char*     tracePath;
+} load_config_t;
+
+static load_config_t config = { LOAD_CONSTANT, LOAD_REDIS, IPC_STREAM, 50, 10, 10, false, NULL, NULL, NULL };
+
+static CommandRing      commandRing;
+static SimulatedPwm     pwm;
+static MotionController motion;
+static TickProfiler     tickProfiler;
+static volatile bool    stopping    = false;
+static volatile bool    ingressDone = false;
+
+static volatile uint64_t sent        = 0;
+static volatile uint64_t received    = 0;
+static volatile uint64_t dropped     = 0;
+static volatile uint64_t executed    = 0;
+static volatile uint64_t coalesced   = 0;
+static volatile uint64_t rejected    = 0;
+static volatile uint64_t published   = 0;
+static uint64_t          depthSum    = 0;
+static uint64_t          depthSamples= 0;
+static uint32_t          depthMax    = 0;
+
+static const char* modeNames[]      = { "constant", "bursty", "walk", "replay" };
+static const char* transportNames[] = { "redis", "ipc" };
+
+static void
+ingress (command_t& cmd, uint8_t source, uint64_t receivedAt) {
+    __atomic_fetch_add (&received, 1, __ATOMIC_RELAXED);
+    if (!motionEnqueue (commandRing, cmd, source, receivedAt)) {
+        __atomic_fetch_add (&dropped, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void
+publishCallback (char* msg, void* priv) {
+    __atomic_fetch_add (&published, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t
+pwmWrites () {
+    uint64_t total = 0;
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        total += pwm.getWrites (joint);
+    }
+
+    return total;
+}
+
+/*
+ * Same loop as robe's main thread. A command that is carried out without a
+ * single PWM write was absorbed by the arm already being there, which is
+ * what happens when a burst repeats or overtakes a target.
+ */
+static void *
+motionThread (void *) {
+    command_t cmd;
+
+    while (!stopping) {
+        if (!commandRing.wait (100)) {
+            continue;
+        }
+
+        while (!stopping && commandRing.pop (cmd)) {
+            uint64_t before = pwmWrites ();
+
+            if (!motion.execute (cmd)) {
+                __atomic_fetch_add (&rejected, 1, __ATOMIC_RELAXED);
+            } else if (pwmWrites () == before) {
+                __atomic_fetch_add (&coalesced, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_fetch_add (&executed, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Loopback stand-in for the Redis subscription: the generator "publishes"
+ * length-prefixed JSON on one end of a socketpair and this thread plays
+ * subCallback on the other.
+ */
+static int pubsub[2] = { -1, -1 };
+
+static bool
+readAll (int fd, void* data, size_t len) {
+    size_t offset = 0;
+
+    while (offset < len) {
+        ssize_t count = read (fd, (char*) data + offset, len - offset);
+        if (count == 0 || (count == -1 && errno != EINTR)) {
+            return false;
+        }
+        if (count > 0) {
+            offset += count;
+        }
+    }
+
+    return true;
+}
+
+static void *
+redisStandIn (void *) {
+    vector<char> payload;
+    uint32_t     len;
+
+    while (readAll (pubsub[1], &len, sizeof (len))) {
+        payload.resize (len + 1);
+        if (!readAll (pubsub[1], &payload[0], len)) {
+            break;
+        }
+        payload[len] = '\0';
+
+        uint64_t  receivedAt = monotonicNanos ();
+        command_t cmd;
+        if (commandFromJson (&payload[0], cmd)) {
+            ingress (cmd, COMMAND_SOURCE_REDIS, receivedAt);
+        }
+    }
+
+    ingressDone = true;
+    return NULL;
+}
+
+static bool
+redisPublish (const char* json) {
+    uint32_t     len = strlen (json);
+    struct iovec iov[2];
+
+    iov[0].iov_base = &len;
+    iov[0].iov_len  = sizeof (len);
+    iov[1].iov_base = (void*) json;
+    iov[1].iov_len  = len;
+
+    return writev (pubsub[0], iov, 2) == (ssize_t)(sizeof (len) + len);
+}
+
+static WiseIPC* ipcServer = NULL;
+static WiseIPC* ipcClient = NULL;
+
+static void
+ipcMessageCallback (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len, void* priv) {
+    uint64_t  receivedAt = monotonicNanos ();
+    command_t cmd;
+
+    if (commandFromWire (data, len, cmd)) {
+        ingress (cmd, COMMAND_SOURCE_IPC, receivedAt);
+    }
+}
+
+static void *
+ipcServerThread (void *) {
+    while (!stopping) {
+        ipcServer->poll (50);
+    }
+
+    ingressDone = true;
+    return NULL;
+}
+
+static bool
+sendCommand (const char* json) {
+    bool ok;
+
+    if (config.transport == LOAD_REDIS) {
+        ok = redisPublish (json);
+    } else {
+        command_t      cmd;
+        command_wire_t wire;
+
+        if (!commandFromJson (json, cmd)) {
+            return false;
+        }
+        commandToWire (cmd, wire);
+        ok = ipcClient->sendMsg (&wire, sizeof (wire));
+    }
+
+    if (ok) {
+        sent++;
+    }
+
+    uint32_t depth = commandRing.depth ();
+    depthSum += depth;
+    depthSamples++;
+    if (depth > depthMax) {
+        depthMax = depth;
+    }
+
+    return ok;
+}
+
+static void
+report (uint64_t start, uint64_t now) {
+    fprintf (stderr, "%6.1fs sent %llu executed %llu dropped %llu depth %u\n",
+             (now - start) / 1e9, (unsigned long long) sent,
+             (unsigned long long) executed, (unsigned long long) dropped,
+             commandRing.depth ());
+}
+
+/*
+ * <offset_ms> <json> per line, offsets relative to the start of the run.
+ */
+static bool
+loadReplay (const char* path, vector<replay_entry_t>& entries) {
+    FILE* file = fopen (path, "r");
+    char  line[1024];
+
+    if (file == NULL) {
+        perror (path);
+        return false;
+    }
+
+    while (fgets (line, sizeof (line), file) != NULL) {
+        char*          json;
+        replay_entry_t entry;
+        double         offsetMs = strtod (line, &json);
+
+        if (json == line) {
+            continue;
+        }
+        while (*json == ' ' || *json == '\t') {
+            json++;
+        }
+        json[strcspn (json, "\r\n")] = '\0';
+
+        entry.offsetNs = offsetMs * 1000000.0;
+        entry.json     = json;
+        entries.push_back (entry);
+    }
+
+    fclose (file);
+    return true;
+}
+
+static void
+formatCoordinate (char* json, size_t size, int x, int y, int z) {
+    snprintf (json, size, "{\"handler\":%d,\"x\":%d,\"y\":%d,\"z\":%d,\"p\":1}", COORDINATE, x, y, z);
+}
+
+static void
+generate (uint64_t start) {
+    uint64_t    end        = start + (uint64_t)(config.duration * 1e9);
+    uint64_t    interval   = (uint64_t)(1e9 / config.rate);
+    uint64_t    next       = start;
+    uint64_t    nextReport = start + LOAD_REPORT_MS * 1000000ULL;
+    unsigned    seed       = 1;
+    int         x = 2, y = 2, z = 1;
+    char        json[128];
+    vector<replay_entry_t> entries;
+    size_t      replayPos  = 0;
+
+    if (config.mode == LOAD_REPLAY && !loadReplay (config.replayPath, entries)) {
+        return;
+    }
+
+    for (;;) {
+        uint64_t now = monotonicNanos ();
+
+        if (now >= nextReport) {
+            report (start, now);
+            nextReport += LOAD_REPORT_MS * 1000000ULL;
+        }
+
+        if (now >= end) {
+            break;
+        }
+
+        switch (config.mode) {
+            case LOAD_CONSTANT:
+                formatCoordinate (json, sizeof (json), 1 + rand_r (&seed) % 3,
+                                  1 + rand_r (&seed) % 3, 1 + rand_r (&seed) % 6);
+                sendCommand (json);
+                next += interval;
+            break;
+            case LOAD_BURSTY:
+                for (int i = 0; i < config.burst; i++) {
+                    formatCoordinate (json, sizeof (json), 1 + rand_r (&seed) % 3,
+                                      1 + rand_r (&seed) % 3, 1 + rand_r (&seed) % 6);
+                    sendCommand (json);
+                }
+                next += interval * config.burst;
+            break;
+            case LOAD_WALK: {
+                int  step = (rand_r (&seed) & 1) ? 1 : -1;
+                int* axis = (rand_r (&seed) % 3 == 0) ? &x : (rand_r (&seed) & 1) ? &y : &z;
+                int  top  = (axis == &z) ? 6 : 3;
+
+                if (*axis + step < 1 || *axis + step > top) {
+                    step = -step;
+                }
+                *axis += step;
+
+                formatCoordinate (json, sizeof (json), x, y, z);
+                sendCommand (json);
+                next += interval;
+            }
+            break;
+            case LOAD_REPLAY:
+                if (replayPos == entries.size ()) {
+                    return;
+                }
+                sendCommand (entries[replayPos++].json.c_str ());
+                if (replayPos < entries.size ()) {
+                    next = start + entries[replayPos].offsetNs;
+                }
+            break;
+        }
+
+        sleepUntilNanos ((next < nextReport) ? next : nextReport);
+    }
+}
+
+int
+main (int argc, char **argv) {
+    int opt;
+
+    while ((opt = getopt (argc, argv, "m:r:b:d:t:qR:Fo:T:")) != -1) {
+        switch (opt) {
+            case 'm':
+                for (config.mode = LOAD_REPLAY; config.mode > 0; config.mode--) {
+                    if (strcmp (optarg, modeNames[config.mode]) == 0) {
+                        break;
+                    }
+                }
+            break;
+            case 'r':
+                config.rate = atof (optarg);
+            break;
+            case 'b':
+                config.burst = atoi (optarg);
+            break;
+            case 'd':
+                config.duration = atof (optarg);
+            break;
+            case 't':
+                config.transport = (strcmp (optarg, "ipc") == 0) ? LOAD_IPC : LOAD_REDIS;
+            break;
+            case 'q':
+                config.ipcMode = IPC_SEQPACKET;
+            break;
+            case 'R':
+                config.mode       = LOAD_REPLAY;
+                config.replayPath = optarg;
+            break;
+            case 'F':
+                config.fast = true;
+            break;
+            case 'o':
+                config.output = optarg;
+            break;
+            case 'T':
+                config.tracePath = optarg;
+            break;
+            default:
+                fprintf (stderr, "Usage: %s [-m constant|bursty|walk|replay] [-r rate] [-b burst] "
+                                 "[-d seconds] [-t redis|ipc] [-q] [-R replay_file] [-F] [-o output.json] [-T trace.json]\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    if (config.rate <= 0 || config.burst <= 0 ||
+        (config.mode == LOAD_REPLAY && config.replayPath == NULL)) {
+        fprintf (stderr, "Invalid load configuration...\n");
+        exit (EXIT_FAILURE);
+    }
+
+    motion.setBackend (&pwm);
+    motion.setPublishCallback (publishCallback, NULL);
+    motion.setStepDelay (config.fast ? 0 : SERVO_STEP_DELAY_US);
+    motion.setTickProfiler (&tickProfiler);
+    tickProfiler.setTracing (config.tracePath != NULL);
+    motion.start ();
+
+    pthread_t ingressThread, motionWorker;
+    char      path[64];
+
+    if (config.transport == LOAD_REDIS) {
+        if (socketpair (AF_UNIX, SOCK_STREAM, 0, pubsub) == -1) {
+            perror ("socketpair");
+            exit (EXIT_FAILURE);
+        }
+        pthread_create (&ingressThread, NULL, redisStandIn, NULL);
+    } else {
+        snprintf (path, sizeof (path), "/tmp/robe-load-%d.sock", getpid ());
+        ipcServer = new WiseIPC (path, config.ipcMode);
+        ipcClient = new WiseIPC (path, config.ipcMode);
+        ipcServer->setMessageCallback (ipcMessageCallback, NULL);
+        if (ipcServer->setServer () != SUCCESS) {
+            fprintf (stderr, "IPC server on %s failed...\n", path);
+            exit (EXIT_FAILURE);
+        }
+        pthread_create (&ingressThread, NULL, ipcServerThread, NULL);
+        if (ipcClient->setClient () != 0) {
+            fprintf (stderr, "IPC client on %s failed...\n", path);
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    // Only the commands of the run itself, not the homing moves.
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        latencyStats[stage].reset ();
+    }
+
+    pthread_create (&motionWorker, NULL, motionThread, NULL);
+
+    uint64_t start = monotonicNanos ();
+    generate (start);
+    uint64_t generated = monotonicNanos ();
+
+    // Let everything that made it into the ring finish before measuring.
+    uint64_t drainEnd = generated + LOAD_DRAIN_MS * 1000000ULL;
+    while (received < sent && monotonicNanos () < drainEnd) {
+        usleep (1000);
+    }
+    while (executed < received - dropped && monotonicNanos () < drainEnd) {
+        usleep (1000);
+    }
+    uint64_t finished = monotonicNanos ();
+
+    stopping = true;
+    if (config.transport == LOAD_REDIS) {
+        shutdown (pubsub[0], SHUT_WR);
+    }
+    pthread_join (ingressThread, NULL);
+    pthread_join (motionWorker, NULL);
+    if (config.transport == LOAD_IPC) {
+        delete ipcClient;
+        delete ipcServer;
+        unlink (path);
+    }
+
+    char stats[1024];
+    if (statsToJson (stats, sizeof (stats)) <= 0) {
+        strcpy (stats, "{}");
+    }
+
+    char ticks[256];
+    if (tickProfiler.toJson (ticks, sizeof (ticks)) <= 0) {
+        strcpy (ticks, "{}");
+    }
+
+    if (config.tracePath != NULL && tickProfiler.dumpChromeTrace (config.tracePath) == -1) {
+        perror (config.tracePath);
+    }
+
+    FILE* out = (config.output != NULL) ? fopen (config.output, "w") : stdout;
+    if (out == NULL) {
+        perror (config.output);
+        exit (EXIT_FAILURE);
+    }
+
+    double elapsed = (finished - start) / 1e9;
+    fprintf (out, "{\"mode\":\"%s\",\"transport\":\"%s\",\"rate\":%.1f,\"burst\":%d,\"fast\":%s,"
+                  "\"elapsed_s\":%.3f,\"sent\":%llu,\"received\":%llu,\"executed\":%llu,"
+                  "\"dropped\":%llu,\"pending\":%llu,\"coalesced\":%llu,\"rejected\":%llu,\"published\":%llu,"
+                  "\"throughput\":%.1f,\"queue_depth\":{\"mean\":%.2f,\"max\":%u},\"latency_ns\":%s,\"ticks\":%s}\n",
+             modeNames[config.mode], transportNames[config.transport], config.rate, config.burst,
+             config.fast ? "true" : "false", elapsed,
+             (unsigned long long) sent, (unsigned long long) received, (unsigned long long) executed,
+             (unsigned long long) dropped, (unsigned long long) (received - dropped - executed),
+             (unsigned long long) coalesced, (unsigned long long) rejected,
+             (unsigned long long) published, executed / elapsed,
+             depthSamples ? (double) depthSum / depthSamples : 0.0, depthMax, stats, ticks);
+
+    if (out != stdout) {
+        fclose (out);
+    }
+
+    return 0;
+}
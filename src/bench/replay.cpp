@@ -0,0 +1,240 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Feeds a recording made with robe -R back through the ingress, command ring
+ * and motion controller on the simulated PWM backend and compares the PWM
+ * trace it produces with the recorded one:
+ *
+ *   robe_replay [-F] [-o replay.rec] recording
+ *
+ * Commands are replayed at their recorded receive times, or back to back
+ * with -F (servo ramps then run without sleeping as well). Prints a JSON
+ * report and exits with 1 when the traces differ. A recording the recorder
+ * dropped entries from cannot be compared: it is reported as incomplete
+ * and exits with 2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cstring>
+#include <vector>
+
+#include "command.h"
+#include "motion.h"
+#include "pwm.h"
+#include "recorder.h"
+#include "stats.h"
+
+using namespace std;
+
+typedef struct {
+    uint16_t    width;
+    uint64_t    timestamp;
+} pwm_sample_t;
+
+/*
+ * SimulatedPwm that also keeps every write, only ever called from the
+ * motion thread.
+ */
+class TracingPwm : public SimulatedPwm {
+    public:
+        void pulseWidth (int channel, int us) {
+            SimulatedPwm::pulseWidth (channel, us);
+            if (channel >= BASE && channel <= WHRIST) {
+                pwm_sample_t sample = { (uint16_t) us, monotonicNanos () };
+                this->trace[channel].push_back (sample);
+            }
+        }
+
+        vector<pwm_sample_t> trace[4];
+};
+
+static CommandRing      commandRing;
+static TracingPwm       pwm;
+static MotionController motion;
+static volatile bool    stopping = false;
+static volatile uint64_t executed = 0;
+
+static void *
+motionThread (void *) {
+    command_t cmd;
+
+    while (!stopping) {
+        if (!commandRing.wait (100)) {
+            continue;
+        }
+
+        while (commandRing.pop (cmd)) {
+            motion.execute (cmd);
+            __atomic_fetch_add (&executed, 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    return NULL;
+}
+
+int
+main (int argc, char **argv) {
+    const char*         output = NULL;
+    bool                fast   = false;
+    int                 opt;
+    RecordingReader     reader;
+    Recorder            recorder;
+    recording_entry_t   entry;
+    vector<recording_entry_t> commands;
+    vector<pwm_sample_t>      recorded[4];
+    uint64_t                  lost = 0;
+
+    while ((opt = getopt (argc, argv, "Fo:")) != -1) {
+        switch (opt) {
+            case 'F':
+                fast = true;
+            break;
+            case 'o':
+                output = optarg;
+            break;
+            default:
+                fprintf (stderr, "Usage: %s [-F] [-o replay.rec] recording\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    if (optind >= argc || !reader.open (argv[optind])) {
+        fprintf (stderr, "Usage: %s [-F] [-o replay.rec] recording\n", argv[0]);
+        exit (EXIT_FAILURE);
+    }
+
+    while (reader.next (entry)) {
+        if (entry.type == RECORDING_COMMAND) {
+            commands.push_back (entry);
+        } else if (entry.type == RECORDING_LOST) {
+            lost += entry.lost;
+        } else if (entry.source <= WHRIST) {
+            pwm_sample_t sample = { entry.width, entry.timestamp };
+            recorded[entry.source].push_back (sample);
+        }
+    }
+
+    if (output != NULL && !recorder.open (output)) {
+        perror (output);
+        exit (EXIT_FAILURE);
+    }
+
+    motion.setBackend (&pwm);
+    motion.setStepDelay (fast ? 0 : SERVO_STEP_DELAY_US);
+    motion.setRecorder (output != NULL ? &recorder : NULL);
+    motion.start ();
+
+    pthread_t worker;
+    pthread_create (&worker, NULL, motionThread, NULL);
+
+    uint64_t start    = monotonicNanos ();
+    uint64_t enqueued = 0;
+    uint64_t dropped  = 0;
+
+    for (size_t i = 0; i < commands.size (); i++) {
+        command_t cmd;
+
+        if (!commandFromWire ((const unsigned char*) &commands[i].wire, sizeof (commands[i].wire), cmd)) {
+            continue;
+        }
+
+        if (fast) {
+            // Never drop in fast mode, wait for the motion thread instead.
+            while (commandRing.depth () >= COMMAND_RING_SIZE) {
+                usleep (50);
+            }
+        } else {
+            sleepUntilNanos (start + (commands[i].timestamp - commands[0].timestamp));
+        }
+
+        if (motionEnqueue (commandRing, cmd, commands[i].source, monotonicNanos (),
+                           (output != NULL) ? &recorder : NULL)) {
+            enqueued++;
+        } else {
+            dropped++;
+        }
+    }
+
+    while (__atomic_load_n (&executed, __ATOMIC_ACQUIRE) < enqueued) {
+        usleep (1000);
+    }
+    double elapsed = (monotonicNanos () - start) / 1e9;
+
+    stopping = true;
+    pthread_join (worker, NULL);
+    recorder.close ();
+
+    // Same writes in the same order per joint; timing only as drift
+    // relative to each trace's first write.
+    LatencyHistogram drift;
+    uint64_t recordedCount = 0, replayedCount = 0, mismatches = 0;
+    int      firstJoint = -1;
+    size_t   firstIndex = 0;
+    uint64_t recordedBase = UINT64_MAX, replayedBase = UINT64_MAX;
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        if (!recorded[joint].empty () && recorded[joint][0].timestamp < recordedBase) {
+            recordedBase = recorded[joint][0].timestamp;
+        }
+        if (!pwm.trace[joint].empty () && pwm.trace[joint][0].timestamp < replayedBase) {
+            replayedBase = pwm.trace[joint][0].timestamp;
+        }
+    }
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        vector<pwm_sample_t>& a = recorded[joint];
+        vector<pwm_sample_t>& b = pwm.trace[joint];
+        size_t common = (a.size () < b.size ()) ? a.size () : b.size ();
+
+        recordedCount += a.size ();
+        replayedCount += b.size ();
+
+        for (size_t i = 0; i < common; i++) {
+            int64_t delta = (int64_t)(b[i].timestamp - replayedBase) - (int64_t)(a[i].timestamp - recordedBase);
+
+            drift.record ((delta < 0) ? -delta : delta);
+            if (a[i].width != b[i].width) {
+                if (mismatches++ == 0) {
+                    firstJoint = joint;
+                    firstIndex = i;
+                }
+            }
+        }
+
+        if (a.size () != b.size ()) {
+            if (mismatches == 0) {
+                firstJoint = joint;
+                firstIndex = common;
+            }
+            mismatches += (a.size () > b.size ()) ? a.size () - b.size () : b.size () - a.size ();
+        }
+    }
+
+    printf ("{\"commands\":%zu,\"enqueued\":%llu,\"dropped\":%llu,\"fast\":%s,\"elapsed_s\":%.3f,"
+            "\"recorded_pwm\":%llu,\"replayed_pwm\":%llu,\"mismatches\":%llu,",
+            commands.size (), (unsigned long long) enqueued, (unsigned long long) dropped,
+            fast ? "true" : "false", elapsed, (unsigned long long) recordedCount,
+            (unsigned long long) replayedCount, (unsigned long long) mismatches);
+    if (firstJoint == -1) {
+        printf ("\"first_mismatch\":null,");
+    } else {
+        printf ("\"first_mismatch\":{\"joint\":%d,\"index\":%zu},", firstJoint, firstIndex);
+    }
+    printf ("\"recording_lost\":%llu,\"drift_ns\":{\"p50\":%llu,\"p99\":%llu,\"max\":%llu}}\n",
+            (unsigned long long) lost,
+            (unsigned long long) drift.percentile (50.0), (unsigned long long) drift.percentile (99.0),
+            (unsigned long long) drift.max ());
+
+    if (lost > 0) {
+        fprintf (stderr, "recording incomplete: %llu entries lost while recording\n", (unsigned long long) lost);
+        return 2;
+    }
+
+    return (mismatches == 0) ? EXIT_SUCCESS : 1;
+}
@@ -0,0 +1,225 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <cstring>
+#include <time.h>
+
+#include "json/json.h"
+#include "command.h"
+#include "log.h"
+#include "profile.h"
+
+using namespace std;
+
+/* Longest realtime wait when sem_clockwait is missing. */
+#define COMMAND_WAIT_SLICE_MS   100
+
+bool
+commandFromJson (const char* json, command_t& cmd) {
+    ProfileStage       stage (PROFILE_STAGE_PARSE);
+    Json::LazyDocument doc;
+
+    // Only the fields read below get decoded, the rest is just skipped.
+    if (!doc.parse (json, json + strlen (json))) {
+        LOG_WARN ("Failed to parse command: %s", doc.getFormattedErrorMessages ().c_str ());
+        return false;
+    }
+
+    Json::LazyValue root = doc.root ();
+
+    memset (&cmd, 0, sizeof (cmd));
+    cmd.handler = root.get("handler", 0).asInt();
+    switch (cmd.handler) {
+        case COORDINATE:
+            cmd.x = root.get("x", 0).asFloat();
+            cmd.y = root.get("y", 0).asFloat();
+            cmd.z = root.get("z", 0).asFloat();
+            cmd.p = root.get("p", 0).asFloat();
+        break;
+        case SERVO:
+            cmd.id    = root.get("id", 0).asInt();
+            cmd.angle = root.get("angle", 0).asInt();
+        break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+bool
+commandFromWire (const unsigned char* data, uint32_t len, command_t& cmd) {
+    ProfileStage   stage (PROFILE_STAGE_PARSE);
+    command_wire_t wire;
+
+    if (len != sizeof (wire)) {
+        return false;
+    }
+
+    memcpy (&wire, data, sizeof (wire));
+    if (wire.handler != COORDINATE && wire.handler != SERVO) {
+        return false;
+    }
+
+    memset (&cmd, 0, sizeof (cmd));
+    cmd.handler = wire.handler;
+    cmd.id      = wire.id;
+    cmd.angle   = wire.angle;
+    cmd.x       = wire.x;
+    cmd.y       = wire.y;
+    cmd.z       = wire.z;
+    cmd.p       = wire.p;
+
+    return true;
+}
+
+void
+commandToWire (const command_t& cmd, command_wire_t& wire) {
+    wire.handler = cmd.handler;
+    wire.id      = cmd.id;
+    wire.angle   = cmd.angle;
+    wire.x       = cmd.x;
+    wire.y       = cmd.y;
+    wire.z       = cmd.z;
+    wire.p       = cmd.p;
+}
+
+/*
+ * State update published on MODULE-INFO after a servo moved.
+ */
+void
+servoMsgFactory (char* buffer, int id, int angle) {
+    sprintf (buffer, "{\"type\":\"SERVO\",\"id\":\"%d\",\"angle\":\"%d\"}", id, angle);
+}
+
+CommandRing::CommandRing () {
+    for (uint32_t i = 0; i < COMMAND_RING_SIZE; i++) {
+        this->slots[i].sequence = i;
+    }
+
+    this->head = 0;
+    this->tail = 0;
+    sem_init (&this->ready, 0, 0);
+}
+
+CommandRing::~CommandRing () {
+    sem_destroy (&this->ready);
+}
+
+bool
+CommandRing::push (const command_t& cmd) {
+    uint32_t pos = __atomic_load_n (&this->head, __ATOMIC_RELAXED);
+    slot_t*  slot;
+
+    for (;;) {
+        slot = &this->slots[pos & (COMMAND_RING_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n (&this->head, &pos, pos + 1, true,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; /* full */
+        } else {
+            pos = __atomic_load_n (&this->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->cmd = cmd;
+    __atomic_store_n (&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    sem_post (&this->ready);
+
+    return true;
+}
+
+bool
+CommandRing::pop (command_t& cmd) {
+    uint32_t pos  = this->tail;
+    slot_t*  slot = &this->slots[pos & (COMMAND_RING_SIZE - 1)];
+
+    if ((int32_t)(__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) - (pos + 1)) < 0) {
+        return false; /* empty */
+    }
+
+    cmd = slot->cmd;
+    __atomic_store_n (&slot->sequence, pos + COMMAND_RING_SIZE, __ATOMIC_RELEASE);
+    __atomic_store_n (&this->tail, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void
+CommandRing::wait () {
+    while (sem_wait (&this->ready) == -1 && errno == EINTR);
+}
+
+static void
+addMs (struct timespec& ts, int ms) {
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+}
+
+/*
+ * Returns false when nothing was pushed within timeoutMs, measured on
+ * CLOCK_MONOTONIC so a wall clock step (NTP after boot) does not move it.
+ * Without sem_clockwait (glibc < 2.30) the wait is cut into realtime slices
+ * of at most COMMAND_WAIT_SLICE_MS against the monotonic deadline: a step
+ * forward only ends a slice early, a step back still stretches one slice.
+ */
+bool
+CommandRing::wait (int timeoutMs) {
+    struct timespec deadline;
+
+    clock_gettime (CLOCK_MONOTONIC, &deadline);
+    addMs (deadline, timeoutMs);
+
+#if defined(__GLIBC_PREREQ) && __GLIBC_PREREQ(2, 30)
+    for (;;) {
+        if (sem_clockwait (&this->ready, CLOCK_MONOTONIC, &deadline) == 0) {
+            return true;
+        }
+
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+#else
+    for (;;) {
+        struct timespec now;
+        struct timespec slice;
+
+        clock_gettime (CLOCK_MONOTONIC, &now);
+        int64_t left = (deadline.tv_sec - now.tv_sec) * 1000LL + (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+        if (left <= 0) {
+            return sem_trywait (&this->ready) == 0;
+        }
+
+        clock_gettime (CLOCK_REALTIME, &slice);
+        addMs (slice, (left < COMMAND_WAIT_SLICE_MS) ? (int) left : COMMAND_WAIT_SLICE_MS);
+        if (sem_timedwait (&this->ready, &slice) == 0) {
+            return true;
+        }
+
+        if (errno != EINTR && errno != ETIMEDOUT) {
+            return false;
+        }
+    }
+#endif
+}
+
+uint32_t
+CommandRing::depth () {
+    return __atomic_load_n (&this->head, __ATOMIC_RELAXED) -
+           __atomic_load_n (&this->tail, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,718 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+using namespace std;
+
+static const size_t columnSizes[HISTORY_COLUMNS] = {
+    sizeof (uint64_t), sizeof (uint8_t), sizeof (uint8_t),
+    sizeof (float), sizeof (float), sizeof (float), sizeof (int32_t),
+    sizeof (int16_t), sizeof (int16_t), sizeof (int16_t), sizeof (int16_t),
+    sizeof (uint32_t)
+};
+
+/*
+ * Wall clock, since history has to line up across restarts and with the
+ * web UI.
+ */
+uint64_t
+historyNow () {
+    struct timespec now;
+
+    clock_gettime (CLOCK_REALTIME, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static const uint64_t rollupNanos[HISTORY_ROLLUP_LEVELS] = {
+    HISTORY_ROLLUP_NS, 1000000000ULL
+};
+
+uint64_t
+historyRollupNanos (int level) {
+    return rollupNanos[level];
+}
+
+uint32_t
+historyRollupSlots (int level) {
+    return HISTORY_ROLLUP_SLOTS * (HISTORY_ROLLUP_NS / rollupNanos[level]);
+}
+
+static size_t
+segmentLayout (uint64_t* offsets, uint64_t* rollupOffsets) {
+    size_t offset = sizeof (history_header_t);
+
+    for (int column = 0; column < HISTORY_COLUMNS; column++) {
+        offset = (offset + 63) & ~(size_t) 63;
+        offsets[column] = offset;
+        offset += columnSizes[column] * HISTORY_SEGMENT_ROWS;
+    }
+
+    for (int level = 0; level < HISTORY_ROLLUP_LEVELS; level++) {
+        offset = (offset + 63) & ~(size_t) 63;
+        rollupOffsets[level] = offset;
+        offset += sizeof (history_rollup_t) * historyRollupSlots (level);
+    }
+
+    return offset;
+}
+
+void
+historyAggregateReset (history_aggregate_t& a) {
+    memset (&a, 0, sizeof (a));
+    for (int joint = 0; joint < 4; joint++) {
+        a.min[joint] = INT16_MAX;
+        a.max[joint] = INT16_MIN;
+    }
+}
+
+void
+historyAggregateAdd (history_aggregate_t& a, const history_row_t& row) {
+    a.count++;
+    if (row.outcome == HISTORY_OK) {
+        a.ok++;
+    } else {
+        a.rejected++;
+    }
+
+    a.latencySumUs += row.latencyUs;
+    if (row.latencyUs > a.latencyMaxUs) {
+        a.latencyMaxUs = row.latencyUs;
+    }
+
+    for (int joint = 0; joint < 4; joint++) {
+        a.sum[joint] += row.angles[joint];
+        if (row.angles[joint] < a.min[joint]) {
+            a.min[joint] = row.angles[joint];
+        }
+        if (row.angles[joint] > a.max[joint]) {
+            a.max[joint] = row.angles[joint];
+        }
+    }
+}
+
+void
+historyAggregateMerge (history_aggregate_t& a, const history_aggregate_t& b) {
+    a.count        += b.count;
+    a.ok           += b.ok;
+    a.rejected     += b.rejected;
+    a.latencySumUs += b.latencySumUs;
+    if (b.latencyMaxUs > a.latencyMaxUs) {
+        a.latencyMaxUs = b.latencyMaxUs;
+    }
+
+    for (int joint = 0; joint < 4; joint++) {
+        a.sum[joint] += b.sum[joint];
+        if (b.min[joint] < a.min[joint]) {
+            a.min[joint] = b.min[joint];
+        }
+        if (b.max[joint] > a.max[joint]) {
+            a.max[joint] = b.max[joint];
+        }
+    }
+}
+
+HistorySegment::HistorySegment () {
+    this->header   = NULL;
+    this->base     = NULL;
+    this->size     = 0;
+    this->writable = false;
+}
+
+HistorySegment::~HistorySegment () {
+    this->close ();
+}
+
+bool
+HistorySegment::map (int fd, size_t size, bool writable) {
+    void* mem = mmap (NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close (fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    this->base     = (unsigned char*) mem;
+    this->header   = (history_header_t*) mem;
+    this->size     = size;
+    this->writable = writable;
+
+    return true;
+}
+
+bool
+HistorySegment::create (const string& path, uint64_t firstTimestamp) {
+    uint64_t offsets[HISTORY_COLUMNS];
+    uint64_t rollupOffsets[HISTORY_ROLLUP_LEVELS];
+    size_t   size = segmentLayout (offsets, rollupOffsets);
+    int      fd   = ::open (path.c_str (), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    if (ftruncate (fd, size) == -1 || !this->map (fd, size, true)) {
+        unlink (path.c_str ());
+        return false;
+    }
+
+    this->path = path;
+    memcpy (this->header->offsets, offsets, sizeof (offsets));
+    this->header->version           = HISTORY_VERSION;
+    this->header->columns           = HISTORY_COLUMNS;
+    this->header->capacity          = HISTORY_SEGMENT_ROWS;
+    this->header->rows              = 0;
+    this->header->firstTimestamp    = firstTimestamp;
+    this->header->lastTimestamp     = firstTimestamp;
+    this->header->rollupBase        = firstTimestamp / HISTORY_ROLLUP_NS;
+    memcpy (this->header->rollupOffsets, rollupOffsets, sizeof (rollupOffsets));
+
+    for (int level = 0; level < HISTORY_ROLLUP_LEVELS; level++) {
+        history_rollup_t* rollups = (history_rollup_t*) (this->base + rollupOffsets[level]);
+        for (uint32_t slot = 0; slot < historyRollupSlots (level); slot++) {
+            historyAggregateReset (rollups[slot].aggregate);
+        }
+    }
+    __atomic_store_n (&this->header->magic, HISTORY_MAGIC, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool
+HistorySegment::open (const string& path, bool writable) {
+    struct stat st;
+    int fd = ::open (path.c_str (), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    if (fstat (fd, &st) == -1 || (size_t) st.st_size < sizeof (history_header_t)) {
+        ::close (fd);
+        return false;
+    }
+
+    if (!this->map (fd, st.st_size, writable)) {
+        return false;
+    }
+
+    this->path = path;
+    history_header_t* h = this->header;
+    if (__atomic_load_n (&h->magic, __ATOMIC_ACQUIRE) != HISTORY_MAGIC ||
+        h->version != HISTORY_VERSION || h->columns != HISTORY_COLUMNS ||
+        h->offsets[HISTORY_COLUMNS - 1] + columnSizes[HISTORY_COLUMNS - 1] * h->capacity > this->size ||
+        h->rollupOffsets[HISTORY_ROLLUP_LEVELS - 1] +
+            sizeof (history_rollup_t) * historyRollupSlots (HISTORY_ROLLUP_LEVELS - 1) > this->size) {
+        this->close ();
+        return false;
+    }
+
+    return true;
+}
+
+void
+HistorySegment::close () {
+    if (this->base != NULL) {
+        munmap (this->base, this->size);
+    }
+
+    this->base   = NULL;
+    this->header = NULL;
+}
+
+/*
+ * False when the segment is full or read-only.
+ */
+bool
+HistorySegment::append (const history_row_t& row) {
+    history_header_t* h = this->header;
+    uint32_t index      = h->rows;
+
+    if (!this->writable || index >= h->capacity) {
+        return false;
+    }
+
+    ((uint64_t*) (this->base + h->offsets[HISTORY_COL_TIMESTAMP]))[index] = row.timestamp;
+    ((uint8_t*)  (this->base + h->offsets[HISTORY_COL_HANDLER]))[index]   = row.handler;
+    ((uint8_t*)  (this->base + h->offsets[HISTORY_COL_OUTCOME]))[index]   = row.outcome;
+    ((float*)    (this->base + h->offsets[HISTORY_COL_X]))[index]         = row.x;
+    ((float*)    (this->base + h->offsets[HISTORY_COL_Y]))[index]         = row.y;
+    ((float*)    (this->base + h->offsets[HISTORY_COL_Z]))[index]         = row.z;
+    ((int32_t*)  (this->base + h->offsets[HISTORY_COL_P]))[index]         = row.p;
+    for (int joint = 0; joint < 4; joint++) {
+        ((int16_t*) (this->base + h->offsets[HISTORY_COL_ANGLE + joint]))[index] = row.angles[joint];
+    }
+    ((uint32_t*) (this->base + h->offsets[HISTORY_COL_LATENCY]))[index]   = row.latencyUs;
+
+    for (int level = 0; level < HISTORY_ROLLUP_LEVELS; level++) {
+        uint64_t slot = row.timestamp / rollupNanos[level] - this->rollupStart (level);
+        if (slot >= historyRollupSlots (level)) {
+            continue;
+        }
+
+        history_rollup_t* rollup = (history_rollup_t*) (this->base + h->rollupOffsets[level]) + slot;
+        uint32_t          seq    = rollup->sequence;
+
+        __atomic_store_n (&rollup->sequence, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence (__ATOMIC_RELEASE);
+        historyAggregateAdd (rollup->aggregate, row);
+        __atomic_store_n (&rollup->sequence, seq + 2, __ATOMIC_RELEASE);
+    }
+
+    h->lastTimestamp = row.timestamp;
+    __atomic_store_n (&h->rows, index + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void
+HistorySegment::read (uint32_t index, history_row_t& row) {
+    history_header_t* h = this->header;
+
+    row.timestamp = ((const uint64_t*) (this->base + h->offsets[HISTORY_COL_TIMESTAMP]))[index];
+    row.handler   = ((const uint8_t*)  (this->base + h->offsets[HISTORY_COL_HANDLER]))[index];
+    row.outcome   = ((const uint8_t*)  (this->base + h->offsets[HISTORY_COL_OUTCOME]))[index];
+    row.x         = ((const float*)    (this->base + h->offsets[HISTORY_COL_X]))[index];
+    row.y         = ((const float*)    (this->base + h->offsets[HISTORY_COL_Y]))[index];
+    row.z         = ((const float*)    (this->base + h->offsets[HISTORY_COL_Z]))[index];
+    row.p         = ((const int32_t*)  (this->base + h->offsets[HISTORY_COL_P]))[index];
+    for (int joint = 0; joint < 4; joint++) {
+        row.angles[joint] = ((const int16_t*) (this->base + h->offsets[HISTORY_COL_ANGLE + joint]))[index];
+    }
+    row.latencyUs = ((const uint32_t*) (this->base + h->offsets[HISTORY_COL_LATENCY]))[index];
+}
+
+/*
+ * First row at or after timestamp, rows () when there is none.
+ */
+uint32_t
+HistorySegment::lowerBound (uint64_t timestamp) {
+    const uint64_t* ts = (const uint64_t*) this->column (HISTORY_COL_TIMESTAMP);
+
+    return lower_bound (ts, ts + this->rows (), timestamp) - ts;
+}
+
+/*
+ * Consistent copy of one rollup. A writer that died mid-update leaves the
+ * sequence odd in the file for good, so after HISTORY_ROLLUP_RETRIES tries
+ * the slot is reported unavailable and the caller goes to the rows.
+ */
+int
+HistorySegment::rollup (int level, uint32_t slot, history_aggregate_t& aggregate) {
+    if (slot >= historyRollupSlots (level)) {
+        return HISTORY_ROLLUP_EMPTY;
+    }
+
+    const history_rollup_t* rollup = (const history_rollup_t*) (this->base + this->header->rollupOffsets[level]) + slot;
+
+    for (uint32_t attempt = 0;; attempt++) {
+        if (attempt == HISTORY_ROLLUP_RETRIES) {
+            return HISTORY_ROLLUP_UNAVAILABLE;
+        }
+
+        uint32_t before = __atomic_load_n (&rollup->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue;
+        }
+
+        memcpy (&aggregate, (const void*) &rollup->aggregate, sizeof (aggregate));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n (&rollup->sequence, __ATOMIC_RELAXED) == before) {
+            break;
+        }
+    }
+
+    return (aggregate.count > 0) ? HISTORY_ROLLUP_READY : HISTORY_ROLLUP_EMPTY;
+}
+
+/*
+ * Recomputes from the rows every rollup a dead writer left mid-update and
+ * closes its sequence. Only for the writer. Returns the slots repaired.
+ */
+uint32_t
+HistorySegment::repairRollups () {
+    const uint64_t* ts       = (const uint64_t*) this->column (HISTORY_COL_TIMESTAMP);
+    uint32_t        rows     = this->rows ();
+    uint32_t        repaired = 0;
+    history_row_t   row;
+
+    if (!this->writable) {
+        return 0;
+    }
+
+    for (int level = 0; level < HISTORY_ROLLUP_LEVELS; level++) {
+        history_rollup_t* rollups = (history_rollup_t*) (this->base + this->header->rollupOffsets[level]);
+        uint64_t          ns      = rollupNanos[level];
+
+        for (uint32_t slot = 0; slot < historyRollupSlots (level); slot++) {
+            uint32_t seq = __atomic_load_n (&rollups[slot].sequence, __ATOMIC_ACQUIRE);
+            if ((seq & 1) == 0) {
+                continue;
+            }
+
+            uint64_t start = (this->rollupStart (level) + slot) * ns;
+            historyAggregateReset (rollups[slot].aggregate);
+            for (uint32_t r = this->lowerBound (start); r < rows && ts[r] < start + ns; r++) {
+                this->read (r, row);
+                historyAggregateAdd (rollups[slot].aggregate, row);
+            }
+            __atomic_store_n (&rollups[slot].sequence, seq + 1, __ATOMIC_RELEASE);
+            repaired++;
+        }
+    }
+
+    return repaired;
+}
+
+/*
+ * Which minute or second, counted from the epoch, slot 0 of a level covers.
+ */
+uint64_t
+HistorySegment::rollupStart (int level) {
+    return this->header->rollupBase * (HISTORY_ROLLUP_NS / rollupNanos[level]);
+}
+
+uint32_t
+HistorySegment::rows () {
+    return __atomic_load_n (&this->header->rows, __ATOMIC_ACQUIRE);
+}
+
+uint32_t
+HistorySegment::capacity () {
+    return this->header->capacity;
+}
+
+uint64_t
+HistorySegment::firstTimestamp () {
+    return this->header->firstTimestamp;
+}
+
+uint64_t
+HistorySegment::lastTimestamp () {
+    return __atomic_load_n (&this->header->lastTimestamp, __ATOMIC_RELAXED);
+}
+
+const void*
+HistorySegment::column (int column) {
+    return this->base + this->header->offsets[column];
+}
+
+const string&
+HistorySegment::getPath () {
+    return this->path;
+}
+
+MotionHistory::MotionHistory () {
+    this->writable = false;
+    this->uses     = 0;
+    this->current  = NULL;
+}
+
+MotionHistory::~MotionHistory () {
+    if (find (this->mapped.begin (), this->mapped.end (), this->current) == this->mapped.end ()) {
+        delete this->current;
+    }
+
+    for (size_t i = 0; i < this->mapped.size (); i++) {
+        delete this->mapped[i];
+    }
+}
+
+static bool
+segmentOrder (const history_segment_info_t& a, const history_segment_info_t& b) {
+    return a.firstTimestamp < b.firstTimestamp;
+}
+
+/*
+ * Picks up segments created (or removed) since the last look. Mappings of
+ * segments that are still there are kept.
+ */
+void
+MotionHistory::refresh () {
+    vector<history_segment_info_t> found;
+    DIR* d = opendir (this->dir.c_str ());
+
+    if (d == NULL) {
+        return;
+    }
+
+    struct dirent* e;
+    while ((e = readdir (d)) != NULL) {
+        size_t len = strlen (e->d_name);
+        char*  end = NULL;
+
+        if (len <= strlen (HISTORY_SUFFIX) || strcmp (e->d_name + len - strlen (HISTORY_SUFFIX), HISTORY_SUFFIX) != 0) {
+            continue;
+        }
+
+        history_segment_info_t info;
+        info.firstTimestamp = strtoull (e->d_name, &end, 10);
+        if (end != e->d_name + len - strlen (HISTORY_SUFFIX)) {
+            continue;
+        }
+        info.path = this->dir + "/" + e->d_name;
+        found.push_back (info);
+    }
+    closedir (d);
+
+    sort (found.begin (), found.end (), segmentOrder);
+
+    vector<HistorySegment*> kept (found.size (), (HistorySegment*) NULL);
+    vector<uint64_t>        keptUse (found.size (), 0);
+    for (size_t i = 0; i < this->index.size (); i++) {
+        bool reused = false;
+
+        for (size_t j = 0; j < found.size () && this->mapped[i] != NULL; j++) {
+            if (found[j].path == this->index[i].path) {
+                kept[j]    = this->mapped[i];
+                keptUse[j] = this->lastUse[i];
+                reused     = true;
+                break;
+            }
+        }
+
+        if (!reused && this->mapped[i] != this->current) {
+            delete this->mapped[i];
+        }
+    }
+
+    this->index.swap (found);
+    this->mapped.swap (kept);
+    this->lastUse.swap (keptUse);
+}
+
+bool
+MotionHistory::open (const string& dir, bool writable) {
+    this->dir      = dir;
+    this->writable = writable;
+
+    if (writable && mkdir (dir.c_str (), 0755) == -1 && errno != EEXIST) {
+        return false;
+    }
+
+    struct stat st;
+    if (stat (dir.c_str (), &st) == -1 || !S_ISDIR (st.st_mode)) {
+        return false;
+    }
+
+    this->refresh ();
+    if (!writable || this->index.empty ()) {
+        return true;
+    }
+
+    // Keep appending to the newest segment if it still has room. Either
+    // way it is the one a previous writer may have died in.
+    HistorySegment* last = new HistorySegment ();
+    bool            opened = last->open (this->index.back ().path, true);
+    if (opened) {
+        last->repairRollups ();
+    }
+    if (opened && last->rows () < last->capacity () &&
+        historyNow () - last->firstTimestamp () < HISTORY_SEGMENT_NS) {
+        delete this->mapped.back ();
+        this->mapped.back () = last;
+        this->current        = last;
+    } else {
+        delete last;
+    }
+
+    return true;
+}
+
+bool
+MotionHistory::rotate (uint64_t timestamp) {
+    char name[64];
+
+    snprintf (name, sizeof (name), "%020llu%s", (unsigned long long) timestamp, HISTORY_SUFFIX);
+
+    HistorySegment* segment = new HistorySegment ();
+    if (!segment->create (this->dir + "/" + name, timestamp)) {
+        delete segment;
+        return false;
+    }
+
+    // The full segment is only read from now on, and mapped again for that.
+    if (this->current != NULL) {
+        replace (this->mapped.begin (), this->mapped.end (), this->current, (HistorySegment*) NULL);
+        delete this->current;
+    }
+
+    history_segment_info_t info;
+    info.firstTimestamp = timestamp;
+    info.path           = segment->getPath ();
+    this->index.push_back (info);
+    this->mapped.push_back (segment);
+    this->lastUse.push_back (++this->uses);
+    this->current = segment;
+
+    while (this->index.size () > HISTORY_MAX_SEGMENTS) {
+        unlink (this->index.front ().path.c_str ());
+        delete this->mapped.front ();
+        this->index.erase (this->index.begin ());
+        this->mapped.erase (this->mapped.begin ());
+        this->lastUse.erase (this->lastUse.begin ());
+    }
+
+    return true;
+}
+
+/*
+ * The last timestamp written to the directory, 0 when it is empty. Also
+ * covers the newest segment of a previous writer, which is not current
+ * when it was full or too old to keep appending to.
+ */
+uint64_t
+MotionHistory::lastTimestamp () {
+    if (this->current != NULL) {
+        return this->current->lastTimestamp ();
+    }
+    if (this->index.empty ()) {
+        return 0;
+    }
+
+    HistorySegment* newest = this->segment (this->index.size () - 1);
+    return (newest != NULL) ? newest->lastTimestamp () : this->index.back ().firstTimestamp;
+}
+
+/*
+ * Stamps the row if it has no timestamp yet. Timestamps are clamped so they
+ * never go backwards, within a segment or across segments, even if the wall
+ * clock does, so the index stays sorted.
+ */
+bool
+MotionHistory::append (history_row_t& row) {
+    if (!this->writable) {
+        return false;
+    }
+
+    if (row.timestamp == 0) {
+        row.timestamp = historyNow ();
+    }
+
+    uint64_t last = this->lastTimestamp ();
+    if (row.timestamp < last) {
+        row.timestamp = last;
+    }
+
+    if (this->current == NULL || this->current->rows () >= this->current->capacity () ||
+        row.timestamp - this->current->firstTimestamp () >= HISTORY_SEGMENT_NS) {
+        // A full segment of equal timestamps would leave the new one with
+        // the same name.
+        if (!this->index.empty () && row.timestamp <= this->index.back ().firstTimestamp) {
+            row.timestamp = this->index.back ().firstTimestamp + 1;
+        }
+        if (!this->rotate (row.timestamp)) {
+            return false;
+        }
+    }
+
+    return this->current->append (row);
+}
+
+const vector<history_segment_info_t>&
+MotionHistory::segments () {
+    return this->index;
+}
+
+/*
+ * Unmaps the least recently used segments beyond HISTORY_MAX_MAPPED. The
+ * one being written is neither counted nor unmapped.
+ */
+void
+MotionHistory::unmapIdle () {
+    for (;;) {
+        size_t count  = 0;
+        size_t oldest = this->mapped.size ();
+
+        for (size_t i = 0; i < this->mapped.size (); i++) {
+            if (this->mapped[i] == NULL || this->mapped[i] == this->current) {
+                continue;
+            }
+            count++;
+            if (oldest == this->mapped.size () || this->lastUse[i] < this->lastUse[oldest]) {
+                oldest = i;
+            }
+        }
+
+        if (count <= HISTORY_MAX_MAPPED) {
+            return;
+        }
+        delete this->mapped[oldest];
+        this->mapped[oldest] = NULL;
+    }
+}
+
+/*
+ * Maps segments on use, see unmapIdle. NULL when the file is gone or
+ * unreadable.
+ */
+HistorySegment*
+MotionHistory::segment (size_t i) {
+    if (i >= this->index.size ()) {
+        return NULL;
+    }
+
+    this->lastUse[i] = ++this->uses;
+    if (this->mapped[i] == NULL) {
+        HistorySegment* segment = new HistorySegment ();
+
+        if (!segment->open (this->index[i].path, false)) {
+            delete segment;
+            return NULL;
+        }
+        this->mapped[i] = segment;
+        this->unmapIdle ();
+    }
+
+    return this->mapped[i];
+}
+
+/*
+ * Calls back for every row with from <= timestamp < to, oldest first.
+ * Returns the number of rows visited.
+ */
+uint64_t
+MotionHistory::scan (uint64_t from, uint64_t to, history_row_callback_t callback, void* priv) {
+    uint64_t      visited = 0;
+    history_row_t row;
+
+    for (size_t i = 0; i < this->index.size (); i++) {
+        if (this->index[i].firstTimestamp >= to) {
+            break;
+        }
+
+        if (i + 1 < this->index.size () && this->index[i + 1].firstTimestamp <= from) {
+            continue;
+        }
+
+        HistorySegment* segment = this->segment (i);
+        if (segment == NULL) {
+            continue;
+        }
+
+        uint32_t rows = segment->rows ();
+        const uint64_t* ts = (const uint64_t*) segment->column (HISTORY_COL_TIMESTAMP);
+        for (uint32_t r = segment->lowerBound (from); r < rows && ts[r] < to; r++) {
+            segment->read (r, row);
+            callback (row, priv);
+            visited++;
+        }
+    }
+
+    return visited;
+}
@@ -164,6 +164,165 @@ static inline void fixNumericLocale(char* begin, char* end) {
   }
 }
 
+// Byte scanners for the readers: where a whitespace run ends, and where
+// the next '"' or '\\' in a string is. The SSE2 and AVX2 versions test 16
+// or 32 bytes per step and are chosen once, by what the CPU supports; the
+// scalar ones serve other CPUs and the last bytes before end. None reads
+// past end.
+typedef const char* (*ByteScanner)(const char* current, const char* end);
+
+struct ByteScanners {
+  ByteScanner skipSpaces;
+  ByteScanner findQuoteOrEscape;
+};
+
+static inline bool isJsonSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static const char* skipSpacesScalar(const char* current, const char* end) {
+  while (current != end && isJsonSpace(*current))
+    ++current;
+  return current;
+}
+
+static const char* findQuoteOrEscapeScalar(const char* current,
+                                           const char* end) {
+  while (current != end && *current != '"' && *current != '\\')
+    ++current;
+  return current;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) &&         \
+    !defined(JSON_NO_SIMD)
+#define JSON_USE_SIMD_SCAN 1
+#include <immintrin.h>
+
+__attribute__((target("sse2"))) static const char*
+skipSpacesSse2(const char* current, const char* end) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  for (; end - current >= 16; current += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+        _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+    unsigned int other = ~unsigned(_mm_movemask_epi8(ws)) & 0xFFFFU;
+    if (other)
+      return current + __builtin_ctz(other);
+  }
+  return skipSpacesScalar(current, end);
+}
+
+__attribute__((target("sse2"))) static const char*
+findQuoteOrEscapeSse2(const char* current, const char* end) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  for (; end - current >= 16; current += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    unsigned int found = unsigned(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash))));
+    if (found)
+      return current + __builtin_ctz(found);
+  }
+  return findQuoteOrEscapeScalar(current, end);
+}
+
+__attribute__((target("avx2"))) static const char*
+skipSpacesAvx2(const char* current, const char* end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  for (; end - current >= 32; current += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+    __m256i ws = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+    unsigned int other = ~unsigned(_mm256_movemask_epi8(ws));
+    if (other)
+      return current + __builtin_ctz(other);
+  }
+  // Not skipSpacesSse2: calling legacy SSE code with the upper halves of
+  // the registers dirty costs more than the whole scan.
+  if (end - current >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(space)),
+                     _mm_cmpeq_epi8(v, _mm256_castsi256_si128(tab))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(cr)),
+                     _mm_cmpeq_epi8(v, _mm256_castsi256_si128(lf))));
+    unsigned int other = ~unsigned(_mm_movemask_epi8(ws)) & 0xFFFFU;
+    if (other)
+      return current + __builtin_ctz(other);
+    current += 16;
+  }
+  return skipSpacesScalar(current, end);
+}
+
+__attribute__((target("avx2"))) static const char*
+findQuoteOrEscapeAvx2(const char* current, const char* end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  for (; end - current >= 32; current += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(current));
+    unsigned int found = unsigned(_mm256_movemask_epi8(_mm256_or_si256(
+        _mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash))));
+    if (found)
+      return current + __builtin_ctz(found);
+  }
+  if (end - current >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current));
+    unsigned int found = unsigned(_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(quote)),
+                     _mm_cmpeq_epi8(v, _mm256_castsi256_si128(backslash)))));
+    if (found)
+      return current + __builtin_ctz(found);
+    current += 16;
+  }
+  return findQuoteOrEscapeScalar(current, end);
+}
+#endif // if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+static ByteScanners selectByteScanners() {
+  ByteScanners scanners = {skipSpacesScalar, findQuoteOrEscapeScalar};
+#if defined(JSON_USE_SIMD_SCAN)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    scanners.skipSpaces = skipSpacesAvx2;
+    scanners.findQuoteOrEscape = findQuoteOrEscapeAvx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    scanners.skipSpaces = skipSpacesSse2;
+    scanners.findQuoteOrEscape = findQuoteOrEscapeSse2;
+  }
+#endif
+  return scanners;
+}
+
+// A function static rather than a global, so readers used by other static
+// initializers already find it set.
+static const ByteScanners& byteScanners() {
+  static const ByteScanners scanners = selectByteScanners();
+  return scanners;
+}
+
+static inline const char* skipJsonSpaces(const char* current,
+                                         const char* end) {
+  // Most runs are one space or none; only longer ones are worth the call.
+  if (current == end || !isJsonSpace(*current))
+    return current;
+  if (++current == end || !isJsonSpace(*current))
+    return current;
+  return byteScanners().skipSpaces(current, end);
+}
+
+static inline const char* findQuoteOrEscape(const char* current,
+                                            const char* end) {
+  return byteScanners().findQuoteOrEscape(current, end);
+}
+
 } // namespace Json {
 
 #endif // LIB_JSONCPP_JSON_TOOL_H_INCLUDED
@@ -193,7 +352,10 @@ static inline void fixNumericLocale(char* begin, char* end) {
 #include "json_tool.h"
 #endif // if !defined(JSON_IS_AMALGAMATION)
 #include <utility>
+#include <cfloat>
+#include <clocale>
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
 #include <cstring>
 #include <istream>
@@ -270,7 +432,7 @@ Reader::Reader(const Features& features)
 bool
 Reader::parse(const std::string& document, Value& root, bool collectComments) {
   document_ = document;
-  const char* begin = document_.c_str();
+  const char* begin = document_.data();
   const char* end = begin + document_.length();
   return parse(begin, end, root, collectComments);
 }
@@ -281,11 +443,11 @@ bool Reader::parse(std::istream& sin, Value& root, bool collectComments) {
   // Those would allow streamed input from a file, if parse() were a
   // template function.
 
-  // Since std::string is reference-counted, this at least does not
-  // create an extra copy.
-  std::string doc;
-  std::getline(sin, doc, (char)EOF);
-  return parse(doc, root, collectComments);
+  // The document is read straight into document_, so it is never copied.
+  document_.clear();
+  std::getline(sin, document_, (char)EOF);
+  const char* begin = document_.data();
+  return parse(begin, begin + document_.length(), root, collectComments);
 }
 
 bool Reader::parse(const char* beginDoc,
@@ -363,17 +525,17 @@ bool Reader::readValue() {
     successful = decodeString(token);
     break;
   case tokenTrue:
-    currentValue() = true;
+    Value(true).swap(currentValue());
     currentValue().setOffsetStart(token.start_ - begin_);
     currentValue().setOffsetLimit(token.end_ - begin_);
     break;
   case tokenFalse:
-    currentValue() = false;
+    Value(false).swap(currentValue());
     currentValue().setOffsetStart(token.start_ - begin_);
     currentValue().setOffsetLimit(token.end_ - begin_);
     break;
   case tokenNull:
-    currentValue() = Value();
+    Value().swap(currentValue());
     currentValue().setOffsetStart(token.start_ - begin_);
     currentValue().setOffsetLimit(token.end_ - begin_);
     break;
@@ -382,7 +544,7 @@ bool Reader::readValue() {
       // "Un-read" the current token and mark the current value as a null
       // token.
       current_--;
-      currentValue() = Value();
+      Value().swap(currentValue());
       currentValue().setOffsetStart(current_ - begin_ - 1);
       currentValue().setOffsetLimit(current_ - begin_);
       break;
@@ -490,15 +652,7 @@ bool Reader::readToken(Token& token) {
   return true;
 }
 
-void Reader::skipSpaces() {
-  while (current_ != end_) {
-    Char c = *current_;
-    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
-      ++current_;
-    else
-      break;
-  }
-}
+void Reader::skipSpaces() { current_ = skipJsonSpaces(current_, end_); }
 
 bool Reader::match(Location pattern, int patternLength) {
   if (end_ - current_ < patternLength)
@@ -575,21 +729,23 @@ void Reader::readNumber() {
 }
 
 bool Reader::readString() {
-  Char c = 0;
   while (current_ != end_) {
-    c = getNextChar();
-    if (c == '\\')
-      getNextChar();
-    else if (c == '"')
+    current_ = findQuoteOrEscape(current_, end_);
+    if (current_ == end_)
       break;
+    if (*current_++ == '"')
+      return true;
+    // Skip what the backslash escapes, it cannot end the string.
+    if (current_ != end_)
+      ++current_;
   }
-  return c == '"';
+  return false;
 }
 
 bool Reader::readObject(Token& tokenStart) {
   Token tokenName;
   std::string name;
-  currentValue() = Value(objectValue);
+  Value(objectValue).swap(currentValue());
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   while (readToken(tokenName)) {
     bool initialTokenOk = true;
@@ -642,7 +798,7 @@ bool Reader::readObject(Token& tokenStart) {
 }
 
 bool Reader::readArray(Token& tokenStart) {
-  currentValue() = Value(arrayValue);
+  Value(arrayValue).swap(currentValue());
   currentValue().setOffsetStart(tokenStart.start_ - begin_);
   skipSpaces();
   if (*current_ == ']') // empty array
@@ -682,57 +838,190 @@ bool Reader::decodeNumber(Token& token) {
   Value decoded;
   if (!decodeNumber(token, decoded))
     return false;
-  currentValue() = decoded;
+  currentValue().swap(decoded);
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
   return true;
 }
 
-bool Reader::decodeNumber(Token& token, Value& decoded) {
-  bool isDouble = false;
-  for (Location inspect = token.start_; inspect != token.end_; ++inspect) {
-    isDouble = isDouble || in(*inspect, '.', 'e', 'E', '+') ||
-               (*inspect == '-' && inspect != token.start_);
-  }
-  if (isDouble)
-    return decodeDouble(token, decoded);
-  // Attempts to parse the number as an integer. If the number is
-  // larger than the maximum supported value of an integer then
-  // we decode the number as a double.
-  Location current = token.start_;
-  bool isNegative = *current == '-';
+#if defined(JSON_HAS_INT64) && defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+// Clinger's fast path: with at most 2^53 as decimal significand and a
+// power of ten up to 10^22, both are exact doubles and the one multiply or
+// divide rounds correctly. Needs double arithmetic without x87 excess
+// precision, hence FLT_EVAL_METHOD. Anything else returns false.
+static bool parseDoubleFast(const char* current, const char* end,
+                            double& value) {
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  const UInt64 maxExact = 1ULL << 53;
+  UInt64 significand = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  bool isNegative = current != end && *current == '-';
   if (isNegative)
     ++current;
-  Value::LargestUInt maxIntegerValue =
-      isNegative ? Value::LargestUInt(-Value::minLargestInt)
-                 : Value::maxLargestUInt;
-  Value::LargestUInt threshold = maxIntegerValue / 10;
-  Value::LargestUInt value = 0;
-  while (current < token.end_) {
-    Char c = *current++;
-    if (c < '0' || c > '9')
-      return addError("'" + std::string(token.start_, token.end_) +
-                          "' is not a number.",
-                      token);
-    Value::UInt digit(c - '0');
-    if (value >= threshold) {
-      // We've hit or exceeded the max value divided by 10 (rounded down). If
-      // a) we've only just touched the limit, b) this is the last digit, and
-      // c) it's small enough to fit in that rounding delta, we're okay.
-      // Otherwise treat this number as a double to avoid overflow.
-      if (value > threshold || current != token.end_ ||
-          digit > maxIntegerValue % 10) {
-        return decodeDouble(token, decoded);
-      }
+  if (current == end || *current < '0' || *current > '9')
+    return false;
+  for (; current != end && *current >= '0' && *current <= '9'; ++current) {
+    if (digits == 19)
+      return false;
+    significand = significand * 10 + (*current - '0');
+    digits += significand != 0;
+  }
+  if (current != end && *current == '.') {
+    if (++current == end || *current < '0' || *current > '9')
+      return false;
+    for (; current != end && *current >= '0' && *current <= '9'; ++current) {
+      if (digits == 19)
+        return false;
+      significand = significand * 10 + (*current - '0');
+      digits += significand != 0;
+      exponent--;
+    }
+  }
+  if (current != end && (*current == 'e' || *current == 'E')) {
+    ++current;
+    bool isNegativeExponent = current != end && *current == '-';
+    if (current != end && (*current == '-' || *current == '+'))
+      ++current;
+    if (current == end || *current < '0' || *current > '9')
+      return false;
+    int e = 0;
+    for (; current != end && *current >= '0' && *current <= '9'; ++current) {
+      if (e > 1000)
+        return false;
+      e = e * 10 + (*current - '0');
     }
-    value = value * 10 + digit;
+    exponent += isNegativeExponent ? -e : e;
+  }
+  if (current != end || significand > maxExact)
+    return false;
+
+  if (significand == 0) {
+    value = isNegative ? -0.0 : 0.0;
+    return true;
+  }
+  // 123e25 is 123000e22: move what fits into the significand.
+  while (exponent > 22 && significand * 10 <= maxExact) {
+    significand *= 10;
+    exponent--;
   }
+  if (exponent > 22 || exponent < -22)
+    return false;
+
+  value = double(significand);
+  if (exponent > 0)
+    value *= pow10[exponent];
+  else if (exponent < 0)
+    value /= pow10[-exponent];
   if (isNegative)
-    decoded = -Value::LargestInt(value);
-  else if (value <= Value::LargestUInt(Value::maxInt))
-    decoded = Value::LargestInt(value);
-  else
-    decoded = value;
+    value = -value;
+  return true;
+}
+#else
+static bool parseDoubleFast(const char*, const char*, double&) {
+  return false;
+}
+#endif
+
+// strtod, with the token's '.' swapped for the locale's decimal point so
+// the result does not depend on setlocale. True when some prefix parsed,
+// as sscanf("%lf") had it.
+static bool parseDoubleSlow(const char* begin, const char* end,
+                            double& value) {
+  char point = *localeconv()->decimal_point;
+  char small[64];
+  std::string large;
+  size_t length = size_t(end - begin);
+  char* buffer = small;
+
+  if (length >= sizeof(small)) {
+    large.assign(begin, end);
+    buffer = &large[0];
+  } else {
+    memcpy(buffer, begin, length);
+    buffer[length] = 0;
+  }
+  if (point != '.' && point != 0) {
+    for (char* c = buffer; *c; ++c) {
+      if (*c == '.')
+        *c = point;
+    }
+  }
+
+  char* stop;
+  value = strtod(buffer, &stop);
+  return stop != buffer;
+}
+
+// The number in [begin, end) as an int or uint Value, or as a real one when
+// it has a fraction or exponent or does not fit. False if it is not a
+// number.
+static bool decodeNumberToken(const char* begin, const char* end,
+                              Value& decoded) {
+  bool isDouble = false;
+  for (const char* inspect = begin; inspect != end; ++inspect) {
+    isDouble = isDouble || in(*inspect, '.', 'e', 'E', '+') ||
+               (*inspect == '-' && inspect != begin);
+  }
+  if (!isDouble) {
+    // Attempts to parse the number as an integer. If the number is
+    // larger than the maximum supported value of an integer then
+    // we decode the number as a double.
+    const char* current = begin;
+    bool isNegative = *current == '-';
+    if (isNegative)
+      ++current;
+    Value::LargestUInt maxIntegerValue =
+        isNegative ? Value::LargestUInt(Value::maxLargestInt) + 1
+                   : Value::maxLargestUInt;
+    Value::LargestUInt threshold = maxIntegerValue / 10;
+    Value::LargestUInt value = 0;
+    while (current < end) {
+      char c = *current++;
+      if (c < '0' || c > '9')
+        return false;
+      Value::UInt digit(c - '0');
+      if (value >= threshold) {
+        // We've hit or exceeded the max value divided by 10 (rounded down).
+        // If a) we've only just touched the limit, b) this is the last
+        // digit, and c) it's small enough to fit in that rounding delta,
+        // we're okay. Otherwise treat this number as a double to avoid
+        // overflow.
+        if (value > threshold || current != end ||
+            digit > maxIntegerValue % 10) {
+          isDouble = true;
+          break;
+        }
+      }
+      value = value * 10 + digit;
+    }
+    if (!isDouble) {
+      if (isNegative)
+        decoded = Value::LargestInt(0 - value);
+      else if (value <= Value::LargestUInt(Value::maxInt))
+        decoded = Value::LargestInt(value);
+      else
+        decoded = value;
+      return true;
+    }
+  }
+
+  double value = 0;
+  if (!parseDoubleFast(begin, end, value) && !parseDoubleSlow(begin, end, value))
+    return false;
+  decoded = value;
+  return true;
+}
+
+bool Reader::decodeNumber(Token& token, Value& decoded) {
+  if (!decodeNumberToken(token.start_, token.end_, decoded))
+    return addError("'" + std::string(token.start_, token.end_) +
+                        "' is not a number.",
+                    token);
   return true;
 }
 
@@ -740,7 +1029,7 @@ bool Reader::decodeDouble(Token& token) {
   Value decoded;
   if (!decodeDouble(token, decoded))
     return false;
-  currentValue() = decoded;
+  currentValue().swap(decoded);
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
   return true;
@@ -748,33 +1037,14 @@ bool Reader::decodeDouble(Token& token) {
 
 bool Reader::decodeDouble(Token& token, Value& decoded) {
   double value = 0;
-  const int bufferSize = 32;
-  int count;
-  int length = int(token.end_ - token.start_);
 
   // Sanity check to avoid buffer overflow exploits.
-  if (length < 0) {
+  if (token.end_ < token.start_) {
     return addError("Unable to parse token length", token);
   }
 
-  // Avoid using a string constant for the format control string given to
-  // sscanf, as this can cause hard to debug crashes on OS X. See here for more
-  // info:
-  //
-  //     http://developer.apple.com/library/mac/#DOCUMENTATION/DeveloperTools/gcc-4.0.1/gcc/Incompatibilities.html
-  char format[] = "%lf";
-
-  if (length <= bufferSize) {
-    Char buffer[bufferSize + 1];
-    memcpy(buffer, token.start_, length);
-    buffer[length] = 0;
-    count = sscanf(buffer, format, &value);
-  } else {
-    std::string buffer(token.start_, token.end_);
-    count = sscanf(buffer.c_str(), format, &value);
-  }
-
-  if (count != 1)
+  if (!parseDoubleFast(token.start_, token.end_, value) &&
+      !parseDoubleSlow(token.start_, token.end_, value))
     return addError("'" + std::string(token.start_, token.end_) +
                         "' is not a number.",
                     token);
@@ -786,7 +1056,7 @@ bool Reader::decodeString(Token& token) {
   std::string decoded;
   if (!decodeString(token, decoded))
     return false;
-  currentValue() = decoded;
+  Value(decoded).swap(currentValue());
   currentValue().setOffsetStart(token.start_ - begin_);
   currentValue().setOffsetLimit(token.end_ - begin_);
   return true;
@@ -797,6 +1067,11 @@ bool Reader::decodeString(Token& token, std::string& decoded) {
   Location current = token.start_ + 1; // skip '"'
   Location end = token.end_ - 1;       // do not include '"'
   while (current != end) {
+    Location special = findQuoteOrEscape(current, end);
+    decoded.append(current, special);
+    if (special == end)
+      break;
+    current = special;
     Char c = *current++;
     if (c == '"')
       break;
@@ -838,8 +1113,6 @@ bool Reader::decodeString(Token& token, std::string& decoded) {
       default:
         return addError("Bad escape sequence in string", token, current);
       }
-    } else {
-      decoded += c;
     }
   }
   return true;
@@ -1015,6 +1288,919 @@ std::vector<Reader::StructuredError> Reader::getStructuredErrors() const {
   return allErrors;
 }
 
+// class ReaderHandler
+// //////////////////////////////////////////////////////////////////
+
+ReaderHandler::~ReaderHandler() {}
+
+bool ReaderHandler::onStartObject() { return true; }
+
+bool ReaderHandler::onKey(const char*, const char*) { return true; }
+
+bool ReaderHandler::onEndObject() { return true; }
+
+bool ReaderHandler::onStartArray() { return true; }
+
+bool ReaderHandler::onEndArray() { return true; }
+
+bool ReaderHandler::onString(const char*, const char*) { return true; }
+
+bool ReaderHandler::onInt(LargestInt) { return true; }
+
+bool ReaderHandler::onUInt(LargestUInt) { return true; }
+
+bool ReaderHandler::onReal(double) { return true; }
+
+bool ReaderHandler::onBool(bool) { return true; }
+
+bool ReaderHandler::onNull() { return true; }
+
+// class EventReader
+// //////////////////////////////////////////////////////////////////
+
+EventReader::EventReader(ReaderHandler& handler)
+    : handler_(handler), decoder_(Features::all()) {
+  reset();
+}
+
+EventReader::EventReader(ReaderHandler& handler, const Features& features)
+    : handler_(handler), decoder_(features) {
+  reset();
+}
+
+void EventReader::reset() {
+  stack_.clear();
+  pending_.clear();
+  error_.clear();
+  state_ = stateValue;
+  pendingKind_ = pendingNone;
+  pendingIsKey_ = false;
+  escaped_ = false;
+  sawEscape_ = false;
+  sawStar_ = false;
+  piece_ = 0;
+  tokenStart_ = 0;
+  offset_ = 0;
+  tokenOffset_ = 0;
+  line_ = 1;
+  lineStart_ = 0;
+}
+
+bool EventReader::feed(const char* begin, const char* end) {
+  piece_ = begin;
+  const char* current = begin;
+  while (current != end && state_ != stateError)
+    current = scan(current, end);
+
+  // A token cut off by the end of the piece must outlive it.
+  if (tokenStart_ != 0 && state_ != stateError)
+    pending_.assign(tokenStart_, end);
+  tokenStart_ = 0;
+  offset_ += end - begin;
+  return state_ != stateError;
+}
+
+bool EventReader::finish() {
+  if (state_ == stateError)
+    return false;
+
+  switch (pendingKind_) {
+  case pendingNumber:
+  case pendingLiteral: {
+    Pending kind = pendingKind_;
+    pendingKind_ = pendingNone;
+    const char* begin = pending_.data();
+    if (!(kind == pendingNumber ? emitNumber(begin, begin + pending_.size())
+                                : emitLiteral(begin, begin + pending_.size())))
+      return false;
+    break;
+  }
+  case pendingString:
+    return fail("Missing '\"' at the end of the string");
+  case pendingCommentStart:
+  case pendingCStyleComment:
+    return fail("Unterminated comment");
+  default:
+    break;
+  }
+
+  if (state_ != stateDone)
+    return fail(stack_.empty() ? "Syntax error: value, object or array expected."
+                               : "Unexpected end of the document");
+  return true;
+}
+
+std::string EventReader::getFormattedErrorMessages() const { return error_; }
+
+size_t EventReader::offsetOf(const char* location) const {
+  return offset_ + (location - piece_);
+}
+
+// One step: a whitespace character, a structural character or the start or
+// the rest of a token. Returns where to go on from.
+const char* EventReader::scan(const char* current, const char* end) {
+  switch (pendingKind_) {
+  case pendingString:
+    return scanString(current, end);
+  case pendingNumber:
+  case pendingLiteral:
+    return scanWord(current, end);
+  case pendingNone:
+    break;
+  default:
+    return scanComment(current, end);
+  }
+
+  char c = *current;
+  switch (c) {
+  case '\n':
+    ++line_;
+    lineStart_ = offsetOf(current + 1);
+  // Fall through
+  case ' ':
+  case '\t':
+  case '\r':
+    return current + 1;
+  default:
+    break;
+  }
+
+  tokenOffset_ = offsetOf(current);
+  if (c == '/') {
+    if (!decoder_.features_.allowComments_) {
+      fail("Syntax error: value, object or array expected.");
+      return end;
+    }
+    pendingKind_ = pendingCommentStart;
+    return current + 1;
+  }
+
+  switch (state_) {
+  case stateFirstValue:
+    if (c == ']') {
+      endContainer(c);
+      return current + 1;
+    }
+  // Fall through
+  case stateValue:
+    return startValue(c, current, end);
+  case stateFirstKey:
+    if (c == '}') {
+      endContainer(c);
+      return current + 1;
+    }
+  // Fall through
+  case stateKey:
+    if (c != '"') {
+      fail("Missing '}' or object member name");
+      return end;
+    }
+    startToken(pendingString, current);
+    pendingIsKey_ = true;
+    return current + 1;
+  case stateColon:
+    if (c != ':') {
+      fail("Missing ':' after object member name");
+      return end;
+    }
+    state_ = stateValue;
+    return current + 1;
+  case stateNext:
+    if (c == ',') {
+      state_ = stack_.back() == '{' ? stateKey : stateValue;
+      return current + 1;
+    }
+    if (c == (stack_.back() == '{' ? '}' : ']')) {
+      endContainer(c);
+      return current + 1;
+    }
+    fail(stack_.back() == '{' ? "Missing ',' or '}' in object declaration"
+                              : "Missing ',' or ']' in array declaration");
+    return end;
+  case stateDone:
+    fail("Extra data after the end of the document");
+    return end;
+  default:
+    return end;
+  }
+}
+
+const char*
+EventReader::startValue(char c, const char* current, const char* end) {
+  if (stack_.empty() && decoder_.features_.strictRoot_ && c != '{' &&
+      c != '[') {
+    fail("A valid JSON document must be either an array or an object value.");
+    return end;
+  }
+
+  switch (c) {
+  case '{':
+    stack_.push_back('{');
+    state_ = stateFirstKey;
+    handled(handler_.onStartObject());
+    return current + 1;
+  case '[':
+    stack_.push_back('[');
+    state_ = stateFirstValue;
+    handled(handler_.onStartArray());
+    return current + 1;
+  case '"':
+    startToken(pendingString, current);
+    pendingIsKey_ = false;
+    return current + 1;
+  case '-':
+  case '0':
+  case '1':
+  case '2':
+  case '3':
+  case '4':
+  case '5':
+  case '6':
+  case '7':
+  case '8':
+  case '9':
+    startToken(pendingNumber, current);
+    return current;
+  case 't':
+  case 'f':
+  case 'n':
+    startToken(pendingLiteral, current);
+    return current;
+  default:
+    fail("Syntax error: value, object or array expected.");
+    return end;
+  }
+}
+
+void EventReader::startToken(Pending kind, const char* current) {
+  pendingKind_ = kind;
+  tokenStart_ = current;
+  pending_.clear();
+  escaped_ = false;
+  sawEscape_ = false;
+}
+
+const char* EventReader::scanString(const char* current, const char* end) {
+  const char* stop = current;
+  while (stop != end) {
+    if (escaped_) {
+      escaped_ = false;
+      ++stop;
+      continue;
+    }
+    stop = findQuoteOrEscape(stop, end);
+    if (stop == end || *stop == '"')
+      break;
+    escaped_ = sawEscape_ = true;
+    ++stop;
+  }
+
+  if (stop == end) {
+    if (tokenStart_ == 0)
+      pending_.append(current, end);
+    return end;
+  }
+
+  ++stop;
+  pendingKind_ = pendingNone;
+  if (tokenStart_ != 0) {
+    const char* begin = tokenStart_;
+    tokenStart_ = 0;
+    emitString(begin, stop);
+  } else {
+    pending_.append(current, stop);
+    emitString(pending_.data(), pending_.data() + pending_.size());
+  }
+  return stop;
+}
+
+// Numbers and literals end at the first character that cannot be part of
+// them, so one ending a piece has to wait for the next piece or finish().
+const char* EventReader::scanWord(const char* current, const char* end) {
+  const char* stop = current;
+  if (pendingKind_ == pendingNumber) {
+    while (stop != end && ((*stop >= '0' && *stop <= '9') ||
+                           in(*stop, '.', 'e', 'E', '+', '-')))
+      ++stop;
+  } else {
+    while (stop != end && *stop >= 'a' && *stop <= 'z')
+      ++stop;
+  }
+
+  if (stop == end) {
+    if (tokenStart_ == 0)
+      pending_.append(current, end);
+    return end;
+  }
+
+  Pending kind = pendingKind_;
+  const char* begin = tokenStart_;
+  const char* limit = stop;
+  pendingKind_ = pendingNone;
+  tokenStart_ = 0;
+  if (begin == 0) {
+    pending_.append(current, stop);
+    begin = pending_.data();
+    limit = begin + pending_.size();
+  }
+  if (kind == pendingNumber)
+    emitNumber(begin, limit);
+  else
+    emitLiteral(begin, limit);
+  return stop;
+}
+
+const char* EventReader::scanComment(const char* current, const char* end) {
+  for (; current != end; ++current) {
+    char c = *current;
+    if (c == '\n') {
+      ++line_;
+      lineStart_ = offsetOf(current + 1);
+    }
+    if (pendingKind_ == pendingCommentStart) {
+      if (c == '*') {
+        pendingKind_ = pendingCStyleComment;
+        sawStar_ = false;
+      } else if (c == '/') {
+        pendingKind_ = pendingCppStyleComment;
+      } else {
+        fail("Syntax error: value, object or array expected.");
+        return end;
+      }
+    } else if (pendingKind_ == pendingCStyleComment) {
+      if (sawStar_ && c == '/') {
+        pendingKind_ = pendingNone;
+        return current + 1;
+      }
+      sawStar_ = c == '*';
+    } else if (c == '\n') {
+      pendingKind_ = pendingNone;
+      return current + 1;
+    }
+  }
+  return end;
+}
+
+// begin and end take in the quotes. Strings without escapes go to the
+// handler straight from the input.
+bool EventReader::emitString(const char* begin, const char* end) {
+  const char* data = begin + 1;
+  const char* limit = end - 1;
+  if (sawEscape_) {
+    Reader::Token token;
+    token.type_ = Reader::tokenString;
+    token.start_ = begin;
+    token.end_ = end;
+    decoded_.clear();
+    if (!decoder_.decodeString(token, decoded_))
+      return failDecoding();
+    data = decoded_.data();
+    limit = data + decoded_.size();
+  }
+
+  if (pendingIsKey_) {
+    state_ = stateColon;
+    return handled(handler_.onKey(data, limit));
+  }
+  return handled(handler_.onString(data, limit)) && valueDone();
+}
+
+bool EventReader::emitNumber(const char* begin, const char* end) {
+  Reader::Token token;
+  token.type_ = Reader::tokenNumber;
+  token.start_ = begin;
+  token.end_ = end;
+  Value decoded;
+  if (!decoder_.decodeNumber(token, decoded))
+    return failDecoding();
+
+  bool result;
+  switch (decoded.type()) {
+  case intValue:
+    result = handler_.onInt(decoded.asLargestInt());
+    break;
+  case uintValue:
+    result = handler_.onUInt(decoded.asLargestUInt());
+    break;
+  default:
+    result = handler_.onReal(decoded.asDouble());
+    break;
+  }
+  return handled(result) && valueDone();
+}
+
+bool EventReader::emitLiteral(const char* begin, const char* end) {
+  size_t length = size_t(end - begin);
+  bool result;
+  if (length == 4 && memcmp(begin, "true", 4) == 0)
+    result = handler_.onBool(true);
+  else if (length == 5 && memcmp(begin, "false", 5) == 0)
+    result = handler_.onBool(false);
+  else if (length == 4 && memcmp(begin, "null", 4) == 0)
+    result = handler_.onNull();
+  else
+    return fail("Syntax error: value, object or array expected.");
+  return handled(result) && valueDone();
+}
+
+bool EventReader::endContainer(char c) {
+  stack_.pop_back();
+  bool result = c == '}' ? handler_.onEndObject() : handler_.onEndArray();
+  return handled(result) && valueDone();
+}
+
+bool EventReader::valueDone() {
+  state_ = stack_.empty() ? stateDone : stateNext;
+  return true;
+}
+
+bool EventReader::handled(bool result) {
+  if (!result)
+    fail("Parsing stopped by the handler");
+  return result;
+}
+
+bool EventReader::fail(const std::string& message) {
+  if (state_ == stateError)
+    return false;
+
+  char location[64];
+  size_t column = tokenOffset_ >= lineStart_ ? tokenOffset_ - lineStart_ + 1 : 1;
+  snprintf(location, sizeof(location), "Line %lu, Column %lu",
+           (unsigned long)line_, (unsigned long)column);
+  error_ = "* " + std::string(location) + "\n  " + message + "\n";
+  state_ = stateError;
+  pendingKind_ = pendingNone;
+  tokenStart_ = 0;
+  return false;
+}
+
+bool EventReader::failDecoding() {
+  std::string message = decoder_.errors_.empty()
+                            ? std::string("Syntax error")
+                            : decoder_.errors_.back().message_;
+  decoder_.errors_.clear();
+  return fail(message);
+}
+
+// class LazyDocument
+// //////////////////////////////////////////////////////////////////
+
+// Nodes a parse makes room for up front, enough for a typical command.
+static const size_t lazyInitialNodes = 32;
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// End of the JSON number starting at current, or 0 if it is not one.
+static const char* scanJsonNumber(const char* current, const char* end) {
+  if (current != end && *current == '-')
+    ++current;
+  if (current == end)
+    return 0;
+  if (*current == '0')
+    ++current;
+  else if (isDigit(*current))
+    while (current != end && isDigit(*current))
+      ++current;
+  else
+    return 0;
+  if (current != end && *current == '.') {
+    if (++current == end || !isDigit(*current))
+      return 0;
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  if (current != end && (*current == 'e' || *current == 'E')) {
+    ++current;
+    if (current != end && (*current == '+' || *current == '-'))
+      ++current;
+    if (current == end || !isDigit(*current))
+      return 0;
+    while (current != end && isDigit(*current))
+      ++current;
+  }
+  return current;
+}
+
+LazyDocument::LazyDocument() : begin_(0), end_(0) {}
+
+unsigned int LazyDocument::push(Kind kind, const char* start) {
+  Node node;
+  node.start = unsigned(start - begin_);
+  node.end = node.start + 1;
+  node.next = unsigned(nodes_.size()) + 1;
+  node.parent = 0;
+  node.size = 0;
+  node.decoded = 0;
+  node.kind = (unsigned char)kind;
+  nodes_.push_back(node);
+  return unsigned(nodes_.size()) - 1;
+}
+
+void LazyDocument::close(unsigned int node, const char* end) {
+  nodes_[node].end = unsigned(end - begin_);
+  nodes_[node].next = unsigned(nodes_.size());
+}
+
+bool LazyDocument::fail(const char* location, const char* message) {
+  int line = 1;
+  const char* lineStart = begin_;
+  for (const char* current = begin_; current < location; ++current) {
+    if (*current == '\n') {
+      ++line;
+      lineStart = current + 1;
+    }
+  }
+  char where[64];
+  snprintf(where, sizeof(where), "Line %d, Column %d", line,
+           int(location - lineStart) + 1);
+  error_ = "* " + std::string(where) + "\n  " + message + "\n";
+  nodes_.clear();
+  return false;
+}
+
+bool LazyDocument::parse(const char* begin, const char* end) {
+  enum State {
+    stateValue,
+    stateFirstValue,
+    stateFirstKey,
+    stateKey,
+    stateColon,
+    stateNext
+  };
+
+  begin_ = begin;
+  end_ = end;
+  nodes_.clear();
+  decoded_.clear();
+  error_.clear();
+  if (nodes_.capacity() == 0)
+    nodes_.reserve(lazyInitialNodes);
+  if (size_t(end - begin) >= 0xFFFFFFFFu)
+    return fail(begin, "Document too large");
+
+  State state = stateValue;
+  unsigned int open = 0; // innermost unclosed container
+  bool inContainer = false;
+  const char* current = begin;
+
+  for (;;) {
+    current = skipJsonSpaces(current, end);
+    if (current == end)
+      return fail(current, nodes_.empty()
+                               ? "Syntax error: value, object or array expected."
+                               : "Unexpected end of the document");
+    char c = *current;
+
+    if (state == stateColon) {
+      if (c != ':')
+        return fail(current, "Missing ':' after object member name");
+      ++current;
+      state = stateValue;
+      continue;
+    }
+
+    if (state == stateNext) {
+      Node& container = nodes_[open];
+      char closing = container.kind == kindObject ? '}' : ']';
+      if (c == ',') {
+        ++current;
+        state = container.kind == kindObject ? stateKey : stateValue;
+        continue;
+      }
+      if (c != closing)
+        return fail(current, container.kind == kindObject
+                                 ? "Missing ',' or '}' in object declaration"
+                                 : "Missing ',' or ']' in array declaration");
+    }
+
+    if ((c == ']' && (state == stateFirstValue || state == stateNext)) ||
+        (c == '}' && (state == stateFirstKey || state == stateNext))) {
+      ++current;
+      close(open, current);
+      unsigned int parent = nodes_[open].parent;
+      if (open == 0) {
+        inContainer = false;
+        break;
+      }
+      open = parent;
+      state = stateNext;
+      continue;
+    }
+
+    if (state == stateFirstKey || state == stateKey) {
+      if (c != '"')
+        return fail(current, "Missing '}' or object member name");
+    } else if (inContainer && nodes_[open].kind == kindArray) {
+      ++nodes_[open].size;
+    }
+
+    unsigned int node;
+    switch (c) {
+    case '{':
+    case '[':
+      node = push(c == '{' ? kindObject : kindArray, current);
+      nodes_[node].parent = open;
+      open = node;
+      inContainer = true;
+      ++current;
+      state = c == '{' ? stateFirstKey : stateFirstValue;
+      continue;
+    case '"': {
+      node = push(kindString, current);
+      const char* stop = current + 1;
+      for (;;) {
+        stop = findQuoteOrEscape(stop, end);
+        if (stop == end)
+          return fail(current, "Missing '\"' at the end of the string");
+        if (*stop == '"')
+          break;
+        nodes_[node].size = 1;
+        if (++stop != end)
+          ++stop;
+      }
+      current = stop + 1;
+      break;
+    }
+    case 't':
+    case 'f':
+    case 'n': {
+      static const char* const literals[] = {"true", "false", "null"};
+      const char* literal = literals[c == 't' ? 0 : c == 'f' ? 1 : 2];
+      size_t length = strlen(literal);
+      if (size_t(end - current) < length ||
+          memcmp(current, literal, length) != 0)
+        return fail(current, "Syntax error: value, object or array expected.");
+      node = push(c == 't' ? kindTrue : c == 'f' ? kindFalse : kindNull,
+                  current);
+      current += length;
+      break;
+    }
+    default: {
+      const char* stop = scanJsonNumber(current, end);
+      if (stop == 0)
+        return fail(current, "Syntax error: value, object or array expected.");
+      node = push(kindNumber, current);
+      current = stop;
+      break;
+    }
+    }
+    close(node, current);
+
+    if (state == stateFirstKey || state == stateKey) {
+      ++nodes_[open].size;
+      state = stateColon;
+    } else if (!inContainer) {
+      break; // a scalar root
+    } else {
+      state = stateNext;
+    }
+  }
+
+  current = skipJsonSpaces(current, end);
+  if (current != end)
+    return fail(current, "Extra data after the end of the document");
+  return true;
+}
+
+LazyValue LazyDocument::root() const {
+  return nodes_.empty() ? LazyValue() : LazyValue(this, 0);
+}
+
+std::string LazyDocument::getFormattedErrorMessages() const { return error_; }
+
+unsigned int
+LazyDocument::find(unsigned int object, const char* key, size_t length) const {
+  // Like Reader, the last of duplicate members wins.
+  const Node& container = nodes_[object];
+  unsigned int found = 0;
+  unsigned int child = object + 1;
+  for (unsigned int i = 0; i < container.size; ++i) {
+    const Node& name = nodes_[child];
+    unsigned int value = child + 1;
+    if (name.size == 0) {
+      // No escapes: compare with the input as is.
+      if (name.end - name.start - 2 == length &&
+          memcmp(begin_ + name.start + 1, key, length) == 0)
+        found = value;
+    } else {
+      const Value& decoded = decode(child);
+      const char* text = decoded.asCString();
+      if (strlen(text) == length && memcmp(text, key, length) == 0)
+        found = value;
+    }
+    child = nodes_[value].next;
+  }
+  return found;
+}
+
+const Value& LazyDocument::decode(unsigned int node) const {
+  const Node& n = nodes_[node];
+  if (n.decoded != 0)
+    return decoded_[n.decoded - 1];
+
+  Value value;
+  const char* start = begin_ + n.start;
+  const char* stop = begin_ + n.end;
+  switch (n.kind) {
+  case kindFalse:
+  case kindTrue:
+    value = n.kind == kindTrue;
+    break;
+  case kindNumber:
+    decodeNumberToken(start, stop, value);
+    break;
+  case kindString:
+    if (n.size == 0) {
+      Value(start + 1, stop - 1).swap(value);
+    } else {
+      // Escapes are rare enough to pay for a Reader.
+      Reader reader;
+      Reader::Token token;
+      std::string text;
+      token.type_ = Reader::tokenString;
+      token.start_ = start;
+      token.end_ = stop;
+      if (reader.decodeString(token, text))
+        Value(text).swap(value);
+      else
+        Value("").swap(value);
+    }
+    break;
+  default:
+    break;
+  }
+
+  if (decoded_.capacity() == 0)
+    decoded_.reserve(8);
+  decoded_.push_back(Value());
+  decoded_.back().swap(value);
+  const_cast<Node&>(n).decoded = unsigned(decoded_.size());
+  return decoded_.back();
+}
+
+Value LazyDocument::materialize(unsigned int node) const {
+  const Node& n = nodes_[node];
+  if (n.kind == kindArray) {
+    Value array(arrayValue);
+    array.resize(n.size);
+    unsigned int child = node + 1;
+    for (ArrayIndex i = 0; i < n.size; ++i) {
+      array[i] = materialize(child);
+      child = nodes_[child].next;
+    }
+    return array;
+  }
+  if (n.kind == kindObject) {
+    Value object(objectValue);
+    unsigned int child = node + 1;
+    for (ArrayIndex i = 0; i < n.size; ++i) {
+      object[decode(child).asString()] = materialize(child + 1);
+      child = nodes_[child + 1].next;
+    }
+    return object;
+  }
+  return decode(node);
+}
+
+// class LazyValue
+// //////////////////////////////////////////////////////////////////
+
+LazyValue::LazyValue() : document_(0), node_(0) {}
+
+LazyValue::LazyValue(const LazyDocument* document, unsigned int node)
+    : document_(document), node_(node) {}
+
+const Value& LazyValue::scalar() const {
+  static const Value null;
+  if (document_ == 0)
+    return null;
+  unsigned char kind = document_->nodes_[node_].kind;
+  JSON_ASSERT_MESSAGE(kind != LazyDocument::kindArray &&
+                          kind != LazyDocument::kindObject,
+                      "in Json::LazyValue: requires a scalar value");
+  return document_->decode(node_);
+}
+
+ValueType LazyValue::type() const {
+  if (document_ == 0)
+    return nullValue;
+  switch (document_->nodes_[node_].kind) {
+  case LazyDocument::kindArray:
+    return arrayValue;
+  case LazyDocument::kindObject:
+    return objectValue;
+  default:
+    return scalar().type();
+  }
+}
+
+bool LazyValue::isNull() const { return type() == nullValue; }
+
+bool LazyValue::isBool() const { return type() == booleanValue; }
+
+bool LazyValue::isNumeric() const {
+  return document_ != 0 &&
+         document_->nodes_[node_].kind == LazyDocument::kindNumber;
+}
+
+bool LazyValue::isString() const {
+  return document_ != 0 &&
+         document_->nodes_[node_].kind == LazyDocument::kindString;
+}
+
+bool LazyValue::isArray() const {
+  return document_ != 0 &&
+         document_->nodes_[node_].kind == LazyDocument::kindArray;
+}
+
+bool LazyValue::isObject() const {
+  return document_ != 0 &&
+         document_->nodes_[node_].kind == LazyDocument::kindObject;
+}
+
+ArrayIndex LazyValue::size() const {
+  if (!isArray() && !isObject())
+    return 0;
+  return document_->nodes_[node_].size;
+}
+
+bool LazyValue::isMember(const char* key) const {
+  return isObject() && document_->find(node_, key, strlen(key)) != 0;
+}
+
+bool LazyValue::isMember(const std::string& key) const {
+  return isObject() && document_->find(node_, key.data(), key.size()) != 0;
+}
+
+LazyValue LazyValue::operator[](const char* key) const {
+  unsigned int found =
+      isObject() ? document_->find(node_, key, strlen(key)) : 0;
+  return found != 0 ? LazyValue(document_, found) : LazyValue();
+}
+
+LazyValue LazyValue::operator[](const std::string& key) const {
+  unsigned int found =
+      isObject() ? document_->find(node_, key.data(), key.size()) : 0;
+  return found != 0 ? LazyValue(document_, found) : LazyValue();
+}
+
+LazyValue LazyValue::operator[](ArrayIndex index) const {
+  if (!isArray() || index >= size())
+    return LazyValue();
+  unsigned int child = node_ + 1;
+  while (index--)
+    child = document_->nodes_[child].next;
+  return LazyValue(document_, child);
+}
+
+LazyValue LazyValue::operator[](int index) const {
+  JSON_ASSERT_MESSAGE(
+      index >= 0,
+      "in Json::LazyValue::operator[](int index) const: index cannot be negative");
+  return (*this)[ArrayIndex(index)];
+}
+
+Value LazyValue::get(const char* key, const Value& defaultValue) const {
+  LazyValue member = (*this)[key];
+  return member.document_ == 0 ? defaultValue : member.toValue();
+}
+
+Value LazyValue::get(const std::string& key, const Value& defaultValue) const {
+  LazyValue member = (*this)[key];
+  return member.document_ == 0 ? defaultValue : member.toValue();
+}
+
+std::string LazyValue::asString() const { return scalar().asString(); }
+
+Value::Int LazyValue::asInt() const { return scalar().asInt(); }
+
+Value::UInt LazyValue::asUInt() const { return scalar().asUInt(); }
+
+#if defined(JSON_HAS_INT64)
+Value::Int64 LazyValue::asInt64() const { return scalar().asInt64(); }
+
+Value::UInt64 LazyValue::asUInt64() const { return scalar().asUInt64(); }
+#endif
+
+LargestInt LazyValue::asLargestInt() const { return scalar().asLargestInt(); }
+
+LargestUInt LazyValue::asLargestUInt() const {
+  return scalar().asLargestUInt();
+}
+
+float LazyValue::asFloat() const { return scalar().asFloat(); }
+
+double LazyValue::asDouble() const { return scalar().asDouble(); }
+
+bool LazyValue::asBool() const { return scalar().asBool(); }
+
+Value LazyValue::toValue() const {
+  if (document_ == 0)
+    return Value();
+  return document_->materialize(node_);
+}
+
 std::istream& operator>>(std::istream& sin, Value& root) {
   Json::Reader reader;
   bool ok = reader.parse(sin, root, true);
@@ -1256,7 +2442,10 @@ void ValueIteratorBase::decrement() {
 ValueIteratorBase::difference_type
 ValueIteratorBase::computeDistance(const SelfType& other) const {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
-#ifdef JSON_USE_CPPTL_SMALLMAP
+#if defined(JSON_USE_CPPTL_SMALLMAP) || defined(JSON_USE_FLAT_MAP)
+  if (isNull_ && other.isNull_) {
+    return 0;
+  }
   return current_ - other.current_;
 #else
   // Iterator for null value are initialized using the default
@@ -1455,6 +2644,10 @@ ValueIterator& ValueIterator::operator=(const SelfType& other) {
 #include <cpptl/conststring.h>
 #endif
 #include <cstddef> // size_t
+#if defined(__GNUC__) && !defined(_WIN32)
+#define JSON_HAS_VALUE_POOL 1
+#include <pthread.h>
+#endif
 
 #define JSON_ASSERT_UNREACHABLE assert(false)
 
@@ -1511,6 +2704,300 @@ static inline bool InRange(double d, T min, U max) {
 }
 #endif // if !defined(JSON_USE_INT64_DOUBLE_CONVERSION)
 
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// class ValueAllocator
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+// //////////////////////////////////////////////////////////////////
+
+// In front of every block from ValueAllocator::allocateBlock(), keeping
+// the block after it aligned for a double.
+union BlockHeader {
+  struct {
+    ValueAllocator* owner;
+    size_t size;
+  } info;
+  double alignDouble;
+  LargestUInt alignInteger;
+};
+
+#if defined(__GNUC__)
+static __thread ValueAllocator* currentAllocator;
+#else
+static ValueAllocator* currentAllocator;
+#endif
+
+ValueAllocator::~ValueAllocator() {}
+
+namespace {
+
+class SystemValueAllocator : public ValueAllocator {
+public:
+  virtual void* allocate(size_t size) { return malloc(size); }
+  virtual void release(void* memory, size_t) { free(memory); }
+};
+
+} // namespace
+
+ValueAllocator* ValueAllocator::system() {
+  // Never destroyed: static Values may still free blocks during exit.
+  static ValueAllocator* allocator = new SystemValueAllocator;
+  return allocator;
+}
+
+ValueAllocator* ValueAllocator::current() {
+  return currentAllocator ? currentAllocator : system();
+}
+
+void* ValueAllocator::allocateBlock(size_t size) {
+  ValueAllocator* owner = current();
+  BlockHeader* header =
+      static_cast<BlockHeader*>(owner->allocate(sizeof(BlockHeader) + size));
+  if (header == 0)
+    throw std::bad_alloc();
+  header->info.owner = owner;
+  header->info.size = size;
+  return header + 1;
+}
+
+void ValueAllocator::releaseBlock(void* memory) {
+  if (memory == 0)
+    return;
+  BlockHeader* header = static_cast<BlockHeader*>(memory) - 1;
+  header->info.owner->release(header, sizeof(BlockHeader) + header->info.size);
+}
+
+#if defined(JSON_HAS_VALUE_POOL)
+// Size classes step by valuePoolGranule up to valuePoolLargest bytes and
+// are carved from slabs of valuePoolSlab bytes.
+static const size_t valuePoolGranule = 16;
+static const size_t valuePoolLargest = 1024;
+static const size_t valuePoolSlab = 16384;
+
+namespace {
+
+struct PoolBlock {
+  PoolBlock* next;
+  size_t size; // only set while on the remote list
+};
+
+class ValuePool;
+static __thread ValuePool* threadPoolInstance;
+static pthread_key_t threadPoolKey;
+static pthread_once_t threadPoolOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t orphanPoolsLock = PTHREAD_MUTEX_INITIALIZER;
+static ValuePool* orphanPools;
+
+/** Free lists per size class for one thread. A block freed on another
+ * thread is pushed on remote_ with a compare and swap, and the owner takes
+ * the whole list back the next time one of its own lists runs dry.
+ */
+class ValuePool : public ValueAllocator {
+public:
+  ValuePool() : nextOrphan(0), slab_(0), slabEnd_(0), remote_(0) {
+    memset(free_, 0, sizeof(free_));
+  }
+
+  virtual void* allocate(size_t size) {
+    if (size > valuePoolLargest)
+      return malloc(size);
+    size_t sizeClass = classOf(size);
+    if (free_[sizeClass] == 0 &&
+        __atomic_load_n(&remote_, __ATOMIC_RELAXED) != 0)
+      drain();
+    PoolBlock* block = free_[sizeClass];
+    if (block != 0) {
+      free_[sizeClass] = block->next;
+      return block;
+    }
+
+    size_t rounded = (sizeClass + 1) * valuePoolGranule;
+    if (size_t(slabEnd_ - slab_) < rounded) {
+      // The rest of the old slab, under valuePoolLargest bytes, is lost.
+      slab_ = static_cast<char*>(malloc(valuePoolSlab));
+      if (slab_ == 0) {
+        slabEnd_ = 0;
+        return 0;
+      }
+      slabEnd_ = slab_ + valuePoolSlab;
+    }
+    void* memory = slab_;
+    slab_ += rounded;
+    return memory;
+  }
+
+  virtual void release(void* memory, size_t size) {
+    if (size > valuePoolLargest) {
+      free(memory);
+      return;
+    }
+    PoolBlock* block = static_cast<PoolBlock*>(memory);
+    if (this == threadPoolInstance) {
+      size_t sizeClass = classOf(size);
+      block->next = free_[sizeClass];
+      free_[sizeClass] = block;
+      return;
+    }
+    block->size = size;
+    PoolBlock* head = __atomic_load_n(&remote_, __ATOMIC_RELAXED);
+    do
+      block->next = head;
+    while (!__atomic_compare_exchange_n(&remote_, &head, block, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+
+  ValuePool* nextOrphan;
+
+private:
+  static size_t classOf(size_t size) {
+    return (size + valuePoolGranule - 1) / valuePoolGranule - 1;
+  }
+
+  void drain() {
+    PoolBlock* block = __atomic_exchange_n(&remote_, (PoolBlock*)0,
+                                           __ATOMIC_ACQUIRE);
+    while (block != 0) {
+      PoolBlock* next = block->next;
+      size_t sizeClass = classOf(block->size);
+      block->next = free_[sizeClass];
+      free_[sizeClass] = block;
+      block = next;
+    }
+  }
+
+  PoolBlock* free_[valuePoolLargest / valuePoolGranule];
+  char* slab_;
+  char* slabEnd_;
+  PoolBlock* remote_;
+};
+
+} // namespace
+
+// Pools are never freed, since blocks from them may outlive the thread; the
+// pool of an exited thread is handed to the next thread that asks for one.
+static void orphanThreadPool(void* pool) {
+  pthread_mutex_lock(&orphanPoolsLock);
+  static_cast<ValuePool*>(pool)->nextOrphan = orphanPools;
+  orphanPools = static_cast<ValuePool*>(pool);
+  pthread_mutex_unlock(&orphanPoolsLock);
+}
+
+static void createThreadPoolKey() {
+  pthread_key_create(&threadPoolKey, orphanThreadPool);
+}
+
+ValueAllocator* ValueAllocator::threadPool() {
+  if (threadPoolInstance != 0)
+    return threadPoolInstance;
+
+  ValuePool* pool;
+  pthread_mutex_lock(&orphanPoolsLock);
+  pool = orphanPools;
+  if (pool != 0)
+    orphanPools = pool->nextOrphan;
+  pthread_mutex_unlock(&orphanPoolsLock);
+  if (pool == 0)
+    pool = new ValuePool;
+
+  pthread_once(&threadPoolOnce, createThreadPoolKey);
+  pthread_setspecific(threadPoolKey, pool);
+  threadPoolInstance = pool;
+  return pool;
+}
+#else
+ValueAllocator* ValueAllocator::threadPool() { return system(); }
+#endif // if defined(JSON_HAS_VALUE_POOL)
+
+ValueAllocatorScope::ValueAllocatorScope(ValueAllocator* allocator)
+    : previous_(currentAllocator) {
+  currentAllocator = allocator;
+}
+
+ValueAllocatorScope::~ValueAllocatorScope() { currentAllocator = previous_; }
+
+// class ValueArena
+// //////////////////////////////////////////////////////////////////
+
+// Arena allocations keep the alignment a BlockHeader needs.
+static inline size_t arenaRound(size_t size) {
+  return (size + sizeof(BlockHeader) - 1) / sizeof(BlockHeader) *
+         sizeof(BlockHeader);
+}
+
+ValueArena::ValueArena(size_t blockSize)
+    : blocks_(0), current_(0), end_(0), blockSize_(arenaRound(blockSize)),
+      used_(0) {}
+
+ValueArena::~ValueArena() {
+  while (blocks_ != 0) {
+    Block* next = blocks_->next;
+    free(blocks_);
+    blocks_ = next;
+  }
+}
+
+void* ValueArena::allocate(size_t size) {
+  size = arenaRound(size);
+  if (size_t(end_ - current_) < size) {
+    // Large requests get a block of their own and leave the current one be.
+    bool large = size > blockSize_ / 4;
+    size_t capacity = large ? size : blockSize_;
+    Block* block = static_cast<Block*>(
+        malloc(arenaRound(sizeof(Block)) + capacity));
+    if (block == 0)
+      return 0;
+    block->size = capacity;
+    char* data = reinterpret_cast<char*>(block) + arenaRound(sizeof(Block));
+    if (large && blocks_ != 0) {
+      block->next = blocks_->next;
+      blocks_->next = block;
+      used_ += size;
+      return data;
+    }
+    block->next = blocks_;
+    blocks_ = block;
+    current_ = data;
+    end_ = data + capacity;
+  }
+  void* memory = current_;
+  current_ += size;
+  used_ += size;
+  return memory;
+}
+
+void ValueArena::release(void*, size_t) {}
+
+Value* ValueArena::newValue() {
+  void* memory = allocate(sizeof(Value));
+  if (memory == 0)
+    throw std::bad_alloc();
+  return new (memory) Value();
+}
+
+void ValueArena::reset() {
+  Block* kept = 0;
+  while (blocks_ != 0) {
+    Block* next = blocks_->next;
+    if (kept == 0 && blocks_->size == blockSize_)
+      kept = blocks_;
+    else
+      free(blocks_);
+    blocks_ = next;
+  }
+  blocks_ = kept;
+  current_ = end_ = 0;
+  if (kept != 0) {
+    kept->next = 0;
+    current_ = reinterpret_cast<char*>(kept) + arenaRound(sizeof(Block));
+    end_ = current_ + kept->size;
+  }
+  used_ = 0;
+}
+
+size_t ValueArena::used() const { return used_; }
+
 /** Duplicates the specified string value.
  * @param value Pointer to the string to duplicate. Must be zero-terminated if
  *              length is "unknown".
@@ -1523,23 +3010,86 @@ static inline char* duplicateStringValue(const char* value,
   if (length == unknown)
     length = (unsigned int)strlen(value);
 
-  // Avoid an integer overflow in the call to malloc below by limiting length
+  // Avoid an integer overflow in the allocation below by limiting length
   // to a sane value.
   if (length >= (unsigned)Value::maxInt)
     length = Value::maxInt - 1;
 
-  char* newString = static_cast<char*>(malloc(length + 1));
-  JSON_ASSERT_MESSAGE(newString != 0,
-                      "in Json::Value::duplicateStringValue(): "
-                      "Failed to allocate string value buffer");
+  char* newString =
+      static_cast<char*>(ValueAllocator::allocateBlock(length + 1));
   memcpy(newString, value, length);
   newString[length] = 0;
   return newString;
 }
 
-/** Free the string duplicated by duplicateStringValue().
+/** Free the string duplicated by duplicateStringValue().
+ */
+static inline void releaseStringValue(char* value) {
+  ValueAllocator::releaseBlock(value);
+}
+
+#if !defined(JSON_VALUE_USE_INTERNAL_MAP) && defined(__GNUC__)
+#define JSON_USE_KEY_INTERNING 1
+
+#ifndef JSON_INTERN_MAX_KEYS
+#define JSON_INTERN_MAX_KEYS 512
+#endif
+#ifndef JSON_INTERN_MAX_LENGTH
+#define JSON_INTERN_MAX_LENGTH 32
+#endif
+#define JSON_INTERN_SLOTS (JSON_INTERN_MAX_KEYS * 2)
+
+struct InternedKey {
+  unsigned int hash;
+  unsigned int length;
+  char name[1];
+};
+
+static InternedKey* internTable[JSON_INTERN_SLOTS];
+static unsigned int internCount;
+
+/** Returns the process wide copy of a member name, adding it if needed.
+ *
+ * Entries are never freed, so once JSON_INTERN_MAX_KEYS names are in, or
+ * for names longer than JSON_INTERN_MAX_LENGTH, this returns 0 and the
+ * caller duplicates as usual. Lookups are plain loads and insertions a
+ * compare and swap into an empty slot, so any thread may call it.
  */
-static inline void releaseStringValue(char* value) { free(value); }
+static const char* internKey(const char* key, unsigned int hash) {
+  unsigned int length = (unsigned int)strlen(key);
+  if (length > JSON_INTERN_MAX_LENGTH)
+    return 0;
+
+  unsigned int slot = hash & (JSON_INTERN_SLOTS - 1);
+  for (unsigned int probe = 0; probe < JSON_INTERN_SLOTS;
+       ++probe, slot = (slot + 1) & (JSON_INTERN_SLOTS - 1)) {
+    InternedKey* entry = __atomic_load_n(&internTable[slot], __ATOMIC_ACQUIRE);
+    if (entry == 0) {
+      if (__atomic_load_n(&internCount, __ATOMIC_RELAXED) >=
+          JSON_INTERN_MAX_KEYS)
+        return 0;
+      InternedKey* fresh = static_cast<InternedKey*>(
+          malloc(sizeof(InternedKey) + length));
+      if (fresh == 0)
+        return 0;
+      fresh->hash = hash;
+      fresh->length = length;
+      memcpy(fresh->name, key, length + 1);
+      if (__atomic_compare_exchange_n(&internTable[slot], &entry, fresh, false,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_fetch_add(&internCount, 1, __ATOMIC_RELAXED);
+        return fresh->name;
+      }
+      // Lost the slot to another thread; entry is now its key.
+      free(fresh);
+    }
+    if (entry->hash == hash && entry->length == length &&
+        memcmp(entry->name, key, length) == 0)
+      return entry->name;
+  }
+  return 0;
+}
+#endif // if !defined(JSON_VALUE_USE_INTERNAL_MAP) && defined(__GNUC__)
 
 } // namespace Json
 
@@ -1594,33 +3144,81 @@ void Value::CommentInfo::setComment(const char* text) {
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
 // //////////////////////////////////////////////////////////////////
+
+// FNV-1a for member names and path strings, a multiplicative hash for
+// array indexes.
+static inline unsigned int hashKey(const char* cstr, size_t length) {
+  unsigned int h = 2166136261U;
+  for (const char* c = cstr; c != cstr + length; ++c)
+    h = (h ^ (unsigned char)*c) * 16777619U;
+  return h;
+}
+
+static inline unsigned int hashKey(const char* cstr) {
+  unsigned int h = 2166136261U;
+  for (const char* c = cstr; *c; ++c)
+    h = (h ^ (unsigned char)*c) * 16777619U;
+  return h;
+}
+
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
 
 // Notes: index_ indicates if the string was allocated when
 // a string is stored.
 
-Value::CZString::CZString(ArrayIndex index) : cstr_(0), index_(index) {}
+Value::CZString::CZString(ArrayIndex index)
+    : cstr_(0), index_(index), hash_(index * 2654435761U) {}
 
 Value::CZString::CZString(const char* cstr, DuplicationPolicy allocate)
-    : cstr_(allocate == duplicate ? duplicateStringValue(cstr) : cstr),
-      index_(allocate) {}
+    : cstr_(cstr), index_(allocate), hash_(hashKey(cstr)) {
+  if (allocate == duplicate)
+    own();
+}
+
+Value::CZString::CZString(const char* cstr,
+                          unsigned int hash,
+                          DuplicationPolicy allocate)
+    : cstr_(cstr), index_(allocate), hash_(hash) {
+  JSON_ASSERT(allocate == noDuplication || allocate == interned);
+}
 
 Value::CZString::CZString(const CZString& other)
-    : cstr_(other.index_ != noDuplication && other.cstr_ != 0
-                ? duplicateStringValue(other.cstr_)
-                : other.cstr_),
-      index_(other.cstr_
-                 ? (other.index_ == noDuplication ? noDuplication : duplicate)
-                 : other.index_) {}
+    : cstr_(other.cstr_), index_(other.index_), hash_(other.hash_) {
+  if (cstr_ && (index_ == duplicate || index_ == duplicateOnCopy))
+    own();
+}
+
+#if JSON_HAS_RVALUE_REFERENCES
+Value::CZString::CZString(CZString&& other) JSONCPP_NOEXCEPT
+    : cstr_(other.cstr_), index_(other.index_), hash_(other.hash_) {
+  other.cstr_ = 0;
+}
+#endif
 
 Value::CZString::~CZString() {
   if (cstr_ && index_ == duplicate)
     releaseStringValue(const_cast<char*>(cstr_));
 }
 
+// Points cstr_ at a copy the key owns or shares: the interned one when
+// there is room, a private duplicate otherwise.
+void Value::CZString::own() {
+#if defined(JSON_USE_KEY_INTERNING)
+  const char* shared = internKey(cstr_, hash_);
+  if (shared) {
+    cstr_ = shared;
+    index_ = interned;
+    return;
+  }
+#endif
+  cstr_ = duplicateStringValue(cstr_);
+  index_ = duplicate;
+}
+
 void Value::CZString::swap(CZString& other) {
   std::swap(cstr_, other.cstr_);
   std::swap(index_, other.index_);
+  std::swap(hash_, other.hash_);
 }
 
 Value::CZString& Value::CZString::operator=(CZString other) {
@@ -1630,13 +3228,19 @@ Value::CZString& Value::CZString::operator=(CZString other) {
 
 bool Value::CZString::operator<(const CZString& other) const {
   if (cstr_)
-    return strcmp(cstr_, other.cstr_) < 0;
+    return cstr_ != other.cstr_ && strcmp(cstr_, other.cstr_) < 0;
   return index_ < other.index_;
 }
 
 bool Value::CZString::operator==(const CZString& other) const {
-  if (cstr_)
+  if (cstr_) {
+    if (cstr_ == other.cstr_)
+      return true;
+    // Equal interned names share one buffer.
+    if (hash_ != other.hash_ || (index_ == interned && other.index_ == interned))
+      return false;
     return strcmp(cstr_, other.cstr_) == 0;
+  }
   return index_ == other.index_;
 }
 
@@ -1644,7 +3248,11 @@ ArrayIndex Value::CZString::index() const { return index_; }
 
 const char* Value::CZString::c_str() const { return cstr_; }
 
-bool Value::CZString::isStaticString() const { return index_ == noDuplication; }
+bool Value::CZString::isStaticString() const {
+  return index_ == noDuplication || index_ == interned;
+}
+
+unsigned int Value::CZString::hash() const { return hash_; }
 
 #endif // ifndef JSON_VALUE_USE_INTERNAL_MAP
 
@@ -1661,7 +3269,7 @@ bool Value::CZString::isStaticString() const { return index_ == noDuplication; }
  * This optimization is used in ValueInternalMap fast allocator.
  */
 Value::Value(ValueType type)
-    : type_(type), allocated_(false)
+    : type_(type), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1684,7 +3292,8 @@ Value::Value(ValueType type)
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues();
+    value_.map_ = new (ValueAllocator::allocateBlock(sizeof(ObjectValues)))
+        ObjectValues();
     break;
 #else
   case arrayValue:
@@ -1703,7 +3312,7 @@ Value::Value(ValueType type)
 }
 
 Value::Value(UInt value)
-    : type_(uintValue), allocated_(false)
+    : type_(uintValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1714,7 +3323,7 @@ Value::Value(UInt value)
 }
 
 Value::Value(Int value)
-    : type_(intValue), allocated_(false)
+    : type_(intValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1726,7 +3335,7 @@ Value::Value(Int value)
 
 #if defined(JSON_HAS_INT64)
 Value::Value(Int64 value)
-    : type_(intValue), allocated_(false)
+    : type_(intValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1737,7 +3346,7 @@ Value::Value(Int64 value)
 }
 
 Value::Value(UInt64 value)
-    : type_(uintValue), allocated_(false)
+    : type_(uintValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1749,7 +3358,7 @@ Value::Value(UInt64 value)
 #endif // defined(JSON_HAS_INT64)
 
 Value::Value(double value)
-    : type_(realValue), allocated_(false)
+    : type_(realValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1760,42 +3369,40 @@ Value::Value(double value)
 }
 
 Value::Value(const char* value)
-    : type_(stringValue), allocated_(true)
+    : type_(stringValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
 #endif
       ,
       comments_(0), start_(0), limit_(0) {
-  value_.string_ = duplicateStringValue(value);
+  setString(value, (unsigned int)strlen(value));
 }
 
 Value::Value(const char* beginValue, const char* endValue)
-    : type_(stringValue), allocated_(true)
+    : type_(stringValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
 #endif
       ,
       comments_(0), start_(0), limit_(0) {
-  value_.string_ =
-      duplicateStringValue(beginValue, (unsigned int)(endValue - beginValue));
+  setString(beginValue, (unsigned int)(endValue - beginValue));
 }
 
 Value::Value(const std::string& value)
-    : type_(stringValue), allocated_(true)
+    : type_(stringValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
 #endif
       ,
       comments_(0), start_(0), limit_(0) {
-  value_.string_ =
-      duplicateStringValue(value.c_str(), (unsigned int)value.length());
+  setString(value.c_str(), (unsigned int)value.length());
 }
 
 Value::Value(const StaticString& value)
-    : type_(stringValue), allocated_(false)
+    : type_(stringValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1807,19 +3414,19 @@ Value::Value(const StaticString& value)
 
 #ifdef JSON_USE_CPPTL
 Value::Value(const CppTL::ConstString& value)
-    : type_(stringValue), allocated_(true)
+    : type_(stringValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
 #endif
       ,
       comments_(0), start_(0), limit_(0) {
-  value_.string_ = duplicateStringValue(value, value.length());
+  setString(value, value.length());
 }
 #endif
 
 Value::Value(bool value)
-    : type_(booleanValue), allocated_(false)
+    : type_(booleanValue), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1830,7 +3437,7 @@ Value::Value(bool value)
 }
 
 Value::Value(const Value& other)
-    : type_(other.type_), allocated_(false)
+    : type_(other.type_), allocated_(false), inlineString_(false)
 #ifdef JSON_VALUE_USE_INTERNAL_MAP
       ,
       itemIsUsed_(0)
@@ -1846,9 +3453,9 @@ Value::Value(const Value& other)
     value_ = other.value_;
     break;
   case stringValue:
-    if (other.value_.string_) {
-      value_.string_ = duplicateStringValue(other.value_.string_);
-      allocated_ = true;
+    if (other.stringData()) {
+      const char* data = other.stringData();
+      setString(data, (unsigned int)strlen(data));
     } else {
       value_.string_ = 0;
       allocated_ = false;
@@ -1857,7 +3464,19 @@ Value::Value(const Value& other)
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    value_.map_ = new ObjectValues(*other.value_.map_);
+    {
+      void* memory = ValueAllocator::allocateBlock(sizeof(ObjectValues));
+#if JSON_USE_EXCEPTION
+      try {
+        value_.map_ = new (memory) ObjectValues(*other.value_.map_);
+      } catch (...) {
+        ValueAllocator::releaseBlock(memory);
+        throw;
+      }
+#else
+      value_.map_ = new (memory) ObjectValues(*other.value_.map_);
+#endif
+    }
     break;
 #else
   case arrayValue:
@@ -1880,6 +3499,21 @@ Value::Value(const Value& other)
   }
 }
 
+#if JSON_HAS_RVALUE_REFERENCES
+Value::Value(Value&& other) JSONCPP_NOEXCEPT
+    : type_(nullValue), allocated_(false), inlineString_(false)
+#ifdef JSON_VALUE_USE_INTERNAL_MAP
+      ,
+      itemIsUsed_(0)
+#endif
+      ,
+      comments_(0), start_(0), limit_(0) {
+  value_.map_ = 0;
+  swap(other);
+  std::swap(comments_, other.comments_);
+}
+#endif
+
 Value::~Value() {
   switch (type_) {
   case nullValue:
@@ -1895,7 +3529,8 @@ Value::~Value() {
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
-    delete value_.map_;
+    value_.map_->~ObjectValues();
+    ValueAllocator::releaseBlock(value_.map_);
     break;
 #else
   case arrayValue:
@@ -1913,8 +3548,24 @@ Value::~Value() {
     delete[] comments_;
 }
 
+// Strings that fit in the value holder are kept there, so short string
+// values cost no allocation.
+void Value::setString(const char* value, unsigned int length) {
+  if (length < sizeof(value_.chars_)) {
+    memcpy(value_.chars_, value, length);
+    value_.chars_[length] = 0;
+    inlineString_ = true;
+    allocated_ = false;
+  } else {
+    value_.string_ = duplicateStringValue(value, length);
+    inlineString_ = false;
+    allocated_ = true;
+  }
+}
+
 Value& Value::operator=(Value other) {
   swap(other);
+  std::swap(comments_, other.comments_);
   return *this;
 }
 
@@ -1926,6 +3577,9 @@ void Value::swap(Value& other) {
   int temp2 = allocated_;
   allocated_ = other.allocated_;
   other.allocated_ = temp2;
+  unsigned int temp3 = inlineString_;
+  inlineString_ = other.inlineString_;
+  other.inlineString_ = temp3;
   std::swap(start_, other.start_);
   std::swap(limit_, other.limit_);
 }
@@ -1956,9 +3610,9 @@ bool Value::operator<(const Value& other) const {
   case booleanValue:
     return value_.bool_ < other.value_.bool_;
   case stringValue:
-    return (value_.string_ == 0 && other.value_.string_) ||
-           (other.value_.string_ && value_.string_ &&
-            strcmp(value_.string_, other.value_.string_) < 0);
+    return (stringData() == 0 && other.stringData()) ||
+           (other.stringData() && stringData() &&
+            strcmp(stringData(), other.stringData()) < 0);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue: {
@@ -2005,9 +3659,9 @@ bool Value::operator==(const Value& other) const {
   case booleanValue:
     return value_.bool_ == other.value_.bool_;
   case stringValue:
-    return (value_.string_ == other.value_.string_) ||
-           (other.value_.string_ && value_.string_ &&
-            strcmp(value_.string_, other.value_.string_) == 0);
+    return (stringData() == other.stringData()) ||
+           (other.stringData() && stringData() &&
+            strcmp(stringData(), other.stringData()) == 0);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   case arrayValue:
   case objectValue:
@@ -2030,7 +3684,7 @@ bool Value::operator!=(const Value& other) const { return !(*this == other); }
 const char* Value::asCString() const {
   JSON_ASSERT_MESSAGE(type_ == stringValue,
                       "in Json::Value::asCString(): requires stringValue");
-  return value_.string_;
+  return stringData();
 }
 
 std::string Value::asString() const {
@@ -2038,7 +3692,7 @@ std::string Value::asString() const {
   case nullValue:
     return "";
   case stringValue:
-    return value_.string_ ? value_.string_ : "";
+    return stringData() ? stringData() : "";
   case booleanValue:
     return value_.bool_ ? "true" : "false";
   case intValue:
@@ -2327,7 +3981,7 @@ void Value::resize(ArrayIndex newSize) {
   JSON_ASSERT_MESSAGE(type_ == nullValue || type_ == arrayValue,
                       "in Json::Value::resize(): requires arrayValue");
   if (type_ == nullValue)
-    *this = Value(arrayValue);
+    Value(arrayValue).swap(*this);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   ArrayIndex oldSize = size();
   if (newSize == 0)
@@ -2350,15 +4004,19 @@ Value& Value::operator[](ArrayIndex index) {
       type_ == nullValue || type_ == arrayValue,
       "in Json::Value::operator[](ArrayIndex): requires arrayValue");
   if (type_ == nullValue)
-    *this = Value(arrayValue);
+    Value(arrayValue).swap(*this);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   CZString key(index);
   ObjectValues::iterator it = value_.map_->lower_bound(key);
   if (it != value_.map_->end() && (*it).first == key)
     return (*it).second;
 
+#if JSON_HAS_RVALUE_REFERENCES
+  it = value_.map_->emplace_hint(it, key, Value());
+#else
   ObjectValues::value_type defaultValue(key, null);
   it = value_.map_->insert(it, defaultValue);
+#endif
   return (*it).second;
 #else
   return value_.array_->resolveReference(index);
@@ -2406,7 +4064,7 @@ Value& Value::resolveReference(const char* key, bool isStatic) {
       type_ == nullValue || type_ == objectValue,
       "in Json::Value::resolveReference(): requires objectValue");
   if (type_ == nullValue)
-    *this = Value(objectValue);
+    Value(objectValue).swap(*this);
 #ifndef JSON_VALUE_USE_INTERNAL_MAP
   CZString actualKey(
       key, isStatic ? CZString::noDuplication : CZString::duplicateOnCopy);
@@ -2414,8 +4072,13 @@ Value& Value::resolveReference(const char* key, bool isStatic) {
   if (it != value_.map_->end() && (*it).first == actualKey)
     return (*it).second;
 
+#if JSON_HAS_RVALUE_REFERENCES
+  // One duplication of the key, straight into the new node.
+  it = value_.map_->emplace_hint(it, actualKey, Value());
+#else
   ObjectValues::value_type defaultValue(actualKey, null);
   it = value_.map_->insert(it, defaultValue);
+#endif
   Value& value = (*it).second;
   return value;
 #else
@@ -2448,6 +4111,24 @@ const Value& Value::operator[](const char* key) const {
 #endif
 }
 
+const Value*
+Value::findMember(const char* key, unsigned int hash, bool interned) const {
+  if (type_ != objectValue)
+    return 0;
+#ifndef JSON_VALUE_USE_INTERNAL_MAP
+  CZString actualKey(
+      key, hash, interned ? CZString::interned : CZString::noDuplication);
+  ObjectValues::const_iterator it = value_.map_->find(actualKey);
+  if (it == value_.map_->end())
+    return 0;
+  return &(*it).second;
+#else
+  (void)hash;
+  (void)interned;
+  return value_.map_->find(key);
+#endif
+}
+
 Value& Value::operator[](const std::string& key) {
   return (*this)[key.c_str()];
 }
@@ -2472,6 +4153,12 @@ const Value& Value::operator[](const CppTL::ConstString& key) const {
 
 Value& Value::append(const Value& value) { return (*this)[size()] = value; }
 
+#if JSON_HAS_RVALUE_REFERENCES
+Value& Value::append(Value&& value) {
+  return (*this)[size()] = std::move(value);
+}
+#endif
+
 Value Value::get(const char* key, const Value& defaultValue) const {
   const Value* value = &((*this)[key]);
   return value == &null ? defaultValue : *value;
@@ -2491,7 +4178,11 @@ Value Value::removeMember(const char* key) {
   ObjectValues::iterator it = value_.map_->find(actualKey);
   if (it == value_.map_->end())
     return null;
+#if JSON_HAS_RVALUE_REFERENCES
+  Value old(std::move(it->second));
+#else
   Value old(it->second);
+#endif
   value_.map_->erase(it);
   return old;
 #else
@@ -2834,16 +4525,29 @@ Value::iterator Value::end() {
 // class PathArgument
 // //////////////////////////////////////////////////////////////////
 
-PathArgument::PathArgument() : key_(), index_(), kind_(kindNone) {}
+PathArgument::PathArgument()
+    : key_(), index_(), kind_(kindNone), name_(0), hash_(0) {}
 
 PathArgument::PathArgument(ArrayIndex index)
-    : key_(), index_(index), kind_(kindIndex) {}
+    : key_(), index_(index), kind_(kindIndex), name_(0), hash_(0) {}
 
 PathArgument::PathArgument(const char* key)
-    : key_(key), index_(), kind_(kindKey) {}
+    : key_(key), index_(), kind_(kindKey), name_(0), hash_(0) {
+  compileKey();
+}
 
 PathArgument::PathArgument(const std::string& key)
-    : key_(key.c_str()), index_(), kind_(kindKey) {}
+    : key_(key.c_str()), index_(), kind_(kindKey), name_(0), hash_(0) {
+  compileKey();
+}
+
+void PathArgument::compileKey() {
+  hash_ = hashKey(key_.c_str());
+#if defined(JSON_USE_KEY_INTERNING)
+  // Interned member names then match by pointer.
+  name_ = internKey(key_.c_str(), hash_);
+#endif
+}
 
 // class Path
 // //////////////////////////////////////////////////////////////////
@@ -2870,9 +4574,10 @@ void Path::makePath(const std::string& path, const InArgs& in) {
   while (current != end) {
     if (*current == '[') {
       ++current;
-      if (*current == '%')
+      if (current != end && *current == '%') {
         addPathInArg(path, in, itInArg, PathArgument::kindIndex);
-      else {
+        ++current;
+      } else {
         ArrayIndex index = 0;
         for (; current != end && *current >= '0' && *current <= '9'; ++current)
           index = index * 10 + ArrayIndex(*current - '0');
@@ -2898,59 +4603,49 @@ void Path::addPathInArg(const std::string& /*path*/,
                         const InArgs& in,
                         InArgs::const_iterator& itInArg,
                         PathArgument::Kind kind) {
-  if (itInArg == in.end()) {
-    // Error: missing argument %d
-  } else if ((*itInArg)->kind_ != kind) {
-    // Error: bad argument type
+  if (itInArg == in.end() || (*itInArg)->kind_ != kind) {
+    // Error: missing argument or bad argument type. The path finds nothing.
+    args_.push_back(PathArgument());
   } else {
     args_.push_back(**itInArg);
   }
+  if (itInArg != in.end())
+    ++itInArg;
 }
 
 void Path::invalidPath(const std::string& /*path*/, int /*location*/) {
-  // Error: invalid path.
+  // Error: invalid path. It finds nothing.
+  args_.push_back(PathArgument());
 }
 
-const Value& Path::resolve(const Value& root) const {
+const Value* Path::find(const Value& root) const {
   const Value* node = &root;
   for (Args::const_iterator it = args_.begin(); it != args_.end(); ++it) {
     const PathArgument& arg = *it;
     if (arg.kind_ == PathArgument::kindIndex) {
-      if (!node->isArray() || !node->isValidIndex(arg.index_)) {
-        // Error: unable to resolve path (array value expected at position...
-      }
+      if (!node->isArray() || !node->isValidIndex(arg.index_))
+        return 0;
       node = &((*node)[arg.index_]);
     } else if (arg.kind_ == PathArgument::kindKey) {
-      if (!node->isObject()) {
-        // Error: unable to resolve path (object value expected at position...)
-      }
-      node = &((*node)[arg.key_]);
-      if (node == &Value::null) {
-        // Error: unable to resolve path (object has no member named '' at
-        // position...)
-      }
+      node = node->findMember(arg.name_ ? arg.name_ : arg.key_.c_str(),
+                              arg.hash_, arg.name_ != 0);
+      if (node == 0)
+        return 0;
+    } else {
+      return 0; // left by a bad argument or an invalid path
     }
   }
-  return *node;
+  return node;
+}
+
+const Value& Path::resolve(const Value& root) const {
+  const Value* node = find(root);
+  return node ? *node : Value::null;
 }
 
 Value Path::resolve(const Value& root, const Value& defaultValue) const {
-  const Value* node = &root;
-  for (Args::const_iterator it = args_.begin(); it != args_.end(); ++it) {
-    const PathArgument& arg = *it;
-    if (arg.kind_ == PathArgument::kindIndex) {
-      if (!node->isArray() || !node->isValidIndex(arg.index_))
-        return defaultValue;
-      node = &((*node)[arg.index_]);
-    } else if (arg.kind_ == PathArgument::kindKey) {
-      if (!node->isObject())
-        return defaultValue;
-      node = &((*node)[arg.key_]);
-      if (node == &Value::null)
-        return defaultValue;
-    }
-  }
-  return *node;
+  const Value* node = find(root);
+  return node ? *node : defaultValue;
 }
 
 Value& Path::make(Value& root) const {
@@ -2972,6 +4667,33 @@ Value& Path::make(Value& root) const {
   return *node;
 }
 
+// class PathCache
+// //////////////////////////////////////////////////////////////////
+
+PathCache::Entry::Entry() : text(), path(std::string()) {}
+
+PathCache::PathCache(unsigned int slots) : entries_(slots ? slots : 1) {}
+
+const Path& PathCache::get(const char* path) {
+  return get(path, strlen(path));
+}
+
+const Path& PathCache::get(const std::string& path) {
+  return get(path.data(), path.size());
+}
+
+const Path& PathCache::get(const char* path, size_t length) {
+  // An empty slot holds "", which compiles to the root path, so it needs
+  // no flag of its own.
+  Entry& entry = entries_[hashKey(path, length) % entries_.size()];
+  if (entry.text.size() != length ||
+      memcmp(entry.text.data(), path, length) != 0) {
+    entry.text.assign(path, length);
+    entry.path = Path(entry.text);
+  }
+  return entry.path;
+}
+
 } // namespace Json
 
 // //////////////////////////////////////////////////////////////////////
@@ -3029,9 +4751,9 @@ std::string valueToString(LargestInt value) {
   UIntToStringBuffer buffer;
   char* current = buffer + sizeof(buffer);
   bool isNegative = value < 0;
-  if (isNegative)
-    value = -value;
-  uintToString(LargestUInt(value), current);
+  uintToString(isNegative ? LargestUInt(0) - LargestUInt(value)
+                          : LargestUInt(value),
+               current);
   if (isNegative)
     *--current = '-';
   assert(current >= buffer);
@@ -3058,12 +4780,294 @@ std::string valueToString(UInt value) {
 
 #endif // # if defined(JSON_HAS_INT64)
 
+#if defined(JSON_HAS_INT64)
+
+// Shortest round-trip formatting of doubles, after Florian Loitsch's
+// Grisu2 ("Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", PLDI 2010). The digits always read back as the same double;
+// in rare cases one more digit than strictly necessary is produced.
+namespace {
+
+struct DiyFp {
+  DiyFp(UInt64 f, int e) : f_(f), e_(e) {}
+
+  explicit DiyFp(double d) {
+    UInt64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    int biased = int((bits >> 52) & 0x7FF);
+    UInt64 significand = bits & 0x000FFFFFFFFFFFFFULL;
+    if (biased != 0) {
+      f_ = significand + 0x0010000000000000ULL;
+      e_ = biased - 1075;
+    } else {
+      f_ = significand;
+      e_ = -1074;
+    }
+  }
+
+  DiyFp operator-(const DiyFp& rhs) const { return DiyFp(f_ - rhs.f_, e_); }
+
+  // Upper 64 bits of the 128 bit product, rounded.
+  DiyFp operator*(const DiyFp& rhs) const {
+    const UInt64 m32 = 0xFFFFFFFFULL;
+    UInt64 a = f_ >> 32, b = f_ & m32, c = rhs.f_ >> 32, d = rhs.f_ & m32;
+    UInt64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    UInt64 tmp = (bd >> 32) + (ad & m32) + (bc & m32) + (1ULL << 31);
+    return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e_ + rhs.e_ + 64);
+  }
+
+  DiyFp normalize() const {
+    DiyFp res = *this;
+    while (!(res.f_ & (1ULL << 63))) {
+      res.f_ <<= 1;
+      res.e_--;
+    }
+    return res;
+  }
+
+  // The neighbours halfway to the next and previous doubles, with the
+  // exponent of the upper one.
+  void normalizedBoundaries(DiyFp* minus, DiyFp* plus) const {
+    DiyFp pl = DiyFp((f_ << 1) + 1, e_ - 1);
+    while (!(pl.f_ & (0x0010000000000000ULL << 1))) {
+      pl.f_ <<= 1;
+      pl.e_--;
+    }
+    pl.f_ <<= 10;
+    pl.e_ -= 10;
+    DiyFp mi = (f_ == 0x0010000000000000ULL) ? DiyFp((f_ << 2) - 1, e_ - 2)
+                                              : DiyFp((f_ << 1) - 1, e_ - 1);
+    mi.f_ <<= mi.e_ - pl.e_;
+    mi.e_ = pl.e_;
+    *plus = pl;
+    *minus = mi;
+  }
+
+  UInt64 f_;
+  int e_;
+};
+
+// 10^k, k = -348 + 8 * i, normalized to 64 bit significands.
+static const UInt64 cachedPowersF[] = {
+      0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+      0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+      0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+      0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+      0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+      0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+      0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+      0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+      0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+      0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+      0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+      0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+      0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+      0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+      0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+      0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+      0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+      0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+      0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+      0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+      0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+      0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+      0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+      0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+      0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+      0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+      0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+      0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+      0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+
+static const short cachedPowersE[] = {
+      -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+      -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+      -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+      -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+      -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+      109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+      375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+      641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+      907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const unsigned int pow10U32[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// The fraction loop can run up to 19 digits, and the round-weed step needs
+// the matching power for each.
+static const UInt64 pow10U64[] = {
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+  100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL,
+  1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+  1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+  1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// A cached power that brings a value with binary exponent e into the
+// range DigitGen works in; k receives its negated decimal exponent.
+static DiyFp cachedPower(int e, int* k) {
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = int(dk);
+  if (dk - ik > 0.0)
+    ik++;
+  unsigned index = unsigned((ik >> 3) + 1);
+  *k = -(-348 + int(index * 8));
+  return DiyFp(cachedPowersF[index], cachedPowersE[index]);
+}
+
+static void grisuRound(char* buffer, int len, UInt64 delta, UInt64 rest,
+                       UInt64 tenKappa, UInt64 wpW) {
+  while (rest < wpW && delta - rest >= tenKappa &&
+         (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW)) {
+    buffer[len - 1]--;
+    rest += tenKappa;
+  }
+}
+
+static int countDecimalDigits(unsigned int n) {
+  int digits = 1;
+  while (digits < 10 && n >= pow10U32[digits])
+    digits++;
+  return digits;
+}
+
+static void digitGen(const DiyFp& w, const DiyFp& mp, UInt64 delta,
+                     char* buffer, int* len, int* k) {
+  const DiyFp one(1ULL << -mp.e_, mp.e_);
+  const DiyFp wpW = mp - w;
+  unsigned int p1 = (unsigned int)(mp.f_ >> -one.e_);
+  UInt64 p2 = mp.f_ & (one.f_ - 1);
+  int kappa = countDecimalDigits(p1);
+  *len = 0;
+
+  while (kappa > 0) {
+    unsigned int d = p1 / pow10U32[kappa - 1];
+    p1 %= pow10U32[kappa - 1];
+    if (d || *len)
+      buffer[(*len)++] = char('0' + d);
+    kappa--;
+    UInt64 tmp = (UInt64(p1) << -one.e_) + p2;
+    if (tmp <= delta) {
+      *k += kappa;
+      grisuRound(buffer, *len, delta, tmp, UInt64(pow10U32[kappa]) << -one.e_,
+                 wpW.f_);
+      return;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char d = char(p2 >> -one.e_);
+    if (d || *len)
+      buffer[(*len)++] = char('0' + d);
+    p2 &= one.f_ - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      int index = -kappa;
+      grisuRound(buffer, *len, delta, p2, one.f_,
+                 wpW.f_ * (index < 20 ? pow10U64[index] : 0));
+      return;
+    }
+  }
+}
+
+// Digits of a positive finite value into buffer; the value is
+// buffer * 10^k.
+static int grisu2(double value, char* buffer, int* k) {
+  const DiyFp v(value);
+  DiyFp wMinus(0, 0), wPlus(0, 0);
+  v.normalizedBoundaries(&wMinus, &wPlus);
+
+  const DiyFp cmk = cachedPower(wPlus.e_, k);
+  const DiyFp w = v.normalize() * cmk;
+  DiyFp wp = wPlus * cmk;
+  DiyFp wm = wMinus * cmk;
+  wm.f_++;
+  wp.f_--;
+  int len;
+  digitGen(w, wp, wp.f_ - wm.f_, buffer, &len, k);
+  return len;
+}
+
+} // namespace
+
+/** Writes a finite double to buffer, which must hold 32 chars, in the
+ * layout "%.16g" gives but with the shortest digits that read back as the
+ * same value. Always '.' as decimal point. Returns the length.
+ */
+static int formatDouble(double value, char* buffer) {
+  char* out = buffer;
+  UInt64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (bits >> 63) {
+    *out++ = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    *out++ = '0';
+    return int(out - buffer);
+  }
+
+  char digits[20];
+  int k;
+  int len = grisu2(value, digits, &k);
+  int exponent = len + k - 1; // of the leading digit
+
+  if (exponent < -4 || exponent >= 16) {
+    *out++ = digits[0];
+    if (len > 1) {
+      *out++ = '.';
+      memcpy(out, digits + 1, len - 1);
+      out += len - 1;
+    }
+    *out++ = 'e';
+    *out++ = exponent < 0 ? '-' : '+';
+    if (exponent < 0)
+      exponent = -exponent;
+    if (exponent >= 100)
+      *out++ = char('0' + exponent / 100);
+    *out++ = char('0' + exponent / 10 % 10);
+    *out++ = char('0' + exponent % 10);
+  } else if (exponent < 0) {
+    *out++ = '0';
+    *out++ = '.';
+    for (int i = -1; i > exponent; --i)
+      *out++ = '0';
+    memcpy(out, digits, len);
+    out += len;
+  } else if (len <= exponent + 1) {
+    memcpy(out, digits, len);
+    out += len;
+    for (int i = len; i <= exponent; ++i)
+      *out++ = '0';
+  } else {
+    memcpy(out, digits, exponent + 1);
+    out += exponent + 1;
+    *out++ = '.';
+    memcpy(out, digits + exponent + 1, len - exponent - 1);
+    out += len - exponent - 1;
+  }
+  return int(out - buffer);
+}
+
+#endif // if defined(JSON_HAS_INT64)
+
 std::string valueToString(double value) {
   // Allocate a buffer that is more than large enough to store the 16 digits of
   // precision requested below.
   char buffer[32];
   int len = -1;
 
+#if defined(JSON_HAS_INT64)
+  if (isfinite(value))
+    return std::string(buffer, formatDouble(value, buffer));
+#endif
+
 // Print into the buffer. We need not request the alternative representation
 // that always has a decimal point because JSON doesn't distingish the
 // concepts of reals and integers.
@@ -3159,6 +5163,201 @@ std::string valueToQuotedString(const char* value) {
   return result;
 }
 
+// Class OutputBuffer
+// //////////////////////////////////////////////////////////////////
+
+// The first chunk holds a typical state update whole; each later one is
+// twice the size of the one before, up to outputLargestChunk.
+static const size_t outputFirstChunk = 4096;
+static const size_t outputLargestChunk = 1024 * 1024;
+
+OutputBuffer::OutputBuffer() : current_(0), size_(0) {}
+
+OutputBuffer::~OutputBuffer() {
+  for (size_t index = 0; index < chunks_.size(); ++index)
+    delete[] chunks_[index].data;
+}
+
+void OutputBuffer::clear() {
+  for (size_t index = 0; index < chunks_.size() && index <= current_; ++index)
+    chunks_[index].size = 0;
+  current_ = 0;
+  size_ = 0;
+}
+
+size_t OutputBuffer::size() const { return size_; }
+
+bool OutputBuffer::empty() const { return size_ == 0; }
+
+char* OutputBuffer::grow(size_t length) {
+  if (!chunks_.empty() && chunks_[current_].size != 0)
+    ++current_;
+  if (current_ < chunks_.size() && chunks_[current_].capacity >= length)
+    return chunks_[current_].data;
+
+  size_t capacity = outputFirstChunk;
+  if (current_ > 0)
+    capacity = std::min(2 * chunks_[current_ - 1].capacity, outputLargestChunk);
+  if (capacity < length)
+    capacity = length;
+  Chunk chunk;
+  chunk.data = new char[capacity];
+  chunk.size = 0;
+  chunk.capacity = capacity;
+  if (current_ < chunks_.size()) {
+    // A spare chunk too small for the request: replace it.
+    delete[] chunks_[current_].data;
+    chunks_[current_] = chunk;
+  } else {
+    chunks_.push_back(chunk);
+  }
+  return chunk.data;
+}
+
+char* OutputBuffer::reserve(size_t length) {
+  if (!chunks_.empty()) {
+    Chunk& chunk = chunks_[current_];
+    if (chunk.capacity - chunk.size >= length)
+      return chunk.data + chunk.size;
+  }
+  return grow(length);
+}
+
+void OutputBuffer::commit(size_t length) {
+  chunks_[current_].size += length;
+  size_ += length;
+}
+
+void OutputBuffer::truncate(size_t size) {
+  if (size >= size_)
+    return;
+  size_t kept = 0;
+  size_t index = 0;
+  while (kept + chunks_[index].size < size)
+    kept += chunks_[index++].size;
+  for (size_t spare = index + 1; spare <= current_; ++spare)
+    chunks_[spare].size = 0;
+  chunks_[index].size = size - kept;
+  current_ = (chunks_[index].size == 0 && index > 0) ? index - 1 : index;
+  size_ = size;
+}
+
+void OutputBuffer::append(const char* data, size_t length) {
+  while (length != 0) {
+    size_t room = 0;
+    if (!chunks_.empty())
+      room = chunks_[current_].capacity - chunks_[current_].size;
+    if (room == 0) {
+      grow(1);
+      room = chunks_[current_].capacity;
+    }
+    size_t part = std::min(room, length);
+    memcpy(chunks_[current_].data + chunks_[current_].size, data, part);
+    commit(part);
+    data += part;
+    length -= part;
+  }
+}
+
+void OutputBuffer::append(char c) {
+  *reserve(1) = c;
+  commit(1);
+}
+
+size_t OutputBuffer::chunkCount() const { return size_ != 0 ? current_ + 1 : 0; }
+
+const char* OutputBuffer::chunkData(size_t index) const {
+  return chunks_[index].data;
+}
+
+size_t OutputBuffer::chunkSize(size_t index) const {
+  return chunks_[index].size;
+}
+
+std::string OutputBuffer::toString() const {
+  std::string text;
+  text.reserve(size_);
+  for (size_t index = 0; index < chunkCount(); ++index)
+    text.append(chunks_[index].data, chunks_[index].size);
+  return text;
+}
+
+static void writeUInt(LargestUInt value, bool isNegative, OutputBuffer& out) {
+  UIntToStringBuffer buffer;
+  char* end = buffer + sizeof(buffer) - 1; // uintToString adds a '\0' here
+  char* current = buffer + sizeof(buffer);
+  uintToString(value, current);
+  if (isNegative)
+    *--current = '-';
+  out.append(current, end - current);
+}
+
+static void writeDouble(double value, OutputBuffer& out) {
+#if defined(JSON_HAS_INT64)
+  if (isfinite(value)) {
+    char* buffer = out.reserve(32);
+    out.commit(formatDouble(value, buffer));
+    return;
+  }
+#endif
+  std::string text = valueToString(value);
+  out.append(text.data(), text.size());
+}
+
+/// Same output as valueToQuotedString(), written straight into out in runs
+/// between the characters that need escaping.
+static void writeQuotedString(const char* value, OutputBuffer& out) {
+  static const char hexDigits[] = "0123456789ABCDEF";
+
+  if (value == NULL)
+    return;
+  out.append('"');
+  const char* run = value;
+  for (const char* current = value;; ++current) {
+    unsigned char c = static_cast<unsigned char>(*current);
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    out.append(run, current - run);
+    if (c == 0)
+      break;
+    run = current + 1;
+
+    char* escape = out.reserve(6);
+    escape[0] = '\\';
+    switch (c) {
+    case '"':
+    case '\\':
+      escape[1] = char(c);
+      break;
+    case '\b':
+      escape[1] = 'b';
+      break;
+    case '\f':
+      escape[1] = 'f';
+      break;
+    case '\n':
+      escape[1] = 'n';
+      break;
+    case '\r':
+      escape[1] = 'r';
+      break;
+    case '\t':
+      escape[1] = 't';
+      break;
+    default:
+      escape[1] = 'u';
+      escape[2] = '0';
+      escape[3] = '0';
+      escape[4] = hexDigits[c >> 4];
+      escape[5] = hexDigits[c & 0xF];
+      out.commit(6);
+      continue;
+    }
+    out.commit(2);
+  }
+  out.append('"');
+}
+
 // Class Writer
 // //////////////////////////////////////////////////////////////////
 Writer::~Writer() {}
@@ -3177,57 +5376,69 @@ void FastWriter::dropNullPlaceholders() { dropNullPlaceholders_ = true; }
 void FastWriter::omitEndingLineFeed() { omitEndingLineFeed_ = true; }
 
 std::string FastWriter::write(const Value& root) {
-  document_ = "";
-  writeValue(root);
+  document_.clear();
+  write(root, document_);
+  return document_.toString();
+}
+
+void FastWriter::write(const Value& root, OutputBuffer& out) {
+  writeValue(root, out);
   if (!omitEndingLineFeed_)
-    document_ += "\n";
-  return document_;
+    out.append('\n');
 }
 
-void FastWriter::writeValue(const Value& value) {
+void FastWriter::writeValue(const Value& value, OutputBuffer& out) {
   switch (value.type()) {
   case nullValue:
     if (!dropNullPlaceholders_)
-      document_ += "null";
-    break;
-  case intValue:
-    document_ += valueToString(value.asLargestInt());
+      out.append("null", 4);
     break;
+  case intValue: {
+    LargestInt number = value.asLargestInt();
+    writeUInt(number < 0 ? LargestUInt(0) - LargestUInt(number)
+                         : LargestUInt(number),
+              number < 0, out);
+  } break;
   case uintValue:
-    document_ += valueToString(value.asLargestUInt());
+    writeUInt(value.asLargestUInt(), false, out);
     break;
   case realValue:
-    document_ += valueToString(value.asDouble());
+    writeDouble(value.asDouble(), out);
     break;
   case stringValue:
-    document_ += valueToQuotedString(value.asCString());
+    writeQuotedString(value.asCString(), out);
     break;
   case booleanValue:
-    document_ += valueToString(value.asBool());
+    if (value.asBool())
+      out.append("true", 4);
+    else
+      out.append("false", 5);
     break;
   case arrayValue: {
-    document_ += "[";
+    out.append('[');
     int size = value.size();
     for (int index = 0; index < size; ++index) {
       if (index > 0)
-        document_ += ",";
-      writeValue(value[index]);
+        out.append(',');
+      writeValue(value[index], out);
     }
-    document_ += "]";
+    out.append(']');
   } break;
   case objectValue: {
-    Value::Members members(value.getMemberNames());
-    document_ += "{";
-    for (Value::Members::iterator it = members.begin(); it != members.end();
-         ++it) {
-      const std::string& name = *it;
-      if (it != members.begin())
-        document_ += ",";
-      document_ += valueToQuotedString(name.c_str());
-      document_ += yamlCompatiblityEnabled_ ? ": " : ":";
-      writeValue(value[name]);
+    // Walks the members in place rather than copying their names out and
+    // looking each one up again.
+    out.append('{');
+    for (Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+      if (it != value.begin())
+        out.append(',');
+      writeQuotedString(it.memberName(), out);
+      if (yamlCompatiblityEnabled_)
+        out.append(": ", 2);
+      else
+        out.append(':');
+      writeValue(*it, out);
     }
-    document_ += "}";
+    out.append('}');
   } break;
   }
 }
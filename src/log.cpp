@@ -0,0 +1,348 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "stats.h"
+
+#define RING_OWNED      0
+#define RING_RELEASED   1   /* its thread exited, free once drained */
+
+/*
+ * Single-producer, single-consumer: the owning thread writes at head, the
+ * flusher reads at tail. A ring outlives its thread and goes to the next
+ * thread that finds it drained.
+ */
+typedef struct {
+    log_record_t        records[LOG_RING_SIZE];
+    volatile uint32_t   head;
+    volatile uint32_t   tail;
+    volatile uint32_t   state;
+} log_ring_t;
+
+static log_ring_t               rings[LOG_MAX_THREADS];
+static volatile uint32_t        ringCount   = 0;
+static volatile uint64_t        dropped     = 0;
+static volatile bool            flushing    = false;
+static pthread_t                flusherThread;
+static pthread_key_t            ringKey;
+static pthread_once_t           ringKeyOnce = PTHREAD_ONCE_INIT;
+static __thread log_ring_t*     localRing   = NULL;
+static __thread log_record_t    spare;      /* when no ring is free */
+
+static const char* levelNames[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+static size_t logFormat (const log_record_t* r, char* out, size_t size);
+
+static void
+releaseRing (void* ring) {
+    __atomic_store_n (&((log_ring_t*) ring)->state, RING_RELEASED, __ATOMIC_RELEASE);
+}
+
+static void
+createRingKey () {
+    pthread_key_create (&ringKey, releaseRing);
+}
+
+/*
+ * A drained ring of an exited thread, else a fresh one, else NULL.
+ */
+static log_ring_t*
+claimRing () {
+    uint32_t count = __atomic_load_n (&ringCount, __ATOMIC_ACQUIRE);
+    uint32_t released = RING_RELEASED;
+
+    for (uint32_t i = 0; i < count; i++) {
+        log_ring_t* ring = &rings[i];
+
+        if (__atomic_load_n (&ring->state, __ATOMIC_ACQUIRE) == RING_RELEASED &&
+            __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) == ring->head &&
+            __atomic_compare_exchange_n (&ring->state, &released, RING_OWNED, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            return ring;
+        }
+        released = RING_RELEASED;
+    }
+
+    while (count < LOG_MAX_THREADS) {
+        if (__atomic_compare_exchange_n (&ringCount, &count, count + 1, true,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return &rings[count];
+        }
+    }
+
+    return NULL;
+}
+
+static void
+logPrint (const log_record_t* record) {
+    char line[512];
+
+    logFormat (record, line, sizeof (line));
+    fprintf (stdout, "%llu.%06llu %s %s\n",
+             (unsigned long long) (record->timestamp / 1000000000ULL),
+             (unsigned long long) (record->timestamp % 1000000000ULL) / 1000,
+             levelNames[record->level & 3], line);
+}
+
+/*
+ * With more than LOG_MAX_THREADS threads alive, a thread without a ring
+ * writes its records straight out instead of losing them.
+ */
+log_record_t*
+logReserve (uint8_t level, const char* format) {
+    log_record_t* r;
+
+    if (localRing == NULL) {
+        localRing = claimRing ();
+        if (localRing != NULL) {
+            pthread_once (&ringKeyOnce, createRingKey);
+            pthread_setspecific (ringKey, localRing);
+        }
+    }
+
+    if (localRing == NULL) {
+        r = &spare;
+    } else {
+        uint32_t head = localRing->head;
+        if (head - __atomic_load_n (&localRing->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+            __atomic_fetch_add (&dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+        r = &localRing->records[head & (LOG_RING_SIZE - 1)];
+    }
+
+    r->timestamp    = monotonicNanos ();
+    r->format       = format;
+    r->level        = level;
+    r->count        = 0;
+    r->stringsUsed  = 0;
+
+    return r;
+}
+
+void
+logCommit (log_record_t* record) {
+    if (record == &spare) {
+        logPrint (record);
+        fflush (stdout);
+        return;
+    }
+
+    __atomic_store_n (&localRing->head, localRing->head + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t
+logDropped () {
+    return __atomic_load_n (&dropped, __ATOMIC_RELAXED);
+}
+
+/*
+ * printf with the arguments taken from the record. Each conversion is
+ * re-issued on its own with the length modifier replaced to match the
+ * captured 64 bit value.
+ */
+static size_t
+logFormat (const log_record_t* r, char* out, size_t size) {
+    const char* f   = r->format;
+    size_t      len = 0;
+    int         arg = 0;
+
+    while (*f != '\0' && len + 1 < size) {
+        if (*f != '%') {
+            out[len++] = *f++;
+            continue;
+        }
+
+        if (f[1] == '%') {
+            out[len++] = '%';
+            f += 2;
+            continue;
+        }
+
+        char        spec[32];
+        size_t      specLen = 0;
+        const char* start   = f++;
+
+        while (*f != '\0' && strchr ("-+ #0123456789.*", *f) != NULL) {
+            f++;
+        }
+        specLen = f - start;
+        while (*f != '\0' && strchr ("hlLqjzt", *f) != NULL) {
+            f++;
+        }
+        if (*f == '\0' || specLen + 4 > sizeof (spec)) {
+            break;
+        }
+
+        char conversion = *f++;
+        memcpy (spec, start, specLen);
+
+        if (arg >= r->count) {
+            len += snprintf (out + len, size - len, "<?>");
+        } else {
+            int n = 0;
+
+            switch (r->types[arg]) {
+                case LOG_ARG_INT:
+                case LOG_ARG_UINT:
+                    if (conversion == 'c') {
+                        spec[specLen++] = 'c';
+                        spec[specLen] = '\0';
+                        n = snprintf (out + len, size - len, spec, (int) r->args[arg].i);
+                    } else if (conversion == 'f' || conversion == 'g' || conversion == 'e') {
+                        spec[specLen++] = conversion;
+                        spec[specLen] = '\0';
+                        n = snprintf (out + len, size - len, spec,
+                                      (r->types[arg] == LOG_ARG_INT) ? (double) r->args[arg].i : (double) r->args[arg].u);
+                    } else {
+                        spec[specLen++] = 'l';
+                        spec[specLen++] = 'l';
+                        spec[specLen++] = (conversion == 's') ? 'd' : conversion;
+                        spec[specLen] = '\0';
+                        n = snprintf (out + len, size - len, spec, r->args[arg].i);
+                    }
+                break;
+                case LOG_ARG_DOUBLE:
+                    spec[specLen++] = (strchr ("feEgGaA", conversion) != NULL) ? conversion : 'g';
+                    spec[specLen] = '\0';
+                    n = snprintf (out + len, size - len, spec, r->args[arg].d);
+                break;
+                case LOG_ARG_STRING:
+                    spec[specLen++] = 's';
+                    spec[specLen] = '\0';
+                    n = snprintf (out + len, size - len, spec, r->strings + r->args[arg].offset);
+                break;
+                case LOG_ARG_POINTER:
+                    spec[specLen++] = 'p';
+                    spec[specLen] = '\0';
+                    n = snprintf (out + len, size - len, spec, r->args[arg].p);
+                break;
+            }
+
+            if (n > 0) {
+                len += n;
+            }
+        }
+
+        if (len >= size) {
+            len = size - 1;
+        }
+        arg++;
+    }
+
+    out[len] = '\0';
+    return len;
+}
+
+/*
+ * Drains every ring, oldest record first across threads.
+ */
+static int
+logFlush () {
+    uint32_t count   = __atomic_load_n (&ringCount, __ATOMIC_ACQUIRE);
+    int      flushed = 0;
+
+    if (count > LOG_MAX_THREADS) {
+        count = LOG_MAX_THREADS;
+    }
+
+    for (;;) {
+        log_ring_t*   oldest = NULL;
+        log_record_t* record = NULL;
+
+        for (uint32_t i = 0; i < count; i++) {
+            log_ring_t* ring = &rings[i];
+            uint32_t    tail = ring->tail;
+
+            if (tail == __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+
+            log_record_t* r = &ring->records[tail & (LOG_RING_SIZE - 1)];
+            if (record == NULL || r->timestamp < record->timestamp) {
+                oldest = ring;
+                record = r;
+            }
+        }
+
+        if (record == NULL) {
+            break;
+        }
+
+        logPrint (record);
+        __atomic_store_n (&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
+        flushed++;
+    }
+
+    if (flushed > 0) {
+        fflush (stdout);
+    }
+
+    return flushed;
+}
+
+static void *
+logFlusher (void *) {
+    uint64_t reported = 0;
+
+    while (__atomic_load_n (&flushing, __ATOMIC_ACQUIRE)) {
+        logFlush ();
+
+        uint64_t lost = logDropped ();
+        if (lost != reported) {
+            fprintf (stdout, "%llu log records dropped...\n", (unsigned long long) (lost - reported));
+            fflush (stdout);
+            reported = lost;
+        }
+
+        usleep (LOG_FLUSH_MS * 1000);
+    }
+
+    logFlush ();
+    return NULL;
+}
+
+/*
+ * logStop is also registered with atexit, so what was logged right before
+ * an exit (EXIT_FAILURE) still gets written.
+ */
+void
+logStart () {
+    static bool registered = false;
+
+    if (flushing) {
+        return;
+    }
+
+    if (!registered) {
+        atexit (logStop);
+        registered = true;
+    }
+
+    flushing = true;
+    if (pthread_create (&flusherThread, NULL, logFlusher, NULL) != 0) {
+        flushing = false;
+    }
+}
+
+/*
+ * Joins the flusher after its last drain; without one running, drains on
+ * the calling thread.
+ */
+void
+logStop () {
+    if (!flushing) {
+        logFlush ();
+        return;
+    }
+
+    __atomic_store_n (&flushing, false, __ATOMIC_RELEASE);
+    pthread_join (flusherThread, NULL);
+}
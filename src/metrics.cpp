@@ -0,0 +1,137 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "log.h"
+#include "metrics.h"
+#include "stats.h"
+
+using namespace std;
+
+robe_metrics_t metrics;
+
+static const char* sourceNames[METRICS_SOURCES]   = { "redis", "ipc" };
+static const char* handlerNames[METRICS_HANDLERS] = { "coordinate", "servo" };
+static const char* jointNames[METRICS_JOINTS]     = { "base", "shoulder", "elbow", "whrist" };
+static const char* clientNames[METRICS_CLIENTS]   = { "publisher", "subscriber" };
+
+/* Bucket bounds for the exported histograms, nanoseconds. */
+static const uint64_t bucketBounds[] = {
+    10000ULL, 50000ULL, 100000ULL, 500000ULL,
+    1000000ULL, 5000000ULL, 10000000ULL, 50000000ULL,
+    100000000ULL, 500000000ULL, 1000000000ULL, 5000000000ULL
+};
+
+static uint64_t
+load (volatile uint64_t& counter) {
+    return __atomic_load_n (&counter, __ATOMIC_RELAXED);
+}
+
+static void
+append (string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+static void
+append (string& out, const char* format, ...) {
+    char    line[256];
+    va_list args;
+
+    va_start (args, format);
+    int len = vsnprintf (line, sizeof (line), format, args);
+    va_end (args);
+
+    if (len > 0) {
+        out.append (line, ((size_t) len < sizeof (line)) ? len : sizeof (line) - 1);
+    }
+}
+
+static void
+header (string& out, const char* name, const char* type, const char* help) {
+    append (out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+histogram (string& out, const char* name, const char* labels, LatencyHistogram& h) {
+    const char* sep = (labels[0] != '\0') ? "," : "";
+    char        set[80];
+
+    for (size_t i = 0; i < sizeof (bucketBounds) / sizeof (bucketBounds[0]); i++) {
+        append (out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep,
+                bucketBounds[i] / 1e9, (unsigned long long) h.countAtOrBelow (bucketBounds[i]));
+    }
+    append (out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long) h.count ());
+
+    snprintf (set, sizeof (set), (labels[0] != '\0') ? "{%s}" : "%s", labels);
+    append (out, "%s_sum%s %.9f\n", name, set, h.sum () / 1e9);
+    append (out, "%s_count%s %llu\n", name, set, (unsigned long long) h.count ());
+}
+
+/*
+ * Prometheus text exposition format, version 0.0.4.
+ */
+void
+metricsToText (string& out, const metrics_gauges_t& gauges) {
+    char labels[64];
+
+    header (out, "robe_commands_received_total", "counter", "Commands decoded, by source and handler.");
+    for (int source = 0; source < METRICS_SOURCES; source++) {
+        for (int handler = 0; handler < METRICS_HANDLERS; handler++) {
+            append (out, "robe_commands_received_total{source=\"%s\",handler=\"%s\"} %llu\n",
+                    sourceNames[source], handlerNames[handler],
+                    (unsigned long long) load (metrics.commands[source][handler]));
+        }
+    }
+
+    header (out, "robe_parse_failures_total", "counter", "Inbound messages that did not decode to a command.");
+    for (int source = 0; source < METRICS_SOURCES; source++) {
+        append (out, "robe_parse_failures_total{source=\"%s\"} %llu\n",
+                sourceNames[source], (unsigned long long) load (metrics.parseFailures[source]));
+    }
+
+    header (out, "robe_commands_dropped_total", "counter", "Commands dropped because the command ring was full.");
+    for (int source = 0; source < METRICS_SOURCES; source++) {
+        append (out, "robe_commands_dropped_total{source=\"%s\"} %llu\n",
+                sourceNames[source], (unsigned long long) load (metrics.dropped[source]));
+    }
+
+    header (out, "robe_ik_misses_total", "counter", "Coordinates with no entry in the angle map.");
+    append (out, "robe_ik_misses_total %llu\n", (unsigned long long) load (metrics.ikMisses));
+
+    header (out, "robe_command_queue_depth", "gauge", "Commands waiting for the motion thread.");
+    append (out, "robe_command_queue_depth %u\n", gauges.queueDepth);
+
+    header (out, "robe_pwm_writes_total", "counter", "Pulse width updates, by joint.");
+    for (int joint = 0; joint < METRICS_JOINTS; joint++) {
+        append (out, "robe_pwm_writes_total{joint=\"%s\"} %llu\n",
+                jointNames[joint], (unsigned long long) load (metrics.pwmWrites[joint]));
+    }
+
+    header (out, "robe_redis_reconnects_total", "counter", "Redis reconnect attempts, by connection.");
+    for (int client = 0; client < METRICS_CLIENTS; client++) {
+        append (out, "robe_redis_reconnects_total{client=\"%s\"} %llu\n",
+                clientNames[client], (unsigned long long) load (metrics.redisReconnects[client]));
+    }
+
+    header (out, "robe_redis_connected", "gauge", "1 when the publisher connection is up.");
+    append (out, "robe_redis_connected %d\n", gauges.redisConnected ? 1 : 0);
+
+    header (out, "robe_log_dropped_total", "counter", "Log records dropped on full log rings.");
+    append (out, "robe_log_dropped_total %llu\n", (unsigned long long) logDropped ());
+
+    if (gauges.ticks != NULL) {
+        header (out, "robe_tick_deadline_misses_total", "counter", "Servo steps that ran later than the tick deadline.");
+        append (out, "robe_tick_deadline_misses_total %llu\n", (unsigned long long) gauges.ticks->getMisses ());
+
+        header (out, "robe_tick_lateness_seconds", "histogram", "How late servo steps ran against their schedule.");
+        histogram (out, "robe_tick_lateness_seconds", "", gauges.ticks->getJitter ());
+    }
+
+    header (out, "robe_stage_latency_seconds", "histogram", "Per-stage command latency, see stats.h.");
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        snprintf (labels, sizeof (labels), "stage=\"%s\"", stageName (stage));
+        histogram (out, "robe_stage_latency_seconds", labels, latencyStats[stage]);
+    }
+}
@@ -0,0 +1,333 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <stdlib.h>
+#include <cstring>
+
+#include "metrics.h"
+#include "motion.h"
+#include "profile.h"
+#include "stats.h"
+
+bool
+motionEnqueue (CommandRing& ring, command_t& cmd, uint8_t source, uint64_t receivedAt,
+               Recorder* recorder) {
+    cmd.source      = source;
+    cmd.receivedAt  = receivedAt;
+    cmd.parsedAt    = monotonicNanos ();
+    cmd.enqueuedAt  = cmd.parsedAt;
+    latencyStats[STAGE_PARSE].record (cmd.parsedAt - cmd.receivedAt);
+
+    if (source < METRICS_SOURCES && cmd.handler >= COORDINATE && cmd.handler <= SERVO) {
+        metricsCount (metrics.commands[source][cmd.handler - COORDINATE]);
+    }
+
+    if (!ring.push (cmd)) {
+        metricsCount (metrics.dropped[source < METRICS_SOURCES ? source : 0]);
+        return false;
+    }
+
+    // Only what was queued, so a replay does not run commands robe dropped.
+    if (recorder != NULL) {
+        recorder->command (cmd);
+    }
+
+    return true;
+}
+
+MotionController::MotionController () {
+    memset (&this->arm, 0, sizeof (this->arm));
+    memset (&this->activeCommand, 0, sizeof (this->activeCommand));
+
+    this->arm.z_offset      = 5;
+    this->arm.coxa          = 5.5;
+    this->arm.fermur        = 5.5;
+    this->arm.tibia         = 8;
+
+    this->servos[BASE].currentAngle     = 90;
+    this->servos[SHOULDER].currentAngle = 50;
+    this->servos[ELBOW].currentAngle    = 160;
+    this->servos[WHRIST].currentAngle   = 170;
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        this->servos[joint].joint        = joint;
+        this->servos[joint].currentWidth = angleToPulseWidth (this->servos[joint].currentAngle);
+    }
+
+    this->pwm               = NULL;
+    this->telemetry         = NULL;
+    this->profiler          = NULL;
+    this->recorder          = NULL;
+    this->publishCallback   = NULL;
+    this->publishPriv       = NULL;
+    this->stepDelayUs       = SERVO_STEP_DELAY_US;
+    this->firstPwmAt        = 0;
+    this->lastPwmAt         = 0;
+}
+
+void
+MotionController::setBackend (PwmBackend* pwm) {
+    this->pwm = pwm;
+}
+
+void
+MotionController::setTelemetry (TelemetryRing* ring) {
+    this->telemetry = ring;
+}
+
+void
+MotionController::setPublishCallback (motion_publish_callback_t callback, void* priv) {
+    this->publishCallback = callback;
+    this->publishPriv     = priv;
+}
+
+/*
+ * 0 runs the servo ramps as fast as the backend takes them, only useful
+ * with SimulatedPwm.
+ */
+void
+MotionController::setStepDelay (int us) {
+    this->stepDelayUs = us;
+}
+
+void
+MotionController::setTickProfiler (TickProfiler* profiler) {
+    this->profiler = profiler;
+}
+
+void
+MotionController::setRecorder (Recorder* recorder) {
+    this->recorder = recorder;
+}
+
+/*
+ * Brings the PWM channels up and drives the arm to its home position.
+ */
+void
+MotionController::start () {
+    this->pwm->init (BASE,     PWM_BASE);
+    this->pwm->init (SHOULDER, PWM_SHOULDER);
+    this->pwm->init (ELBOW,    PWM_ELBOW);
+    this->pwm->init (WHRIST,   PWM_WHRIST);
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        this->pwm->period (joint, PERIOD_WIDTH);
+        this->pwm->enable (joint, ENABLE);
+    }
+
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        this->setAngle (this->servos[joint], this->servos[joint].currentAngle, SERVO_SPEED_LOW);
+    }
+}
+
+int
+MotionController::getAngle (int joint) {
+    return this->servos[joint].currentAngle;
+}
+
+/*
+ * Returns false when the command could not be carried out (unknown
+ * handler, unreachable coordinate, bad servo id).
+ */
+bool
+MotionController::execute (command_t& cmd) {
+    uint64_t dequeuedAt  = monotonicNanos ();
+    uint64_t publishTime = 0;
+    uint64_t publishAt;
+    bool     done        = false;
+
+    this->activeCommand = cmd;
+    this->firstPwmAt    = 0;
+    this->lastPwmAt     = 0;
+    latencyStats[STAGE_QUEUE].record (dequeuedAt - cmd.enqueuedAt);
+
+    switch (cmd.handler) {
+        case COORDINATE: {
+            this->arm.coord.x = cmd.x;
+            this->arm.coord.y = cmd.y;
+            this->arm.coord.z = cmd.z;
+            this->arm.coord.p = cmd.p;
+
+            // TODO - Inverse Kinematics
+            uint8_t found;
+            {
+                ProfileStage stage (PROFILE_STAGE_IK);
+                found = findAnglesMap (this->arm);
+            }
+            latencyStats[STAGE_IK].record (monotonicNanos () - dequeuedAt);
+            if (!found) {
+                metricsCount (metrics.ikMisses);
+            }
+
+            if (found) {
+                arm_angles_t* angles = this->arm.angles_ptr;
+
+                this->setAngle (this->servos[BASE],     angles->tn, SERVO_SPEED_LOW);
+                this->setAngle (this->servos[SHOULDER], angles->j1, SERVO_SPEED_LOW);
+                this->setAngle (this->servos[ELBOW],    angles->j2, SERVO_SPEED_LOW);
+                this->setAngle (this->servos[WHRIST],   angles->j3, SERVO_SPEED_LOW);
+
+                publishAt = monotonicNanos ();
+                this->publish (1, angles->tn);
+                this->publish (2, angles->j1);
+                this->publish (3, angles->j2);
+                this->publish (4, angles->j3);
+                publishTime = monotonicNanos () - publishAt;
+                done = true;
+            }
+        }
+        break;
+        case SERVO: {
+            if (cmd.id > 0 && cmd.id <= WHRIST + 1) {
+                this->setAngle (this->servos[cmd.id - 1], cmd.angle, SERVO_SPEED_LOW);
+
+                publishAt = monotonicNanos ();
+                this->publish (cmd.id, cmd.angle);
+                publishTime = monotonicNanos () - publishAt;
+                done = true;
+            }
+        }
+        break;
+    }
+
+    // Commands that never moved a servo (unreachable, already there) only
+    // count towards the stages they went through.
+    if (this->firstPwmAt != 0) {
+        latencyStats[STAGE_FIRST_PWM].record (this->firstPwmAt - cmd.receivedAt);
+        latencyStats[STAGE_FINAL_PWM].record (this->lastPwmAt - cmd.receivedAt);
+    }
+
+    if (publishTime != 0) {
+        latencyStats[STAGE_PUBLISH].record (publishTime);
+    }
+
+    if (this->profiler != NULL) {
+        this->profiler->command (cmd.handler, dequeuedAt, monotonicNanos ());
+    }
+
+    return done;
+}
+
+void
+MotionController::publish (int id, int angle) {
+    ProfileStage stage (PROFILE_STAGE_PUBLISH);
+    char         msg[128];
+
+    if (this->publishCallback == NULL) {
+        return;
+    }
+
+    servoMsgFactory (msg, id, angle);
+    this->publishCallback (msg, this->publishPriv);
+}
+
+/*
+ * One servo tick. Ticks are due on an absolute schedule, delayUs apart;
+ * when a tick runs more than a whole period late the schedule restarts
+ * from now instead of firing the missed ticks back to back.
+ */
+void
+MotionController::step (servo_context_t& ctx, int width, uint64_t& scheduled, int delayUs) {
+    uint64_t actual = monotonicNanos ();
+
+    if (scheduled == 0) {
+        scheduled = actual;
+    }
+
+    this->pwmWrite (ctx, width);
+    if (this->profiler != NULL && delayUs > 0) {
+        this->profiler->tick (ctx.joint, width, scheduled, actual);
+    }
+
+    if (delayUs > 0) {
+        scheduled += delayUs * 1000ULL;
+        if (actual > scheduled) {
+            scheduled = actual + delayUs * 1000ULL;
+        }
+        sleepUntilNanos (scheduled);
+    }
+}
+
+void
+MotionController::setAngle (servo_context_t& ctx, int angle, uint8_t speed) {
+    int16_t width = angleToPulseWidth (angle);
+    uint16_t prevWidth = angleToPulseWidth (ctx.currentAngle);
+    uint64_t scheduled = 0;
+
+    switch (speed) {
+        case SERVO_SPEED_LOW: {
+            int delta = abs(width - prevWidth);
+            int move = delta / SERVO_STEP_WIDTH;
+            int direction = (width - prevWidth > 0) ? 1 : -1;
+            
+            width = prevWidth;
+            for (int i = 0; i < move; i++) {
+                width += (direction * SERVO_STEP_WIDTH);
+                this->step (ctx, width, scheduled, this->stepDelayUs);
+            }
+            
+            ctx.currentAngle = angle;
+        }
+        break;
+        case SERVO_SPEED_MIDDLE:
+            this->pwmWrite (ctx, width);
+        break;
+        case SERVO_SPEED_HIGH:
+            this->pwmWrite (ctx, width);
+        break;
+        default: { // TODO - Somehow to make the speed work
+            int delta = abs(angle - ctx.currentAngle);
+            int direction = (angle - ctx.currentAngle > 0) ? 1 : -1;
+
+            for (int i = 0; i < delta; i++) {
+                width = angleToPulseWidth (ctx.currentAngle + direction);
+                this->step (ctx, width, scheduled, 100000);
+                ctx.currentAngle += direction;
+            }
+        }
+        break;
+    }
+}
+
+/*
+ * Every PWM update goes through here so the telemetry ring sees each motion
+ * tick. Angles in the record are derived from the live pulse widths.
+ */
+void
+MotionController::pwmWrite (servo_context_t& ctx, int width) {
+    telemetry_record_t  record;
+
+    this->pwm->pulseWidth (ctx.joint, width);
+    ctx.currentWidth = width;
+    metricsCount (metrics.pwmWrites[ctx.joint]);
+
+    record.timestamp = monotonicNanos ();
+    if (this->firstPwmAt == 0) {
+        this->firstPwmAt = record.timestamp;
+    }
+    this->lastPwmAt = record.timestamp;
+
+    if (this->recorder != NULL) {
+        this->recorder->pwm (ctx.joint, width, record.timestamp);
+    }
+
+    if (this->telemetry == NULL) {
+        return;
+    }
+
+    record.handler   = this->activeCommand.handler;
+    record.source    = this->activeCommand.source;
+    record.joint     = ctx.joint;
+    record.reserved  = 0;
+    record.x         = this->activeCommand.x;
+    record.y         = this->activeCommand.y;
+    record.z         = this->activeCommand.z;
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        record.widths[joint] = this->servos[joint].currentWidth;
+        record.angles[joint] = pulseWidthToAngle (this->servos[joint].currentWidth);
+    }
+
+    this->telemetry->publish (record);
+}
@@ -0,0 +1,331 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cstring>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <map>
+#include <string>
+
+#include "profile.h"
+
+using namespace std;
+
+/* Farthest a frame may sit above the one it called, or the first above sp. */
+#define PROFILE_MAX_FRAME       (1024 * 1024)
+
+typedef struct {
+    volatile uint64_t   sequence;   /* 2 * index + 1 while written, 2 * index + 2 when done */
+    uint8_t             stage;
+    uint8_t             depth;
+    void*               frames[PROFILE_MAX_DEPTH];
+} profile_sample_t;
+
+profile_alloc_t profileAllocs[PROFILE_STAGE_COUNT];
+
+static const char* stageNames[PROFILE_STAGE_COUNT] = {
+    "other", "parse", "ik", "publish"
+};
+
+static profile_sample_t     samples[PROFILE_RING_SIZE];
+static volatile uint64_t    head;
+static volatile uint32_t    running;
+static uint32_t             rate;
+static bool                 installed;
+
+volatile uint32_t           profileCounting;
+__thread int                profileCurrentStage;
+
+ProfileStage::ProfileStage (int stage) {
+    this->previous = profileCurrentStage;
+    profileCurrentStage = stage;
+}
+
+ProfileStage::~ProfileStage () {
+    profileCurrentStage = this->previous;
+}
+
+/*
+ * The interrupted pc followed by the return addresses found by following
+ * the frame pointer chain up from the interrupted frame. backtrace() is
+ * not used: the unwinder can take the loader lock, which the interrupted
+ * thread may be holding. robe is built with -fno-omit-frame-pointer; a
+ * chain that breaks off in code built without one ends the stack there,
+ * and every frame is checked to lie a little above the one before, on the
+ * stack, before it is read.
+ */
+static uint8_t
+unwind (const ucontext_t* uc, void** frames) {
+    uintptr_t pc;
+    uintptr_t fp;
+    uintptr_t sp;
+
+#if defined(__x86_64__)
+    pc = uc->uc_mcontext.gregs[REG_RIP];
+    fp = uc->uc_mcontext.gregs[REG_RBP];
+    sp = uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(__i386__)
+    pc = uc->uc_mcontext.gregs[REG_EIP];
+    fp = uc->uc_mcontext.gregs[REG_EBP];
+    sp = uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(__aarch64__)
+    pc = uc->uc_mcontext.pc;
+    fp = uc->uc_mcontext.regs[29];
+    sp = uc->uc_mcontext.sp;
+#else
+    (void) uc;
+    return 0;
+#endif
+
+    uint8_t   depth = 0;
+    uintptr_t low   = sp;
+
+    frames[depth++] = (void*) pc;
+
+    // [fp] is the caller's fp, [fp + 1] the return address into the caller.
+    while (depth < PROFILE_MAX_DEPTH && fp >= low && fp - low <= PROFILE_MAX_FRAME &&
+           fp % sizeof (uintptr_t) == 0) {
+        const uintptr_t* frame = (const uintptr_t*) fp;
+
+        if (frame[1] == 0) {
+            break;
+        }
+        frames[depth++] = (void*) frame[1];
+        low = fp + 2 * sizeof (uintptr_t);
+        fp  = frame[0];
+    }
+
+    return depth;
+}
+
+/*
+ * Only async-signal-safe work here, and no locks.
+ */
+static void
+profileSignal (int sig, siginfo_t* info, void* context) {
+    int               saved  = errno;
+    uint64_t          index  = __atomic_fetch_add (&head, 1, __ATOMIC_RELAXED);
+    profile_sample_t* sample = &samples[index & (PROFILE_RING_SIZE - 1)];
+
+    (void) sig;
+    (void) info;
+
+    __atomic_store_n (&sample->sequence, 2 * index + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    sample->stage = profileCurrentStage;
+    sample->depth = unwind ((const ucontext_t*) context, sample->frames);
+    __atomic_store_n (&sample->sequence, 2 * index + 2, __ATOMIC_RELEASE);
+
+    errno = saved;
+}
+
+void
+profileStart (uint32_t hz) {
+    struct itimerval timer;
+
+    if (hz == 0) {
+        hz = PROFILE_DEFAULT_HZ;
+    }
+
+    profileStop ();
+
+    if (!installed) {
+        struct sigaction action;
+
+        // Stays installed: a SIGPROF still in flight after profileStop
+        // must not hit the default action, which terminates.
+        memset (&action, 0, sizeof (action));
+        action.sa_sigaction = profileSignal;
+        action.sa_flags     = SA_SIGINFO | SA_RESTART;
+        sigemptyset (&action.sa_mask);
+        sigaction (SIGPROF, &action, NULL);
+        installed = true;
+    }
+
+    for (uint32_t i = 0; i < PROFILE_RING_SIZE; i++) {
+        __atomic_store_n (&samples[i].sequence, 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n (&head, 0, __ATOMIC_RELAXED);
+    memset ((void*) profileAllocs, 0, sizeof (profileAllocs));
+
+    rate = hz;
+    __atomic_store_n (&running, 1, __ATOMIC_RELEASE);
+    __atomic_store_n (&profileCounting, 1, __ATOMIC_RELEASE);
+
+    timer.it_interval.tv_sec  = 0;
+    timer.it_interval.tv_usec = (1000000 / hz > 0) ? 1000000 / hz : 1;
+    timer.it_value            = timer.it_interval;
+    setitimer (ITIMER_PROF, &timer, NULL);
+}
+
+void
+profileStop () {
+    struct itimerval timer;
+
+    memset (&timer, 0, sizeof (timer));
+    setitimer (ITIMER_PROF, &timer, NULL);
+    __atomic_store_n (&running, 0, __ATOMIC_RELEASE);
+    __atomic_store_n (&profileCounting, 0, __ATOMIC_RELEASE);
+}
+
+void
+profileCountAllocations (bool enable) {
+    __atomic_store_n (&profileCounting, enable ? 1 : 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Allocations counted so far, all stages.
+ */
+uint64_t
+profileAllocations () {
+    uint64_t total = 0;
+
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        total += __atomic_load_n (&profileAllocs[stage].allocs, __ATOMIC_RELAXED);
+    }
+
+    return total;
+}
+
+bool
+profileRunning () {
+    return __atomic_load_n (&running, __ATOMIC_ACQUIRE) != 0;
+}
+
+const char*
+profileStageName (int stage) {
+    return stageNames[stage];
+}
+
+/*
+ * "function" when the dynamic symbol table knows it (robe is linked with
+ * -rdynamic), otherwise "module+0xoffset" for addr2line.
+ */
+static const string&
+symbolize (void* pc, map<void*, string>& cache) {
+    map<void*, string>::iterator it = cache.find (pc);
+    if (it != cache.end ()) {
+        return it->second;
+    }
+
+    Dl_info info;
+    char    name[64];
+    string  symbol;
+
+    if (dladdr (pc, &info) != 0 && info.dli_sname != NULL) {
+        int   status;
+        char* demangled = abi::__cxa_demangle (info.dli_sname, NULL, NULL, &status);
+
+        symbol = (status == 0 && demangled != NULL) ? demangled : info.dli_sname;
+        free (demangled);
+    } else if (info.dli_fname != NULL) {
+        const char* module = strrchr (info.dli_fname, '/');
+
+        snprintf (name, sizeof (name), "+0x%lx", (unsigned long) ((char*) pc - (char*) info.dli_fbase));
+        symbol  = (module != NULL) ? module + 1 : info.dli_fname;
+        symbol += name;
+    } else {
+        snprintf (name, sizeof (name), "0x%lx", (unsigned long) pc);
+        symbol = name;
+    }
+
+    // ';' separates frames in the folded format.
+    for (size_t i = 0; i < symbol.size (); i++) {
+        if (symbol[i] == ';') {
+            symbol[i] = ':';
+        }
+    }
+
+    return cache[pc] = symbol;
+}
+
+/*
+ * Folded stacks, one "stage;outermost;...;innermost count" line per
+ * distinct stack, ready for flamegraph.pl. Can be called while sampling;
+ * samples being written at that moment are skipped. Returns the number of
+ * distinct stacks or -1.
+ */
+int
+profileDump (const char* path) {
+    map<void*, string>     symbols;
+    map<string, uint32_t>  stacks;
+    profile_sample_t       sample;
+    uint64_t               end   = __atomic_load_n (&head, __ATOMIC_ACQUIRE);
+    uint64_t               start = (end > PROFILE_RING_SIZE) ? end - PROFILE_RING_SIZE : 0;
+
+    for (uint64_t index = start; index < end; index++) {
+        const profile_sample_t* slot = &samples[index & (PROFILE_RING_SIZE - 1)];
+
+        if (__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) != 2 * index + 2) {
+            continue;
+        }
+        memcpy (&sample, (const void*) slot, sizeof (sample));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        if (__atomic_load_n (&slot->sequence, __ATOMIC_RELAXED) != 2 * index + 2) {
+            continue;
+        }
+
+        string stack = stageNames[sample.stage < PROFILE_STAGE_COUNT ? sample.stage : PROFILE_STAGE_OTHER];
+        for (int frame = sample.depth - 1; frame >= 0; frame--) {
+            // Return addresses point past the call, which may be the next function.
+            char* pc = (char*) sample.frames[frame] - ((frame > 0) ? 1 : 0);
+
+            stack += ";";
+            stack += symbolize (pc, symbols);
+        }
+        stacks[stack]++;
+    }
+
+    FILE* out = fopen (path, "w");
+    if (out == NULL) {
+        return -1;
+    }
+
+    for (map<string, uint32_t>::iterator it = stacks.begin (); it != stacks.end (); ++it) {
+        fprintf (out, "%s %u\n", it->first.c_str (), it->second);
+    }
+
+    if (fclose (out) != 0) {
+        return -1;
+    }
+
+    return stacks.size ();
+}
+
+/*
+ * {"running":bool,"hz":N,"samples":N,"allocs":{"parse":{"allocs":N,"frees":N,"bytes":N},...}}
+ */
+int
+profileToJson (char* buffer, size_t size) {
+    size_t offset = 0;
+
+    offset += snprintf (buffer + offset, size - offset,
+                        "{\"running\":%s,\"hz\":%u,\"samples\":%llu,\"allocs\":{",
+                        profileRunning () ? "true" : "false", rate,
+                        (unsigned long long) __atomic_load_n (&head, __ATOMIC_RELAXED));
+
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT && offset < size; stage++) {
+        profile_alloc_t& a = profileAllocs[stage];
+
+        offset += snprintf (buffer + offset, size - offset,
+                            "%s\"%s\":{\"allocs\":%llu,\"frees\":%llu,\"bytes\":%llu}",
+                            (stage > 0) ? "," : "", stageNames[stage],
+                            (unsigned long long) __atomic_load_n (&a.allocs, __ATOMIC_RELAXED),
+                            (unsigned long long) __atomic_load_n (&a.frees, __ATOMIC_RELAXED),
+                            (unsigned long long) __atomic_load_n (&a.bytes, __ATOMIC_RELAXED));
+    }
+
+    if (offset < size) {
+        offset += snprintf (buffer + offset, size - offset, "}}");
+    }
+
+    return (offset < size) ? (int) offset : -1;
+}
@@ -0,0 +1,88 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <cstring>
+
+#include "pwm.h"
+
+SimulatedPwm::SimulatedPwm () {
+    memset (this->widths, 0, sizeof (this->widths));
+    memset ((void*) this->writes, 0, sizeof (this->writes));
+}
+
+bool
+SimulatedPwm::init (int channel, int pin) {
+    return channel >= 0 && channel < PWM_MAX_CHANNELS;
+}
+
+void
+SimulatedPwm::period (int channel, int us) {
+}
+
+void
+SimulatedPwm::enable (int channel, bool enable) {
+}
+
+void
+SimulatedPwm::pulseWidth (int channel, int us) {
+    this->widths[channel] = us;
+    __atomic_store_n (&this->writes[channel], this->writes[channel] + 1, __ATOMIC_RELAXED);
+}
+
+const char*
+SimulatedPwm::name () {
+    return "simulated";
+}
+
+int
+SimulatedPwm::getPulseWidth (int channel) {
+    return this->widths[channel];
+}
+
+uint64_t
+SimulatedPwm::getWrites (int channel) {
+    return __atomic_load_n (&this->writes[channel], __ATOMIC_RELAXED);
+}
+
+#ifdef HAVE_MRAA
+MraaPwm::MraaPwm () {
+    mraa_init ();
+    memset (this->contexts, 0, sizeof (this->contexts));
+}
+
+MraaPwm::~MraaPwm () {
+    for (int i = 0; i < PWM_MAX_CHANNELS; i++) {
+        if (this->contexts[i] != NULL) {
+            mraa_pwm_close (this->contexts[i]);
+        }
+    }
+}
+
+bool
+MraaPwm::init (int channel, int pin) {
+    this->contexts[channel] = mraa_pwm_init (pin);
+    return this->contexts[channel] != NULL;
+}
+
+void
+MraaPwm::period (int channel, int us) {
+    mraa_pwm_period_us (this->contexts[channel], us);
+}
+
+void
+MraaPwm::enable (int channel, bool enable) {
+    mraa_pwm_enable (this->contexts[channel], enable ? 1 : 0);
+}
+
+void
+MraaPwm::pulseWidth (int channel, int us) {
+    mraa_pwm_pulsewidth_us (this->contexts[channel], us);
+}
+
+const char*
+MraaPwm::name () {
+    return "mraa";
+}
+#endif
@@ -0,0 +1,383 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <cstring>
+#include <algorithm>
+
+#include "json/json.h"
+#include "query.h"
+
+using namespace std;
+
+/* Room one append formats into; a history row fits. */
+#define APPEND_MAX  256
+
+static void
+append (Json::OutputBuffer& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/*
+ * Formats straight into the end of out, no line buffer in between.
+ */
+static void
+append (Json::OutputBuffer& out, const char* format, ...) {
+    char*   line = out.reserve (APPEND_MAX);
+    va_list args;
+
+    va_start (args, format);
+    int len = vsnprintf (line, APPEND_MAX, format, args);
+    va_end (args);
+
+    if (len > 0) {
+        out.commit (((size_t) len < APPEND_MAX) ? len : APPEND_MAX - 1);
+    }
+}
+
+static inline void
+put (Json::OutputBuffer& out, const char* text) {
+    out.append (text, strlen (text));
+}
+
+/* Length of a %g or %.1f number, sign and exponent included. */
+#define REAL_MAX    32
+
+/*
+ * value formatted into buffer, or null when it is not finite: JSON has no
+ * nan or inf.
+ */
+static const char*
+real (char* buffer, double value, const char* format) {
+    if (!isfinite (value)) {
+        return "null";
+    }
+
+    snprintf (buffer, REAL_MAX, format, value);
+    return buffer;
+}
+
+/*
+ * Width of each of buckets over [from, to). Buckets of a second or more
+ * are widened to whole seconds and from is moved back to a second, so no
+ * bucket edge cuts a rollup and nothing has to be read row by row.
+ */
+uint64_t
+historyBucketWidth (uint64_t& from, uint64_t to, uint32_t buckets) {
+    uint64_t fine = historyRollupNanos (HISTORY_ROLLUP_LEVELS - 1);
+
+    if (buckets == 0 || to <= from) {
+        return 0;
+    }
+
+    uint64_t width = (to - from + buckets - 1) / buckets;
+    if (width >= fine) {
+        from -= from % fine;
+        width = ((to - from + buckets - 1) / buckets + fine - 1) / fine * fine;
+    }
+
+    return width;
+}
+
+typedef struct {
+    uint64_t                from;
+    uint64_t                to;
+    uint64_t                width;
+    history_aggregate_t*    out;
+    uint64_t                covered;
+} downsample_t;
+
+/*
+ * Rollups of one level that fall whole into one bucket are merged as they
+ * are; the ones cut by a bucket or range edge are made up from the next,
+ * finer level, and below the finest level from the rows themselves.
+ */
+static void
+foldRollups (downsample_t& d, HistorySegment* segment, int level, uint32_t first, uint32_t count) {
+    uint64_t            ns = historyRollupNanos (level);
+    history_aggregate_t rollup;
+    history_row_t       row;
+
+    for (uint32_t slot = first; slot < first + count; slot++) {
+        uint64_t start = (segment->rollupStart (level) + slot) * ns;
+        uint64_t end   = start + ns;
+
+        if (end <= d.from) {
+            continue;
+        }
+        if (start >= d.to) {
+            break;
+        }
+
+        // An unavailable rollup is made up from the finer level or the rows.
+        int state = segment->rollup (level, slot, rollup);
+        if (state == HISTORY_ROLLUP_EMPTY) {
+            continue;
+        }
+
+        if (state == HISTORY_ROLLUP_READY && start >= d.from && end <= d.to && (start - d.from) / d.width == (end - 1 - d.from) / d.width) {
+            historyAggregateMerge (d.out[(start - d.from) / d.width], rollup);
+            d.covered += rollup.count;
+            continue;
+        }
+
+        if (level + 1 < HISTORY_ROLLUP_LEVELS) {
+            uint64_t fine = historyRollupNanos (level + 1);
+            foldRollups (d, segment, level + 1, start / fine - segment->rollupStart (level + 1), ns / fine);
+            continue;
+        }
+
+        const uint64_t* ts   = (const uint64_t*) segment->column (HISTORY_COL_TIMESTAMP);
+        uint32_t        rows = segment->rows ();
+        uint64_t        stop = min (end, d.to);
+
+        for (uint32_t r = segment->lowerBound (max (start, d.from)); r < rows && ts[r] < stop; r++) {
+            segment->read (r, row);
+            historyAggregateAdd (d.out[(row.timestamp - d.from) / d.width], row);
+            d.covered++;
+        }
+    }
+}
+
+/*
+ * Folds buckets consecutive buckets of width ns starting at from into
+ * aggregates, mostly out of the segment rollups, so the cost follows the
+ * number of buckets rather than the number of rows. Returns rows covered.
+ */
+uint64_t
+historyDownsample (MotionHistory& history, uint64_t from, uint64_t width,
+                   uint32_t buckets, history_aggregate_t* out) {
+    const vector<history_segment_info_t>& index = history.segments ();
+    downsample_t d;
+
+    for (uint32_t b = 0; b < buckets; b++) {
+        historyAggregateReset (out[b]);
+    }
+
+    if (buckets == 0 || width == 0) {
+        return 0;
+    }
+
+    d.from    = from;
+    d.to      = from + width * buckets;
+    d.width   = width;
+    d.out     = out;
+    d.covered = 0;
+
+    for (size_t i = 0; i < index.size (); i++) {
+        if (index[i].firstTimestamp >= d.to) {
+            break;
+        }
+
+        if (i + 1 < index.size () && index[i + 1].firstTimestamp <= from) {
+            continue;
+        }
+
+        HistorySegment* segment = history.segment (i);
+        if (segment != NULL) {
+            foldRollups (d, segment, HISTORY_ROLLUP_MINUTE, 0, historyRollupSlots (HISTORY_ROLLUP_MINUTE));
+        }
+    }
+
+    return d.covered;
+}
+
+/* Which field of the aggregates a JSON series holds. */
+#define SERIES_COUNT           0
+#define SERIES_MIN             1
+#define SERIES_MAX             2
+#define SERIES_MEAN            3
+#define SERIES_OK              4
+#define SERIES_REJECTED        5
+#define SERIES_LATENCY_MEAN    6
+#define SERIES_LATENCY_MAX     7
+
+static void
+series (Json::OutputBuffer& out, const char* name, uint32_t buckets, const history_aggregate_t* a, int joint, int what) {
+    char number[REAL_MAX];
+
+    append (out, "\"%s\":[", name);
+    for (uint32_t b = 0; b < buckets; b++) {
+        const char* sep = (b > 0) ? "," : "";
+
+        if (what != SERIES_COUNT && a[b].count == 0) {
+            append (out, "%snull", sep);
+            continue;
+        }
+
+        switch (what) {
+            case SERIES_COUNT: append (out, "%s%u", sep, a[b].count); break;
+            case SERIES_MIN: append (out, "%s%d", sep, a[b].min[joint]); break;
+            case SERIES_MAX: append (out, "%s%d", sep, a[b].max[joint]); break;
+            case SERIES_MEAN: append (out, "%s%s", sep, real (number, (double) a[b].sum[joint] / a[b].count, "%.1f")); break;
+            case SERIES_OK: append (out, "%s%u", sep, a[b].ok); break;
+            case SERIES_REJECTED: append (out, "%s%u", sep, a[b].rejected); break;
+            case SERIES_LATENCY_MEAN: append (out, "%s%s", sep, real (number, (double) a[b].latencySumUs / a[b].count, "%.1f")); break;
+            case SERIES_LATENCY_MAX: append (out, "%s%u", sep, a[b].latencyMaxUs); break;
+        }
+    }
+    put (out, "]");
+}
+
+/* Room the closing of a rows reply takes, "next" included. */
+#define ROWS_TAIL_MAX   64
+
+static void
+buckets (Json::OutputBuffer& out, uint64_t from, uint64_t width,
+         uint32_t count, const history_aggregate_t* aggregates, bool truncated) {
+    append (out, "{\"from\":%llu,\"bucket_ns\":%llu,",
+            (unsigned long long) from, (unsigned long long) width);
+
+    series (out, "count", count, aggregates, 0, SERIES_COUNT);
+    put (out, ",");
+    series (out, "ok", count, aggregates, 0, SERIES_OK);
+    put (out, ",");
+    series (out, "rejected", count, aggregates, 0, SERIES_REJECTED);
+    put (out, ",");
+    series (out, "latency_mean_us", count, aggregates, 0, SERIES_LATENCY_MEAN);
+    put (out, ",");
+    series (out, "latency_max_us", count, aggregates, 0, SERIES_LATENCY_MAX);
+
+    put (out, ",\"joints\":[");
+    for (int joint = 0; joint < 4; joint++) {
+        put (out, (joint > 0) ? ",{" : "{");
+        series (out, "min", count, aggregates, joint, SERIES_MIN);
+        put (out, ",");
+        series (out, "max", count, aggregates, joint, SERIES_MAX);
+        put (out, ",");
+        series (out, "mean", count, aggregates, joint, SERIES_MEAN);
+        put (out, "}");
+    }
+    put (out, "]");
+
+    if (truncated) {
+        append (out, ",\"truncated\":true,\"next\":%llu}", (unsigned long long) (from + width * count));
+    } else {
+        put (out, ",\"truncated\":false}");
+    }
+}
+
+/*
+ * Column oriented so a dashboard can hand each array to a chart as is:
+ * {"from":ns,"bucket_ns":ns,"count":[..],"ok":[..],"rejected":[..],
+ *  "latency_mean_us":[..],"latency_max_us":[..],
+ *  "joints":[{"min":[..],"max":[..],"mean":[..]},..],"truncated":bool}
+ * Empty buckets are null everywhere but count. When all of them take more
+ * than maxBytes only the leading ones that fit are written, and "next" is
+ * where the first one left out starts. Returns buckets written.
+ */
+uint32_t
+historyBucketsToJson (Json::OutputBuffer& out, uint64_t from, uint64_t width,
+                      uint32_t count, const history_aggregate_t* aggregates, size_t maxBytes) {
+    size_t   start = out.size ();
+    uint32_t fit   = count;
+
+    buckets (out, from, width, fit, aggregates, false);
+    while (out.size () - start > maxBytes && fit > 0) {
+        // Scale down by how much it was over, then step to what fits.
+        size_t   written = out.size () - start;
+        uint32_t scaled  = (uint32_t) ((uint64_t) fit * maxBytes / written);
+
+        fit = (scaled < fit) ? scaled : fit - 1;
+        out.truncate (start);
+        buckets (out, from, width, fit, aggregates, true);
+    }
+
+    return fit;
+}
+
+/*
+ * {"rows":[[timestamp,handler,outcome,x,y,z,p,a0,a1,a2,a3,latency_us],..],
+ *  "truncated":bool,"next":ns}, oldest first, at most limit rows and
+ * maxBytes. "next" is only there when truncated and is the timestamp of
+ * the first row left out. Returns rows written.
+ */
+uint64_t
+historyRowsToJson (Json::OutputBuffer& out, MotionHistory& history, uint64_t from, uint64_t to,
+                   uint32_t limit, size_t maxBytes) {
+    const vector<history_segment_info_t>& index = history.segments ();
+    size_t        start     = out.size ();
+    uint64_t      written   = 0;
+    bool          truncated = false;
+    uint64_t      next      = 0;
+    history_row_t row;
+    char          x[REAL_MAX];
+    char          y[REAL_MAX];
+    char          z[REAL_MAX];
+
+    put (out, "{\"rows\":[");
+    for (size_t i = 0; i < index.size () && !truncated; i++) {
+        if (index[i].firstTimestamp >= to) {
+            break;
+        }
+
+        if (i + 1 < index.size () && index[i + 1].firstTimestamp <= from) {
+            continue;
+        }
+
+        HistorySegment* segment = history.segment (i);
+        if (segment == NULL) {
+            continue;
+        }
+
+        const uint64_t* ts = (const uint64_t*) segment->column (HISTORY_COL_TIMESTAMP);
+        uint32_t rows = segment->rows ();
+
+        for (uint32_t r = segment->lowerBound (from); r < rows && ts[r] < to; r++) {
+            if (written == limit) {
+                truncated = true;
+                next      = ts[r];
+                break;
+            }
+
+            size_t before = out.size ();
+            segment->read (r, row);
+            append (out, "%s[%llu,%u,%u,%s,%s,%s,%d,%d,%d,%d,%d,%u]",
+                    (written > 0) ? "," : "", (unsigned long long) row.timestamp,
+                    row.handler, row.outcome, real (x, row.x, "%g"), real (y, row.y, "%g"),
+                    real (z, row.z, "%g"), row.p,
+                    row.angles[0], row.angles[1], row.angles[2], row.angles[3], row.latencyUs);
+
+            if (out.size () - start + ROWS_TAIL_MAX > maxBytes) {
+                out.truncate (before);
+                truncated = true;
+                next      = row.timestamp;
+                break;
+            }
+            written++;
+        }
+    }
+
+    if (truncated) {
+        append (out, "],\"truncated\":true,\"next\":%llu}", (unsigned long long) next);
+    } else {
+        put (out, "],\"truncated\":false}");
+    }
+
+    return written;
+}
+
+/*
+ * The reply to one CONTROL_HISTORY query, at most maxBytes.
+ */
+void
+historyQueryToJson (Json::OutputBuffer& out, MotionHistory& history, history_query_wire_t query, size_t maxBytes) {
+    if (query.to == 0) {
+        query.to = historyNow ();
+    }
+
+    if (query.buckets == 0) {
+        historyRowsToJson (out, history, query.from, query.to, QUERY_MAX_ROWS, maxBytes);
+        return;
+    }
+
+    vector<history_aggregate_t> aggregates (min ((uint32_t) query.buckets, (uint32_t) QUERY_MAX_BUCKETS));
+
+    uint64_t from  = query.from;
+    uint64_t width = historyBucketWidth (from, query.to, aggregates.size ());
+
+    historyDownsample (history, from, width, aggregates.size (), &aggregates[0]);
+    historyBucketsToJson (out, from, width, aggregates.size (), &aggregates[0], maxBytes);
+}
@@ -0,0 +1,261 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <unistd.h>
+#include <cstring>
+
+#include "recorder.h"
+#include "stats.h"
+
+Recorder::Recorder () {
+    for (uint32_t i = 0; i < RECORDING_RING_SIZE; i++) {
+        this->slots[i].sequence = i;
+    }
+
+    this->head    = 0;
+    this->tail    = 0;
+    this->dropped = 0;
+    this->marked  = 0;
+    this->running = false;
+    this->file    = NULL;
+}
+
+Recorder::~Recorder () {
+    this->close ();
+}
+
+bool
+Recorder::open (const char* path) {
+    recording_header_t header = { RECORDING_MAGIC, RECORDING_VERSION, sizeof (command_wire_t) };
+
+    if ((this->file = fopen (path, "wb")) == NULL) {
+        return false;
+    }
+
+    if (fwrite (&header, sizeof (header), 1, this->file) != 1) {
+        fclose (this->file);
+        this->file = NULL;
+        return false;
+    }
+
+    this->running = true;
+    if (pthread_create (&this->thread, NULL, Recorder::writer, this) != 0) {
+        this->running = false;
+        fclose (this->file);
+        this->file = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Stops the writer after it has flushed everything recorded so far.
+ */
+void
+Recorder::close () {
+    if (!this->running) {
+        return;
+    }
+
+    __atomic_store_n (&this->running, false, __ATOMIC_RELEASE);
+    pthread_join (this->thread, NULL);
+
+    fclose (this->file);
+    this->file = NULL;
+}
+
+void
+Recorder::push (const recording_entry_t& entry) {
+    uint32_t pos = __atomic_load_n (&this->head, __ATOMIC_RELAXED);
+    slot_t*  slot;
+
+    if (!this->running) {
+        return;
+    }
+
+    for (;;) {
+        slot = &this->slots[pos & (RECORDING_RING_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n (&this->head, &pos, pos + 1, true,
+                                             __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_fetch_add (&this->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n (&this->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->entry = entry;
+    __atomic_store_n (&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+}
+
+void
+Recorder::command (const command_t& cmd) {
+    recording_entry_t entry;
+
+    entry.type      = RECORDING_COMMAND;
+    entry.source    = cmd.source;
+    entry.width     = 0;
+    entry.timestamp = cmd.receivedAt;
+    commandToWire (cmd, entry.wire);
+
+    this->push (entry);
+}
+
+void
+Recorder::pwm (uint8_t joint, uint16_t width, uint64_t timestamp) {
+    recording_entry_t entry;
+
+    entry.type      = RECORDING_PWM;
+    entry.source    = joint;
+    entry.width     = width;
+    entry.timestamp = timestamp;
+
+    this->push (entry);
+}
+
+uint64_t
+Recorder::getDropped () {
+    return __atomic_load_n (&this->dropped, __ATOMIC_RELAXED);
+}
+
+/*
+ * Writes a loss marker for entries dropped since the last one.
+ */
+void
+Recorder::markLost () {
+    uint64_t dropped = __atomic_load_n (&this->dropped, __ATOMIC_RELAXED);
+    uint8_t  type    = RECORDING_LOST;
+    uint8_t  zero    = 0;
+    uint64_t now     = monotonicNanos ();
+
+    if (dropped == this->marked) {
+        return;
+    }
+
+    uint32_t lost = (dropped - this->marked > UINT32_MAX) ? UINT32_MAX : (uint32_t) (dropped - this->marked);
+    fwrite (&type, 1, 1, this->file);
+    fwrite (&now, sizeof (now), 1, this->file);
+    fwrite (&zero, 1, 1, this->file);
+    fwrite (&lost, sizeof (lost), 1, this->file);
+    this->marked += lost;
+}
+
+/*
+ * Appends every committed entry to the file. Returns false once the ring
+ * is empty.
+ */
+bool
+Recorder::drain () {
+    bool wrote = false;
+
+    if (__atomic_load_n (&this->dropped, __ATOMIC_RELAXED) != this->marked) {
+        this->markLost ();
+        wrote = true;
+    }
+
+    for (;;) {
+        slot_t* slot = &this->slots[this->tail & (RECORDING_RING_SIZE - 1)];
+
+        if ((int32_t)(__atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE) - (this->tail + 1)) < 0) {
+            break;
+        }
+
+        recording_entry_t& e = slot->entry;
+        fwrite (&e.type, 1, 1, this->file);
+        fwrite (&e.timestamp, sizeof (e.timestamp), 1, this->file);
+        fwrite (&e.source, 1, 1, this->file);
+        if (e.type == RECORDING_COMMAND) {
+            fwrite (&e.wire, sizeof (e.wire), 1, this->file);
+        } else {
+            fwrite (&e.width, sizeof (e.width), 1, this->file);
+        }
+
+        __atomic_store_n (&slot->sequence, this->tail + RECORDING_RING_SIZE, __ATOMIC_RELEASE);
+        this->tail++;
+        wrote = true;
+    }
+
+    return wrote;
+}
+
+void*
+Recorder::writer (void* arg) {
+    Recorder* self = (Recorder*) arg;
+
+    while (__atomic_load_n (&self->running, __ATOMIC_ACQUIRE)) {
+        if (self->drain ()) {
+            fflush (self->file);
+        }
+        usleep (RECORDING_FLUSH_MS * 1000);
+    }
+
+    self->drain ();
+    self->markLost ();
+    fflush (self->file);
+
+    return NULL;
+}
+
+RecordingReader::RecordingReader () {
+    this->file = NULL;
+}
+
+RecordingReader::~RecordingReader () {
+    if (this->file != NULL) {
+        fclose (this->file);
+    }
+}
+
+bool
+RecordingReader::open (const char* path) {
+    recording_header_t header;
+
+    if ((this->file = fopen (path, "rb")) == NULL) {
+        return false;
+    }
+
+    if (fread (&header, sizeof (header), 1, this->file) != 1 ||
+        header.magic != RECORDING_MAGIC || header.version < 1 || header.version > RECORDING_VERSION ||
+        header.wireSize != sizeof (command_wire_t)) {
+        fclose (this->file);
+        this->file = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * False at the end of the file, including a torn last entry.
+ */
+bool
+RecordingReader::next (recording_entry_t& entry) {
+    memset (&entry, 0, sizeof (entry));
+
+    if (this->file == NULL ||
+        fread (&entry.type, 1, 1, this->file) != 1 ||
+        fread (&entry.timestamp, sizeof (entry.timestamp), 1, this->file) != 1 ||
+        fread (&entry.source, 1, 1, this->file) != 1) {
+        return false;
+    }
+
+    switch (entry.type) {
+        case RECORDING_COMMAND:
+            return fread (&entry.wire, sizeof (entry.wire), 1, this->file) == 1;
+        case RECORDING_PWM:
+            return fread (&entry.width, sizeof (entry.width), 1, this->file) == 1;
+        case RECORDING_LOST:
+            return fread (&entry.lost, sizeof (entry.lost), 1, this->file) == 1;
+        default:
+            return false;
+    }
+}
@@ -7,6 +7,7 @@
 #include <unistd.h>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <signal.h>
 #include <stdio.h>
 #include <pthread.h>
@@ -24,155 +25,168 @@
 #include "hiredis.h"
 #include "async.h"
 #include "adapters/libevent.h"
-
-#include "mraa.h"
-
-#define PWM_BASE 	    3
-#define PWM_SHOULDER 	5
-#define PWM_ELBOW 	    6
-#define PWM_WHRIST      9
-#define PWM_GRIPPER     4
-
-#define BASE        0
-#define SHOULDER    1
-#define ELBOW       2
-#define WHRIST      3
-#define GRIPPER     4
-
-#define NO  0
-#define YES 1
-
-#define HIGH_PULSE 	0
-#define LOW_PULSE  	1
-
-#define ENABLE 		1
-#define DISABLE  	0
-
-#define PERIOD_WIDTH	19800
-#define MIN_PULSE_WIDTH 600
-#define MAX_PULSE_WIDTH 2200
-
-#define COORDINATE  1
-#define SERVO       2
-
-#define SERVO_SPEED_LOW       0
-#define SERVO_SPEED_MIDDLE    1
-#define SERVO_SPEED_HIGH      2
+#include <event2/buffer.h>
+#include <event2/http.h>
+#include "arm.h"
+#include "command.h"
+#include "history.h"
+#include "log.h"
+#include "metrics.h"
+#include "motion.h"
+#include "profile.h"
+#include "query.h"
+#include "stats.h"
+#include "telemetry.h"
+#include "pwm.h"
+#include "uipc.h"
+
+#define REDIS_TRANSPORT_TCP         0
+#define REDIS_TRANSPORT_UNIX        1
+
+#define REDIS_DEFAULT_HOST          "127.0.0.1"
+#define REDIS_DEFAULT_PORT          6379
+#define REDIS_CONNECT_TIMEOUT_MS    500
+#define REDIS_COMMAND_TIMEOUT_MS    200
+#define REDIS_BACKOFF_MIN_MS        100
+#define REDIS_BACKOFF_MAX_MS        5000
+
+#define IPC_DEFAULT_SOCKET          "/tmp/robe.sock"
+#define METRICS_ADDRESS             "127.0.0.1"
 
 using namespace std;
 
 typedef struct {
-    mraa_pwm_context pwmCtx;
-    int              currentAngle;
-} servo_context_t;
-
-typedef struct {
-    float x;
-    float y;
-    float z;
-    int   p;
-} coordinate_t;
+    int           transport;
+    const char*   host;
+    int           port;
+    const char*   path;
+} redis_config_t;
 
 typedef struct {
-    float tn;
-    float j1;
-    float j2;
-    float j3;
-} arm_angles_t;
-
-typedef struct {
-    float           z_offset;
-    float           coxa;
-    float           fermur;
-    float           tibia;
-    coordinate_t    coord;
-    arm_angles_t    angles;
-    arm_angles_t*   angles_ptr;
-} arm_context_t;
-
-arm_angles_t angleMap[] = {
-    {  95.0, 105.0, 170.0, 140.0 },
-    { 100.0, 120.0, 150.0, 145.0 },
-    { 105.0, 135.0, 115.0, 145.0 },
-    { 130.0, 105.0, 175.0, 135.0 },
-    { 120.0, 120.0, 140.0, 145.0 },
-    { 120.0, 140.0, 105.0, 140.0 },
-    { 155.0, 120.0, 140.0, 150.0 },
-    { 140.0, 130.0, 120.0, 150.0 },
-    { 125.0, 140.0, 105.0, 125.0 },
-
-    {  95.0,  65.0, 165.0, 165.0 },
-    { 100.0,  90.0, 120.0, 165.0 },
-    { 100.0, 120.0,  80.0, 165.0 },
-    { 130.0,  90.0, 120.0, 180.0 },
-    { 120.0, 110.0,  95.0, 180.0 },
-    { 120.0, 110.0,  95.0, 150.0 },
-    { 155.0,  85.0, 125.0, 155.0 },
-    { 140.0,  90.0, 120.0, 150.0 },
-    { 125.0, 120.0,  90.0, 130.0 },
-    
-    { 105.0,  60.0, 125.0, 180.0 },
-    { 105.0,  80.0, 110.0, 165.0 },
-    { 105.0, 100.0,  85.0, 155.0 },
-    { 125.0,  65.0, 120.0, 180.0 },
-    { 125.0,  80.0, 115.0, 170.0 },
-    { 120.0, 105.0,  85.0, 155.0 },
-    { 155.0,  70.0, 125.0, 165.0 },
-    { 135.0, 100.0,  80.0, 180.0 },
-    { 125.0, 120.0,  55.0, 155.0 },
-    
-    {  95.0,   45.0, 135.0, 160.0 },
-    {  95.0,   55.0, 125.0, 150.0 },
-    {  95.0,   85.0, 115.0, 130.0 },
-    { 125.0,   50.0, 115.0, 180.0 },
-    { 120.0,   65.0, 115.0, 155.0 },
-    { 115.0,   90.0,  85.0, 150.0 },
-    { 155.0,   55.0, 120.0, 155.0 },
-    { 140.0,   70.0, 120.0, 140.0 },
-    { 125.0,  100.0,  75.0, 140.0 },
-    
-    {  95.0,   50.0, 120.0, 130.0 },
-    {  95.0,   65.0, 115.0, 120.0 },
-    {  95.0,   90.0,  90.0,  95.0 },
-    { 125.0,   55.0, 105.0, 145.0 },
-    { 120.0,   70.0, 115.0, 120.0 },
-    { 115.0,   85.0, 115.0,  80.0 },
-    { 155.0,   65.0,  90.0, 145.0 },
-    { 140.0,   75.0, 100.0, 115.0 },
-    { 130.0,   90.0, 100.0,  75.0 },
-    
-    {  95.0,   65.0, 105.0,  85.0 },
-    {  95.0,   80.0,  95.0, 110.0 },
-    {   0.0,    0.0,   0.0,   0.0 },
-    { 125.0,   65.0, 105.0,  95.0 },
-    { 120.0,   85.0,  90.0,  90.0 },
-    {   0.0,    0.0,   0.0,   0.0 },
-    { 155.0,   75.0,  90.0, 100.0 },
-    { 145.0,   85.0,  90.0,  90.0 },
-    {   0.0,    0.0,   0.0,   0.0 },
-};
+    int             delayMs;
+    struct timeval  nextAttempt;
+} backoff_t;
 
 void connectCallback(const redisAsyncContext *c, int status);
 void disconnectCallback(const redisAsyncContext *c, int status);
 void * redisSubscriber (void *);
-void setAngle (servo_context_t& ctx, int angle, uint8_t speed);
-void publish (redisContext* ctx, char* buffer);
-void servoMsgFactory (char* buffer, int id, int angle);
-uint8_t calculateAngles (arm_context_t& ctx);
-uint8_t findAnglesMap (arm_context_t& ctx);
-
-arm_context_t    robe;
-servo_context_t  servoCtxList[4];
+void * ipcServer (void *);
+void * metricsServer (void *);
+void ipcControl (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len);
+void logCommand (command_t& cmd);
+void archiveCommand (command_t& cmd, bool done);
+void publishCallback (char* msg, void* priv);
+void subscriberConnect ();
+void subscriberScheduleReconnect ();
+void subscriberReconnectCallback (evutil_socket_t fd, short event, void *arg);
+redisContext* redisOpen (redis_config_t& cfg);
+void backoffReset (backoff_t& b);
+int  backoffNext (backoff_t& b);
+bool backoffReady (backoff_t& b);
+void publish (redisContext*& ctx, char* buffer);
+void publishStats (redisContext*& ctx);
+bool redisAvailable (redisContext*& ctx);
+void redisFailed (redisContext*& ctx, const char* what);
+
+MotionController motion;
+PwmBackend*      pwm         = NULL;
 int              running     = NO;
 redisContext*    redisCtx    = NULL;
 pthread_t        redisSubscriberThread;
+pthread_t        ipcServerThread;
+pthread_t        metricsServerThread;
+CommandRing      commandRing;
+TelemetryRing    telemetryRing;
+TickProfiler     tickProfiler;
+Recorder         recorder;
+MotionHistory    history;
+MotionHistory    historyQueries;    /* read-only view for the IPC thread */
+Json::OutputBuffer historyReply;    /* reused by every history query */
+const char*      ipcSocketPath = IPC_DEFAULT_SOCKET;
+int              ipcMode       = IPC_STREAM;
+const char*      metricsListen = NULL;
+const char*      recordPath    = NULL;
+const char*      historyDir    = NULL;
+
+redis_config_t      redisConfig         = { REDIS_TRANSPORT_TCP, REDIS_DEFAULT_HOST, REDIS_DEFAULT_PORT, NULL };
+backoff_t           publisherBackoff;
+backoff_t           subscriberBackoff;
+struct event_base*  subscriberBase      = NULL;
+struct event*       reconnectEvent      = NULL;
 
 int
 main (int argc, char **argv) {
-    mraa_result_t last_error = MRAA_SUCCESS;
-	redisCtx = redisConnect("127.0.0.1", 6379);
-	if (redisCtx->err) {
-		exit (EXIT_FAILURE);
+    int opt;
+    bool simulated = false;
+
+    while ((opt = getopt (argc, argv, "a:p:s:i:qSTm:R:H:")) != -1) {
+        switch (opt) {
+            case 'a':
+                redisConfig.transport = REDIS_TRANSPORT_TCP;
+                redisConfig.host      = optarg;
+            break;
+            case 'p':
+                redisConfig.transport = REDIS_TRANSPORT_TCP;
+                redisConfig.port      = atoi (optarg);
+            break;
+            case 's':
+                redisConfig.transport = REDIS_TRANSPORT_UNIX;
+                redisConfig.path      = optarg;
+            break;
+            case 'i':
+                ipcSocketPath = optarg;
+            break;
+            case 'q':
+                ipcMode = IPC_SEQPACKET;
+            break;
+            case 'S':
+                simulated = true;
+            break;
+            case 'T':
+                tickProfiler.setTracing (true);
+            break;
+            case 'm':
+                metricsListen = optarg;
+            break;
+            case 'R':
+                recordPath = optarg;
+            break;
+            case 'H':
+                historyDir = optarg;
+            break;
+            default:
+                fprintf (stderr, "Usage: %s [-a address] [-p port] [-s unix_socket] [-i ipc_socket] [-q] [-S] [-T] [-m metrics_port|metrics_socket] [-R recording] [-H history_dir]\n", argv[0]);
+                exit (EXIT_FAILURE);
+        }
+    }
+
+    logStart ();
+    if (recordPath != NULL) {
+        if (!recorder.open (recordPath)) {
+            LOG_ERROR ("Recording to %s failed...", recordPath);
+            exit (EXIT_FAILURE);
+        }
+        LOG_INFO ("Recording to %s...", recordPath);
+    }
+
+    if (historyDir != NULL) {
+        if (!history.open (historyDir, true)) {
+            LOG_ERROR ("Motion history in %s failed...", historyDir);
+            exit (EXIT_FAILURE);
+        }
+        if (!historyQueries.open (historyDir, false)) {
+            LOG_ERROR ("Motion history queries on %s failed...", historyDir);
+            exit (EXIT_FAILURE);
+        }
+        LOG_INFO ("Motion history in %s...", historyDir);
+    }
+    backoffReset (publisherBackoff);
+    backoffReset (subscriberBackoff);
+
+    // A missing Redis is not fatal, publish() keeps retrying with backoff.
+	redisCtx = redisOpen (redisConfig);
+	if (redisCtx == NULL) {
+		backoffNext (publisherBackoff);
 	}
     
     int error = pthread_create (&redisSubscriberThread, NULL, redisSubscriber, NULL);
@@ -180,330 +194,563 @@ main (int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
-    robe.z_offset   = 5;
-    robe.coxa       = 5.5;
-    robe.fermur     = 5.5;
-    robe.tibia      = 8;
+    error = pthread_create (&ipcServerThread, NULL, ipcServer, NULL);
+    if (error) {
+        exit(EXIT_FAILURE);
+    }
 
-    mraa_init();
-	fprintf(stdout, "MRAA Version: %s\n", mraa_get_version());
-    
-    servoCtxList[BASE].pwmCtx           = mraa_pwm_init (PWM_BASE);
-    servoCtxList[BASE].currentAngle     = 90;
-    servoCtxList[SHOULDER].pwmCtx       = mraa_pwm_init (PWM_SHOULDER);
-    servoCtxList[SHOULDER].currentAngle = 50;
-    servoCtxList[ELBOW].pwmCtx          = mraa_pwm_init (PWM_ELBOW);
-    servoCtxList[ELBOW].currentAngle    = 160;
-    servoCtxList[WHRIST].pwmCtx         = mraa_pwm_init (PWM_WHRIST);
-    servoCtxList[WHRIST].currentAngle   = 170;
-
-    mraa_pwm_period_us (servoCtxList[BASE].pwmCtx,     PERIOD_WIDTH);
-	mraa_pwm_period_us (servoCtxList[SHOULDER].pwmCtx, PERIOD_WIDTH);
-    mraa_pwm_period_us (servoCtxList[ELBOW].pwmCtx,    PERIOD_WIDTH);
-    mraa_pwm_period_us (servoCtxList[WHRIST].pwmCtx,   PERIOD_WIDTH);
-    
-    mraa_pwm_enable (servoCtxList[BASE].pwmCtx,     ENABLE);
-	mraa_pwm_enable (servoCtxList[SHOULDER].pwmCtx, ENABLE);
-    mraa_pwm_enable (servoCtxList[ELBOW].pwmCtx,    ENABLE);
-    mraa_pwm_enable (servoCtxList[WHRIST].pwmCtx,   ENABLE);
-    
-    printf("Starting the listener... [SUCCESS]\n");
+    if (metricsListen != NULL) {
+        error = pthread_create (&metricsServerThread, NULL, metricsServer, NULL);
+        if (error) {
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    setAngle (servoCtxList[BASE],      servoCtxList[BASE].currentAngle,     SERVO_SPEED_LOW);
-    setAngle (servoCtxList[SHOULDER],  servoCtxList[SHOULDER].currentAngle, SERVO_SPEED_LOW);
-    setAngle (servoCtxList[ELBOW],     servoCtxList[ELBOW].currentAngle,    SERVO_SPEED_LOW);
-    setAngle (servoCtxList[WHRIST],    servoCtxList[WHRIST].currentAngle,   SERVO_SPEED_LOW);
-	
+#ifdef HAVE_MRAA
+    if (!simulated) {
+        pwm = new MraaPwm ();
+        LOG_INFO ("MRAA Version: %s", mraa_get_version ());
+    }
+#else
+    (void) simulated; /* no hardware backend to skip */
+#endif
+    if (pwm == NULL) {
+        pwm = new SimulatedPwm ();
+    }
+    LOG_INFO ("PWM backend: %s", pwm->name ());
+
+    if (telemetryRing.create () == -1) {
+        LOG_WARN ("Telemetry ring unavailable...");
+    }
+
+    motion.setBackend (pwm);
+    motion.setTelemetry (&telemetryRing);
+    motion.setPublishCallback (publishCallback, NULL);
+    motion.setTickProfiler (&tickProfiler);
+    motion.setRecorder (&recorder);
+    motion.start ();
+
+    LOG_INFO ("Starting the listener... [SUCCESS]");
+
+    // Motion loop, the only consumer of the command ring.
+    uint64_t nextStats = monotonicNanos () + STATS_INTERVAL_MS * 1000000ULL;
 	while (!running) {
-        usleep (10);
+        command_t cmd;
+
+        if (commandRing.wait (STATS_INTERVAL_MS)) {
+            while (commandRing.pop (cmd)) {
+                logCommand (cmd);
+                archiveCommand (cmd, motion.execute (cmd));
+            }
+        }
+
+        if (monotonicNanos () >= nextStats) {
+            publishStats (redisCtx);
+            nextStats = monotonicNanos () + STATS_INTERVAL_MS * 1000000ULL;
+        }
 	}
     
-    redisFree(redisCtx);
+    if (redisCtx != NULL) {
+        redisFree(redisCtx);
+    }
+    recorder.close ();
+    logStop ();
     exit (EXIT_SUCCESS);
 }
 
 void subCallback(redisAsyncContext *c, void *r, void *priv) {
+    uint64_t receivedAt = monotonicNanos ();
     redisReply * reply = (redisReply *)r;
     if (reply == NULL) return;
     if ( reply->type == REDIS_REPLY_ARRAY && reply->elements == 3 ) {
         if ( strcmp( reply->element[0]->str, "subscribe" ) != 0 ) {
-            printf( "Received[%s] channel %s: %s\n", (char*)priv, reply->element[1]->str, reply->element[2]->str );
-			
-			Json::Value root;
-			Json::Reader reader;
-			bool parsingSuccessful = reader.parse( reply->element[2]->str, root );
-			if (!parsingSuccessful) {
-				std::cout  << "Failed to parse configuration\n"
-						   << reader.getFormattedErrorMessages();
-			} else {
-                int handlerId	= root.get("handler", 0).asInt();
-                switch (handlerId) {
-                    case COORDINATE: {
-                        float coordinateX	= root.get("x", 0).asFloat();
-                        float coordinateY	= root.get("y", 0).asFloat();
-                        float coordinateZ	= root.get("z", 0).asFloat();
-                        float coordinateP	= root.get("p", 0).asFloat();
-                        std::cout  	<< "COORDINATE ("
-							<< coordinateX << "," << coordinateY << "," 
-                            << coordinateZ << "," << coordinateP << ")\n";
-
-                        robe.coord.x = coordinateX;
-                        robe.coord.y = coordinateY;
-                        robe.coord.z = coordinateZ;
-                        robe.coord.p = coordinateP;
-
-                        // TODO - Inverse Kinematics
-                        if (findAnglesMap (robe)) {
-                            // std::cout   << "ANGLES ("
-                            // << robe.angles.tn << ", " << robe.angles.j1 << ", " 
-                            // << robe.angles.j2 << ", " << robe.angles.j3 << ")";
-
-                            // angles fix
-                            // robe.angles.tn += 90;
-                            // robe.angles.j1 = 180 - abs(robe.angles.j1);
-                            // robe.angles.j2 = (abs(robe.angles.j2) + 90);
-                            // robe.angles.j3 = (abs(robe.angles.j3) + 90);
-
-                            setAngle (servoCtxList[BASE],     robe.angles_ptr->tn, SERVO_SPEED_LOW);
-                            setAngle (servoCtxList[SHOULDER], robe.angles_ptr->j1, SERVO_SPEED_LOW);
-                            setAngle (servoCtxList[ELBOW],    robe.angles_ptr->j2, SERVO_SPEED_LOW);
-                            setAngle (servoCtxList[WHRIST],   robe.angles_ptr->j3, SERVO_SPEED_LOW);
-                            
-                            char msg[128];
-                            servoMsgFactory (msg, 1, robe.angles_ptr->tn);
-                            publish (redisCtx, msg);
-                            servoMsgFactory (msg, 2, robe.angles_ptr->j1);
-                            publish (redisCtx, msg);
-                            servoMsgFactory (msg, 3, robe.angles_ptr->j2);
-                            publish (redisCtx, msg);
-                            servoMsgFactory (msg, 4, robe.angles_ptr->j3);
-                            publish (redisCtx, msg);
-                        }
+            LOG_DEBUG ("Received[%s] channel %s: %s", (char*)priv, reply->element[1]->str, reply->element[2]->str);
+
+            command_t cmd;
+            if (!commandFromJson (reply->element[2]->str, cmd)) {
+                metricsCount (metrics.parseFailures[COMMAND_SOURCE_REDIS]);
+            } else if (!motionEnqueue (commandRing, cmd, COMMAND_SOURCE_REDIS, receivedAt, &recorder)) {
+                LOG_WARN ("Command ring full, dropping...");
+            }
+        }
+    }
+}
+
+void
+logCommand (command_t& cmd) {
+    switch (cmd.handler) {
+        case COORDINATE:
+            LOG_DEBUG ("COORDINATE (%g,%g,%g,%d)", cmd.x, cmd.y, cmd.z, cmd.p);
+        break;
+        case SERVO:
+            LOG_DEBUG ("SERVO (%d, %d)", cmd.id - 1, cmd.angle);
+        break;
+    }
+}
+
+/*
+ * One history row per executed command, written straight into the mapped
+ * segment.
+ */
+void
+archiveCommand (command_t& cmd, bool done) {
+    history_row_t row;
+
+    if (historyDir == NULL) {
+        return;
+    }
+
+    row.timestamp = 0;
+    row.handler   = cmd.handler;
+    row.outcome   = done ? HISTORY_OK : HISTORY_REJECTED;
+    row.x         = cmd.x;
+    row.y         = cmd.y;
+    row.z         = cmd.z;
+    row.p         = cmd.p;
+    for (int joint = BASE; joint <= WHRIST; joint++) {
+        row.angles[joint] = motion.getAngle (joint);
+    }
+    row.latencyUs = (monotonicNanos () - cmd.receivedAt) / 1000;
+
+    if (!history.append (row)) {
+        LOG_WARN ("Motion history append failed...");
+    }
+}
+
+void
+publishCallback (char* msg, void* priv) {
+    publish (redisCtx, msg);
+}
+
+void
+ipcControl (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len) {
+    switch (data[0]) {
+        case CONTROL_TELEMETRY: {
+            uint32_t size = sizeof (telemetry_shm_t);
+            int      fd   = telemetryRing.getReadOnlyFd ();
+
+            if (fd == -1 || !ipc->sendFd (client, fd, &size, sizeof (size))) {
+                LOG_WARN ("IPC client %d, telemetry handout failed...", client);
+            }
+
+            if (fd != -1) {
+                close (fd);
+            }
+        }
+        break;
+        case CONTROL_STATS: {
+            char json[1024];
+            int  size = statsToJson (json, sizeof (json));
+
+            if (size > 0) {
+                ipc->sendMsg (client, json, size);
+            }
+        }
+        break;
+        case CONTROL_TICKS: {
+            char json[256];
+            char path[256];
+
+            // Optional trace path follows the control byte, not terminated.
+            if (len > 1 && len - 1 < sizeof (path)) {
+                memcpy (path, data + 1, len - 1);
+                path[len - 1] = '\0';
+            } else {
+                strcpy (path, TICK_TRACE_PATH);
+            }
+
+            if (tickProfiler.dumpChromeTrace (path) == -1) {
+                LOG_WARN ("IPC client %d, tick trace to %s failed...", client, path);
+            }
+
+            int size = tickProfiler.toJson (json, sizeof (json));
+            if (size > 0) {
+                ipc->sendMsg (client, json, size);
+            }
+        }
+        break;
+        case CONTROL_HISTORY: {
+            history_query_wire_t query;
+
+            if (historyDir == NULL || len != sizeof (query)) {
+                LOG_WARN ("IPC client %d, bad history query...", client);
+                break;
+            }
+
+            memcpy (&query, data, sizeof (query));
+
+            historyQueries.refresh ();
+            historyReply.clear ();
+            historyQueryToJson (historyReply, historyQueries, query, ipc->maxMessage ());
+
+            // Straight out of the reply's chunks, no joined copy. An empty
+            // reply goes out as an empty frame.
+            vector<struct iovec> parts (historyReply.chunkCount ());
+            struct iovec*        iov = parts.empty () ? NULL : &parts[0];
+            historyReply.toIovec (iov, parts.size ());
+            if (!ipc->sendMsgv (client, iov, parts.size ())) {
+                LOG_WARN ("IPC client %d, history reply of %u bytes failed...", client, (uint32_t) historyReply.size ());
+            }
+        }
+        break;
+        case CONTROL_PROFILE: {
+            profile_control_wire_t request;
+            char                   json[512];
+            char                   path[256];
+
+            if (len < sizeof (request)) {
+                LOG_WARN ("IPC client %d, bad profile request...", client);
+                break;
+            }
+
+            memcpy (&request, data, sizeof (request));
+            switch (request.op) {
+                case PROFILE_OP_START:
+                    profileStart (request.hz);
+                    LOG_INFO ("Profiling started...");
+                break;
+                case PROFILE_OP_STOP:
+                    profileStop ();
+                    LOG_INFO ("Profiling stopped...");
+                break;
+                case PROFILE_OP_DUMP: {
+                    // Optional path follows the header, not terminated.
+                    uint32_t pathLen = len - sizeof (request);
+
+                    if (pathLen > 0 && pathLen < sizeof (path)) {
+                        memcpy (path, data + sizeof (request), pathLen);
+                        path[pathLen] = '\0';
+                    } else {
+                        strcpy (path, PROFILE_PATH);
                     }
-                    break;
-                    case SERVO: {
-                        int servoID	= root.get("id", 0).asInt();
-                        int angle	= root.get("angle", 0).asInt();
-                        
-                        if (servoID > 0) {
-                            std::cout  	<< "SERVO ("
-                                        << servoID - 1 << ", " << angle << ")\n";
-                            setAngle (servoCtxList[servoID - 1], angle, SERVO_SPEED_LOW);
-
-                            char msg[128];
-                            servoMsgFactory (msg, servoID, angle);
-                            publish (redisCtx, msg);
-                        }
+
+                    int stacks = profileDump (path);
+                    if (stacks == -1) {
+                        LOG_WARN ("IPC client %d, profile dump to %s failed...", client, path);
+                    } else {
+                        LOG_INFO ("Profile of %d stacks dumped to %s...", stacks, path);
                     }
-                    break;
-                } 
-			}
+                }
+                break;
+            }
+
+            int size = profileToJson (json, sizeof (json));
+            if (size > 0) {
+                ipc->sendMsg (client, json, size);
+            }
         }
+        break;
+        default:
+            LOG_WARN ("IPC client %d, unknown control 0x%x...", client, data[0]);
+        break;
     }
 }
 
+void
+ipcMessageCallback (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len, void* priv) {
+    uint64_t  receivedAt = monotonicNanos ();
+    command_t cmd;
+
+    if (len > 0 && data[0] >= CONTROL_BASE) {
+        ipcControl (ipc, client, data, len);
+        return;
+    }
+
+    if (!commandFromWire (data, len, cmd)) {
+        metricsCount (metrics.parseFailures[COMMAND_SOURCE_IPC]);
+        LOG_WARN ("IPC client %d sent a bad frame, dropping it...", client);
+        ipc->closeClient (client);
+        return;
+    }
+
+    if (!motionEnqueue (commandRing, cmd, COMMAND_SOURCE_IPC, receivedAt, &recorder)) {
+        LOG_WARN ("Command ring full, dropping...");
+    }
+}
+
+/*
+ * Local command ingress. Clients connect to the Unix socket and send
+ * length-prefixed command_wire_t frames which go straight into the same
+ * command ring as the Redis path, skipping Redis and JSON entirely.
+ */
+void *
+ipcServer (void *) {
+    WiseIPC ipc (ipcSocketPath, ipcMode);
+
+    ipc.setMessageCallback (ipcMessageCallback, NULL);
+    if (ipc.setServer () != SUCCESS) {
+        LOG_ERROR ("IPC server on %s failed...", ipcSocketPath);
+        return NULL;
+    }
+
+    LOG_INFO ("IPC server listening on %s...", ipcSocketPath);
+    while (ipc.poll (-1) != -1);
+
+    return NULL;
+}
+
+void
+metricsRequest (struct evhttp_request* req, void* arg) {
+    metrics_gauges_t    gauges;
+    string              text;
+
+    if (evhttp_request_get_command (req) != EVHTTP_REQ_GET) {
+        evhttp_send_error (req, 405, NULL);
+        return;
+    }
+
+    gauges.queueDepth     = commandRing.depth ();
+    gauges.redisConnected = __atomic_load_n (&redisCtx, __ATOMIC_RELAXED) != NULL;
+    gauges.ticks          = &tickProfiler;
+    metricsToText (text, gauges);
+
+    struct evbuffer* body = evbuffer_new ();
+    evbuffer_add (body, text.data (), text.size ());
+    evhttp_add_header (evhttp_request_get_output_headers (req), "Content-Type", "text/plain; version=0.0.4");
+    evhttp_send_reply (req, HTTP_OK, "OK", body);
+    evbuffer_free (body);
+}
+
+/*
+ * Prometheus scrape endpoint on its own libevent loop so a slow scraper
+ * never touches the subscriber or the motion thread. metricsListen is
+ * either a TCP port on METRICS_ADDRESS or, starting with '/', the path of
+ * a Unix socket.
+ */
+void *
+metricsServer (void *) {
+    struct event_base*  base = event_base_new ();
+    struct evhttp*      http = evhttp_new (base);
+
+    evhttp_set_cb (http, "/metrics", metricsRequest, NULL);
+
+    if (metricsListen[0] == '/') {
+        struct sockaddr_un addr;
+        int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+        memset (&addr, 0, sizeof (addr));
+        addr.sun_family = AF_UNIX;
+        strncpy (addr.sun_path, metricsListen, sizeof (addr.sun_path) - 1);
+        unlink (metricsListen);
+
+        if (fd == -1 || bind (fd, (struct sockaddr*) &addr, sizeof (addr)) == -1 ||
+            listen (fd, SOMAXCONN) == -1 || evutil_make_socket_nonblocking (fd) == -1 ||
+            evhttp_accept_socket (http, fd) == -1) {
+            LOG_ERROR ("Metrics server on %s failed...", metricsListen);
+            return NULL;
+        }
+    } else if (evhttp_bind_socket (http, METRICS_ADDRESS, atoi (metricsListen)) == -1) {
+        LOG_ERROR ("Metrics server on %s:%s failed...", METRICS_ADDRESS, metricsListen);
+        return NULL;
+    }
+
+    LOG_INFO ("Metrics server listening on %s...", metricsListen);
+    event_base_dispatch (base);
+
+    return NULL;
+}
+
+void
+subscriberScheduleReconnect () {
+    struct timeval tv;
+    int delay = backoffNext (subscriberBackoff);
+
+    metricsCount (metrics.redisReconnects[METRICS_SUBSCRIBER]);
+    tv.tv_sec  = delay / 1000;
+    tv.tv_usec = (delay % 1000) * 1000;
+    evtimer_add (reconnectEvent, &tv);
+
+    LOG_INFO ("Reconnecting in %d ms...", delay);
+}
+
 void
 connectCallback(const redisAsyncContext *c, int status) {
     if (status != REDIS_OK) {
+        // hiredis frees the context once this callback returns.
+        LOG_WARN ("Connect failed (%s)...", c->errstr);
+        subscriberScheduleReconnect ();
         return;
     }
-    printf("Connected...\n");
+
+    backoffReset (subscriberBackoff);
+    LOG_INFO ("Connected...");
 }
 
 void
 disconnectCallback(const redisAsyncContext *c, int status) {
-    if (status != REDIS_OK) {
+    LOG_WARN ("Disconnected (%s)...", (status == REDIS_OK) ? "clean" : c->errstr);
+    subscriberScheduleReconnect ();
+}
+
+void
+subscriberConnect () {
+    redisAsyncContext *redisAsyncCtx = NULL;
+
+    if (redisConfig.transport == REDIS_TRANSPORT_UNIX) {
+        redisAsyncCtx = redisAsyncConnectUnix (redisConfig.path);
+    } else {
+        redisAsyncCtx = redisAsyncConnect (redisConfig.host, redisConfig.port);
+    }
+
+    if (redisAsyncCtx == NULL) {
+        subscriberScheduleReconnect ();
         return;
     }
-    printf("Disconnected...\n");
+
+    if (redisAsyncCtx->err) {
+        LOG_WARN ("Connect failed (%s)...", redisAsyncCtx->errstr);
+        redisAsyncFree (redisAsyncCtx);
+        subscriberScheduleReconnect ();
+        return;
+    }
+
+    redisLibeventAttach (redisAsyncCtx, subscriberBase);
+    redisAsyncSetConnectCallback (redisAsyncCtx, connectCallback);
+    redisAsyncSetDisconnectCallback (redisAsyncCtx, disconnectCallback);
+    // Queued until the connection is up, so every reconnect resubscribes.
+    redisAsyncCommand (redisAsyncCtx, subCallback, (char*) "sub", "SUBSCRIBE ROBE-IN");
+}
+
+void
+subscriberReconnectCallback (evutil_socket_t fd, short event, void *arg) {
+    subscriberConnect ();
 }
 
 void *
 redisSubscriber (void *) {
 	signal(SIGPIPE, SIG_IGN);
-    struct event_base *base = event_base_new();
+    subscriberBase = event_base_new();
+    reconnectEvent = evtimer_new (subscriberBase, subscriberReconnectCallback, NULL);
 
-    redisAsyncContext *redisAsyncCtx = redisAsyncConnect ("127.0.0.1", 6379);
-    if (redisAsyncCtx->err) {
+    subscriberConnect ();
+
+    event_base_dispatch (subscriberBase);
+    return NULL;
+}
+
+redisContext*
+redisOpen (redis_config_t& cfg) {
+    redisContext*   ctx = NULL;
+    struct timeval  connectTimeout = { REDIS_CONNECT_TIMEOUT_MS / 1000, (REDIS_CONNECT_TIMEOUT_MS % 1000) * 1000 };
+    struct timeval  commandTimeout = { REDIS_COMMAND_TIMEOUT_MS / 1000, (REDIS_COMMAND_TIMEOUT_MS % 1000) * 1000 };
+
+    if (cfg.transport == REDIS_TRANSPORT_UNIX) {
+        ctx = redisConnectUnixWithTimeout (cfg.path, connectTimeout);
+    } else {
+        ctx = redisConnectWithTimeout (cfg.host, cfg.port, connectTimeout);
+    }
+
+    if (ctx == NULL) {
         return NULL;
     }
 
-    redisLibeventAttach (redisAsyncCtx, base);
-    redisAsyncSetConnectCallback (redisAsyncCtx, connectCallback);
-    redisAsyncSetDisconnectCallback (redisAsyncCtx, disconnectCallback);
-    redisAsyncCommand (redisAsyncCtx, subCallback, (char*) "sub", "SUBSCRIBE ROBE-IN");
+    if (ctx->err || redisSetTimeout (ctx, commandTimeout) != REDIS_OK) {
+        LOG_WARN ("Redis connect failed (%s)...", ctx->errstr);
+        redisFree (ctx);
+        return NULL;
+    }
 
-    event_base_dispatch (base);
+    return ctx;
 }
 
 void
-setAngle (servo_context_t& ctx, int angle, uint8_t speed) {
-	float notches = ((float)(MAX_PULSE_WIDTH - MIN_PULSE_WIDTH) / 180);
-    int16_t width = notches * (float) angle + MIN_PULSE_WIDTH;
-    uint16_t prevWidth = notches * (float) ctx.currentAngle + MIN_PULSE_WIDTH;
-
-    switch (speed) {
-        case SERVO_SPEED_LOW: {
-            // mraa_pwm_pulsewidth_us (ctx.pwmCtx, width);
-            
-            int delta = abs(width - prevWidth);
-            int move = delta / 10;
-            int direction = (width - prevWidth > 0) ? 1 : -1;
-            
-            width = prevWidth;
-            for (int i = 0; i < move; i++) {
-                width += (direction * 10);
-                mraa_pwm_pulsewidth_us (ctx.pwmCtx, width);
-                usleep (5000);
-            }
-            
-            ctx.currentAngle = angle;
-        }
-        break;
-        case SERVO_SPEED_MIDDLE:
-            mraa_pwm_pulsewidth_us (ctx.pwmCtx, width);
-        break;
-        case SERVO_SPEED_HIGH:
-            mraa_pwm_pulsewidth_us (ctx.pwmCtx, width);
-        break;
-        default: { // TODO - Somehow to make the speed work
-            int delta = abs(angle - ctx.currentAngle);
-            int direction = (angle - ctx.currentAngle > 0) ? 1 : -1;
-
-            for (int i = 0; i < delta; i++) {
-                width = notches * (float) (ctx.currentAngle + direction) + MIN_PULSE_WIDTH;
-                mraa_pwm_pulsewidth_us (ctx.pwmCtx, width);
-                ctx.currentAngle += direction;
-                usleep (100000);
-            }
-        }
-        break;
+backoffReset (backoff_t& b) {
+    b.delayMs = 0;
+    timerclear (&b.nextAttempt);
+}
+
+int
+backoffNext (backoff_t& b) {
+    struct timeval now, delay;
+
+    if (b.delayMs == 0) {
+        b.delayMs = REDIS_BACKOFF_MIN_MS;
+    } else if (b.delayMs * 2 < REDIS_BACKOFF_MAX_MS) {
+        b.delayMs *= 2;
+    } else {
+        b.delayMs = REDIS_BACKOFF_MAX_MS;
     }
+
+    gettimeofday (&now, NULL);
+    delay.tv_sec  = b.delayMs / 1000;
+    delay.tv_usec = (b.delayMs % 1000) * 1000;
+    timeradd (&now, &delay, &b.nextAttempt);
+
+    return b.delayMs;
 }
 
-void
-publish (redisContext* ctx, char* buffer) {
-    char message[256];
-    redisReply* reply = NULL;
+bool
+backoffReady (backoff_t& b) {
+    struct timeval now;
 
-    sprintf (message, "PUBLISH MODULE-INFO %s", buffer);
-    reply = (redisReply *)redisCommand (ctx, message);
-    freeReplyObject(reply);
+    gettimeofday (&now, NULL);
+    return !timercmp (&now, &b.nextAttempt, <);
+}
+
+/*
+ * Never stall the motion thread on a dead server, only retry once the
+ * backoff window has passed and let the caller drop its message otherwise.
+ */
+bool
+redisAvailable (redisContext*& ctx) {
+    if (ctx != NULL) {
+        return true;
+    }
 
-    printf ("%s\n", message);
+    if (!backoffReady (publisherBackoff)) {
+        return false;
+    }
+
+    metricsCount (metrics.redisReconnects[METRICS_PUBLISHER]);
+    if ((ctx = redisOpen (redisConfig)) == NULL) {
+        backoffNext (publisherBackoff);
+        return false;
+    }
+
+    backoffReset (publisherBackoff);
+    return true;
 }
 
 void
-servoMsgFactory (char* buffer, int id, int angle) {
-    sprintf (buffer, "{\"type\":\"SERVO\",\"id\":\"%d\",\"angle\":\"%d\"}", id, angle);
+redisFailed (redisContext*& ctx, const char* what) {
+    LOG_WARN ("%s failed (%s)...", what, ctx->errstr);
+    redisFree (ctx);
+    ctx = NULL;
+    backoffNext (publisherBackoff);
 }
 
-uint8_t
-findAnglesMap (arm_context_t& ctx) {
-    int index = ((ctx.coord.z - 1) * 9) + ((ctx.coord.y - 1) * 3) + ctx.coord.x - 1;
-    ctx.angles_ptr = (arm_angles_t*) &angleMap[index];
-    
-    if (ctx.angles_ptr->tn + ctx.angles_ptr->j1 + ctx.angles_ptr->j2 + ctx.angles_ptr->j3 == 0) {
-        return NO;
+void
+publish (redisContext*& ctx, char* buffer) {
+    redisReply* reply = NULL;
+
+    if (!redisAvailable (ctx)) {
+        return;
     }
-    
-    return YES;
+
+    reply = (redisReply *)redisCommand (ctx, "PUBLISH MODULE-INFO %s", buffer);
+    if (reply == NULL) {
+        redisFailed (ctx, "Publish");
+        return;
+    }
+    freeReplyObject(reply);
+
+    LOG_DEBUG ("PUBLISH MODULE-INFO %s", buffer);
 }
 
-uint8_t
-calculateAngles (arm_context_t& ctx) {
-    float a0, a1, a2, a3, a12, aG;
-    float wT, w1, w2, z1, z2, l12;
-    
-    a0 = atan(ctx.coord.y / ctx.coord.x);
-    wT = sqrt(ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
-    
-    aG = -0.785398163;
-    w2 = wT;
-    z2 = ctx.coord.z;
-    
-    l12 = sqrt((w2*w2) + (z2*z2));
-    a12 = atan (z2/w2);
-    
-    std::cout   << "L12 (" << l12 << ") ";
-    /*if (l12 > ctx.coxa + ctx.fermur) {
-        return NO;
-    }*/
-    
-    a1 = acos(((ctx.coxa*ctx.coxa) + (l12*l12) - (ctx.fermur*ctx.fermur)) / (2 * ctx.coxa * l12 )) + a12;
-    
-    w1 = ctx.coxa * cos(a1);
-    z1 = ctx.coxa * sin(a1);
-    a2 = atan ((z2 - z1) / (w2 - w1)) - a1;
-    a3 = aG - a1 - a2;
-    
-    ctx.angles.tn = a0 * 180 / 3.14;
-    ctx.angles.j1 = a1 * 180 / 3.14;
-    ctx.angles.j2 = a2 * 180 / 3.14;
+void
+publishStats (redisContext*& ctx) {
+    redisReply* reply = NULL;
+    char        json[1024];
 
-    /*float a0, a1, a2, a3, a12, aG;
-    float wT, w1, w2, z1, z2, l12;
-    
-    a0 = atan(ctx.coord.y / ctx.coord.x);
-    wT = sqrt(ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
-    
-    aG = -0.785398163;
-    w2 = wT - ctx.tibia * cos(aG);
-    z2 = ctx.coord.z - ctx.tibia * sin(aG);
-    
-    l12 = sqrt((w2*w2) + (z2*z2));
-    a12 = atan (z2/w2);
-    
-    std::cout   << "L12 (" << l12 << ") ";
-    if (l12 > ctx.coxa + ctx.fermur) {
-        return NO;
+    if (statsToJson (json, sizeof (json)) <= 0 || !redisAvailable (ctx)) {
+        return;
     }
-    
-    a1 = acos(((ctx.coxa*ctx.coxa) + (l12*l12) - (ctx.fermur*ctx.fermur)) / (2 * ctx.coxa * l12 )) + a12;
-    
-    w1 = ctx.coxa * cos(a1);
-    z1 = ctx.coxa * sin(a1);
-    a2 = atan ((z2 - z1) / (w2 - w1)) - a1;
-    a3 = aG - a1 - a2;
-    
-    ctx.angles.tn = a0 * 180 / 3.14;
-    ctx.angles.j1 = a1 * 180 / 3.14;
-    ctx.angles.j2 = a2 * 180 / 3.14;
-    ctx.angles.j3 = a3 * 180 / 3.14;*/
-
-    /*float xt    = ctx.coord.x;
-    float l     = sqrt (ctx.coord.x*ctx.coord.x + ctx.coord.y*ctx.coord.y);
-    float c     = 0;
-    float theta = 0;
-    float ang   = 0;
-    float x1    = 0;
-    float z1    = 0;
-    float d     = 0;
-
-    std::cout   << "COORDINATE_T ("
-                        << ctx.coord.x << "," << ctx.coord.y << "," 
-                        << ctx.coord.z << "," << ctx.coord.p << ")\n";
-
-    // tn angle
-    ctx.angles.tn = atan(ctx.coord.y / ctx.coord.x);
-
-    // j2 angle
-    ctx.coord.x = l;
-    ctx.coord.z += ctx.tibia;
-    c = sqrt (ctx.coord.x*ctx.coord.x + ctx.coord.z*ctx.coord.z);
-    ctx.angles.j2 = acos ((ctx.fermur*ctx.fermur + ctx.coxa*ctx.coxa - c*c) / (2 * ctx.fermur * ctx.coxa)) * 180 / 3.14;
-
-    // j1 angle
-    theta = acos ((c*c + ctx.coxa*ctx.coxa - ctx.fermur*ctx.fermur) / (2 * c * ctx.coxa));
-    ang = atan (ctx.coord.z / ctx.coord.x) + theta;
-    ctx.angles.j1 = (atan (ctx.coord.z / ctx.coord.x) + theta) * 180 / 3.14;
-
-    // j3 angle
-    x1 = ctx.coxa * cos (ang);
-    z1 = ctx.coxa * sin (ang);
-    d = sqrt ((ctx.coord.x - x1)*(ctx.coord.x - x1) + (ctx.coord.z - ctx.tibia - z1)*(ctx.coord.z - ctx.tibia - z1));
-    ctx.angles.j3 = acos ((ctx.fermur*ctx.fermur + ctx.tibia*ctx.tibia - d*d) / (2 * ctx.fermur * ctx.tibia)) * 180 / 3.14;
-    ctx.angles.tn = atan(ctx.coord.y / xt) * 180 / 3.14;*/
-
-    return YES;
+
+    reply = (redisReply *)redisCommand (ctx, "SET ROBE-STATS %s", json);
+    if (reply == NULL) {
+        redisFailed (ctx, "Stats");
+        return;
+    }
+    freeReplyObject(reply);
 }
+
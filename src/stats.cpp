@@ -0,0 +1,162 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <stdio.h>
+#include <cstring>
+
+#include "stats.h"
+
+LatencyHistogram latencyStats[STAGE_COUNT];
+
+static const char* stageNames[STAGE_COUNT] = {
+    "parse", "queue", "ik", "first_pwm", "final_pwm", "publish"
+};
+
+LatencyHistogram::LatencyHistogram () {
+    memset (this->buckets, 0, sizeof (this->buckets));
+    this->total      = 0;
+    this->totalValue = 0;
+    this->highest    = 0;
+}
+
+uint32_t
+LatencyHistogram::bucketOf (uint64_t value) {
+    if (value < HISTOGRAM_SUB_COUNT) {
+        return value;
+    }
+
+    uint32_t msb   = 63 - __builtin_clzll (value);
+    uint32_t shift = msb - HISTOGRAM_SUB_BITS;
+    uint32_t sub   = (value >> shift) & (HISTOGRAM_SUB_COUNT - 1);
+
+    return (shift + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+/*
+ * Highest value that lands in the bucket.
+ */
+uint64_t
+LatencyHistogram::bucketValue (uint32_t bucket) {
+    if (bucket < HISTOGRAM_SUB_COUNT) {
+        return bucket;
+    }
+
+    uint32_t shift = bucket / HISTOGRAM_SUB_COUNT - 1;
+    uint64_t sub   = bucket % HISTOGRAM_SUB_COUNT;
+
+    return ((HISTOGRAM_SUB_COUNT + sub) << shift) + ((1ULL << shift) - 1);
+}
+
+void
+LatencyHistogram::record (uint64_t value) {
+    __atomic_fetch_add (&this->buckets[bucketOf (value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&this->total, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&this->totalValue, value, __ATOMIC_RELAXED);
+
+    uint64_t highest = __atomic_load_n (&this->highest, __ATOMIC_RELAXED);
+    while (value > highest &&
+           !__atomic_compare_exchange_n (&this->highest, &highest, value, true,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/*
+ * Not atomic as a whole, only meant for between runs.
+ */
+void
+LatencyHistogram::reset () {
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        __atomic_store_n (&this->buckets[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n (&this->total, 0, __ATOMIC_RELAXED);
+    __atomic_store_n (&this->totalValue, 0, __ATOMIC_RELAXED);
+    __atomic_store_n (&this->highest, 0, __ATOMIC_RELAXED);
+}
+
+uint64_t
+LatencyHistogram::count () {
+    return __atomic_load_n (&this->total, __ATOMIC_RELAXED);
+}
+
+uint64_t
+LatencyHistogram::sum () {
+    return __atomic_load_n (&this->totalValue, __ATOMIC_RELAXED);
+}
+
+uint64_t
+LatencyHistogram::max () {
+    return __atomic_load_n (&this->highest, __ATOMIC_RELAXED);
+}
+
+uint64_t
+LatencyHistogram::percentile (double p) {
+    uint64_t total = this->count ();
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += __atomic_load_n (&this->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            uint64_t value = bucketValue (i);
+            return (value < this->max ()) ? value : this->max ();
+        }
+    }
+
+    return this->max ();
+}
+
+/*
+ * Samples in buckets that end at or below value, i.e. a Prometheus "le"
+ * bucket rounded down to the histogram's resolution.
+ */
+uint64_t
+LatencyHistogram::countAtOrBelow (uint64_t value) {
+    uint64_t seen = 0;
+
+    for (uint32_t i = 0; i < HISTOGRAM_BUCKETS && bucketValue (i) <= value; i++) {
+        seen += __atomic_load_n (&this->buckets[i], __ATOMIC_RELAXED);
+    }
+
+    return seen;
+}
+
+const char*
+stageName (int stage) {
+    return stageNames[stage];
+}
+
+/*
+ * {"parse":{"count":N,"p50":ns,"p99":ns,"p999":ns,"max":ns},...}
+ */
+int
+statsToJson (char* buffer, size_t size) {
+    size_t offset = 0;
+
+    offset += snprintf (buffer + offset, size - offset, "{");
+    for (int stage = 0; stage < STAGE_COUNT && offset < size; stage++) {
+        LatencyHistogram& h = latencyStats[stage];
+
+        offset += snprintf (buffer + offset, size - offset,
+                            "%s\"%s\":{\"count\":%llu,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+                            (stage > 0) ? "," : "", stageNames[stage],
+                            (unsigned long long) h.count (),
+                            (unsigned long long) h.percentile (50.0),
+                            (unsigned long long) h.percentile (99.0),
+                            (unsigned long long) h.percentile (99.9),
+                            (unsigned long long) h.max ());
+    }
+
+    if (offset < size) {
+        offset += snprintf (buffer + offset, size - offset, "}");
+    }
+
+    return (offset < size) ? (int) offset : -1;
+}
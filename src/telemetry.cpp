@@ -0,0 +1,225 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "telemetry.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC         0x0001U
+#define MFD_ALLOW_SEALING   0x0002U
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS         (1024 + 9)
+#define F_SEAL_SHRINK       0x0002
+#define F_SEAL_GROW         0x0004
+#endif
+
+/*
+ * memfd when the kernel has it, otherwise an unlinked POSIX shared memory
+ * object. Either way the only handle to the memory is the descriptor.
+ */
+static int
+createSharedMemory (size_t size) {
+    int fd = -1;
+
+#ifdef __NR_memfd_create
+    fd = syscall (__NR_memfd_create, "robe-telemetry", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+
+    if (fd == -1) {
+        char name[64];
+        snprintf (name, sizeof (name), "/robe-telemetry-%d", getpid ());
+
+        fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd == -1) {
+            return -1;
+        }
+        shm_unlink (name);
+    }
+
+    if (ftruncate (fd, size) == -1) {
+        close (fd);
+        return -1;
+    }
+
+    // Readers must never see the mapping shrink under them (SIGBUS).
+    fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW);
+
+    return fd;
+}
+
+TelemetryRing::TelemetryRing () {
+    this->fd  = -1;
+    this->shm = NULL;
+}
+
+TelemetryRing::~TelemetryRing () {
+    if (this->shm != NULL) {
+        munmap (this->shm, sizeof (telemetry_shm_t));
+    }
+
+    if (this->fd != -1) {
+        close (this->fd);
+    }
+}
+
+int
+TelemetryRing::create () {
+    if ((this->fd = createSharedMemory (sizeof (telemetry_shm_t))) == -1) {
+        return -1;
+    }
+
+    void* mem = mmap (NULL, sizeof (telemetry_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+    if (mem == MAP_FAILED) {
+        close (this->fd);
+        this->fd = -1;
+        return -1;
+    }
+
+    this->shm = (telemetry_shm_t*) mem;
+    memset (this->shm, 0, sizeof (telemetry_shm_t));
+    this->shm->version      = TELEMETRY_VERSION;
+    this->shm->recordSize   = sizeof (telemetry_record_t);
+    this->shm->slotCount    = TELEMETRY_RING_SIZE;
+    __atomic_store_n (&this->shm->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void
+TelemetryRing::publish (telemetry_record_t& record) {
+    if (this->shm == NULL) {
+        return;
+    }
+
+    uint64_t            index = this->shm->head;
+    telemetry_slot_t*   slot  = &this->shm->slots[index & (TELEMETRY_RING_SIZE - 1)];
+    uint32_t            seq   = slot->sequence;
+
+    record.index = index;
+
+    __atomic_store_n (&slot->sequence, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    slot->record = record;
+    __atomic_store_n (&slot->sequence, seq + 2, __ATOMIC_RELEASE);
+    __atomic_store_n (&this->shm->head, index + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Readers get their own read-only descriptor to the same memory, so a
+ * misbehaving consumer cannot scribble over the ring.
+ */
+int
+TelemetryRing::getReadOnlyFd () {
+    char path[64];
+
+    if (this->fd == -1) {
+        return -1;
+    }
+
+    snprintf (path, sizeof (path), "/proc/self/fd/%d", this->fd);
+    return open (path, O_RDONLY | O_CLOEXEC);
+}
+
+TelemetryReader::TelemetryReader () {
+    this->shm    = NULL;
+    this->cursor = 0;
+}
+
+TelemetryReader::~TelemetryReader () {
+    if (this->shm != NULL) {
+        munmap ((void*) this->shm, sizeof (telemetry_shm_t));
+    }
+}
+
+bool
+TelemetryReader::attach (int fd) {
+    struct stat st;
+
+    if (fstat (fd, &st) == -1 || (size_t) st.st_size < sizeof (telemetry_shm_t)) {
+        return false;
+    }
+
+    void* mem = mmap (NULL, sizeof (telemetry_shm_t), PROT_READ, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    const telemetry_shm_t* shm = (const telemetry_shm_t*) mem;
+    if (__atomic_load_n (&shm->magic, __ATOMIC_ACQUIRE) != TELEMETRY_MAGIC ||
+        shm->version != TELEMETRY_VERSION ||
+        shm->recordSize != sizeof (telemetry_record_t) ||
+        shm->slotCount != TELEMETRY_RING_SIZE) {
+        munmap (mem, sizeof (telemetry_shm_t));
+        return false;
+    }
+
+    this->shm    = shm;
+    this->cursor = this->head ();
+
+    return true;
+}
+
+uint64_t
+TelemetryReader::head () {
+    return __atomic_load_n (&this->shm->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t
+TelemetryReader::next () {
+    return this->cursor;
+}
+
+void
+TelemetryReader::seek (uint64_t index) {
+    this->cursor = index;
+}
+
+int
+TelemetryReader::read (telemetry_record_t& record) {
+    uint64_t head = this->head ();
+
+    if (this->cursor >= head) {
+        return TELEMETRY_EMPTY;
+    }
+
+    if (head - this->cursor > TELEMETRY_RING_SIZE) {
+        this->cursor = head - TELEMETRY_RING_SIZE;
+        return TELEMETRY_LOST;
+    }
+
+    const telemetry_slot_t* slot = &this->shm->slots[this->cursor & (TELEMETRY_RING_SIZE - 1)];
+    for (;;) {
+        uint32_t before = __atomic_load_n (&slot->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            continue; /* writer is in the middle of this slot */
+        }
+
+        memcpy (&record, (const void*) &slot->record, sizeof (record));
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n (&slot->sequence, __ATOMIC_RELAXED) == before) {
+            break;
+        }
+    }
+
+    if (record.index != this->cursor) {
+        // Lapped by the writer while we were looking at the slot.
+        this->cursor = this->head () - TELEMETRY_RING_SIZE;
+        return TELEMETRY_LOST;
+    }
+
+    this->cursor++;
+    return TELEMETRY_OK;
+}
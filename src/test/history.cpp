@@ -0,0 +1,319 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Regression checks for the motion history store. Prints each failure and
+ * exits non-zero when there was one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <cstring>
+#include <string>
+
+#include "json/json.h"
+#include "command.h"
+#include "history.h"
+#include "query.h"
+#include "uipc.h"
+
+using namespace std;
+
+#define MINUTE_NS   HISTORY_ROLLUP_NS
+#define BASE_NS     (1400000040ULL * 1000000000ULL)     /* on a minute boundary */
+
+static int failures = 0;
+
+static void
+check (bool ok, const char* what) {
+    if (!ok) {
+        fprintf (stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static string
+tempDir () {
+    char dir[] = "/tmp/robe-history-XXXXXX";
+
+    if (mkdtemp (dir) == NULL) {
+        perror ("mkdtemp");
+        exit (EXIT_FAILURE);
+    }
+    return dir;
+}
+
+static void
+removeDir (const string& dir) {
+    string command = "rm -rf " + dir;
+
+    if (system (command.c_str ()) != 0) {
+        fprintf (stderr, "could not remove %s\n", dir.c_str ());
+    }
+}
+
+static void
+appendRows (MotionHistory& history, uint64_t from, uint32_t count, uint64_t step) {
+    history_row_t row;
+
+    for (uint32_t i = 0; i < count; i++) {
+        memset (&row, 0, sizeof (row));
+        row.timestamp = from + i * step;
+        row.angles[0] = i % 180;
+        history.append (row);
+    }
+}
+
+/*
+ * Leaves the first minute rollup of the only segment in dir as a writer
+ * that died mid-update would.
+ */
+static bool
+tearRollup (const string& dir) {
+    MotionHistory history;
+
+    if (!history.open (dir, false) || history.segments ().empty ()) {
+        return false;
+    }
+
+    int fd = open (history.segments ()[0].path.c_str (), O_RDWR);
+    struct stat st;
+    if (fd == -1 || fstat (fd, &st) == -1) {
+        return false;
+    }
+
+    void* mem = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    history_header_t* header  = (history_header_t*) mem;
+    history_rollup_t* rollups = (history_rollup_t*) ((unsigned char*) mem + header->rollupOffsets[HISTORY_ROLLUP_MINUTE]);
+    rollups[0].sequence |= 1;
+    rollups[0].aggregate.count += 1000;     /* half-applied garbage */
+    munmap (mem, st.st_size);
+
+    return true;
+}
+
+static uint64_t
+downsample (MotionHistory& history, history_aggregate_t* buckets) {
+    return historyDownsample (history, BASE_NS, MINUTE_NS, 3, buckets);
+}
+
+/*
+ * A torn rollup must neither hang a reader nor leak into the result, and
+ * the next writer has to repair it.
+ */
+static void
+testTornRollup () {
+    string              dir = tempDir ();
+    history_aggregate_t clean[3];
+    history_aggregate_t torn[3];
+
+    {
+        MotionHistory writer;
+        check (writer.open (dir, true), "writer opens");
+        appendRows (writer, BASE_NS, 180, 1000000000ULL);
+    }
+
+    {
+        MotionHistory reader;
+        reader.open (dir, false);
+        check (downsample (reader, clean) == 180, "all rows covered before tearing");
+    }
+
+    check (tearRollup (dir), "rollup torn");
+
+    {
+        MotionHistory reader;
+        reader.open (dir, false);
+        history_aggregate_t rollup;
+        check (reader.segment (0)->rollup (HISTORY_ROLLUP_MINUTE, 0, rollup) == HISTORY_ROLLUP_UNAVAILABLE,
+               "torn rollup reported unavailable");
+        check (downsample (reader, torn) == 180, "torn minute made up from finer data");
+        check (memcmp (clean, torn, sizeof (clean)) == 0, "same buckets with a torn rollup");
+    }
+
+    {
+        MotionHistory writer;
+        check (writer.open (dir, true), "writer reopens");
+        history_aggregate_t rollup;
+        check (writer.segment (0)->rollup (HISTORY_ROLLUP_MINUTE, 0, rollup) == HISTORY_ROLLUP_READY &&
+               rollup.count == 60, "writer repaired the rollup from the rows");
+    }
+
+    removeDir (dir);
+}
+
+/*
+ * A wall clock that went backwards across a restart must not put the new
+ * segment before the old ones.
+ */
+static void
+testClockBackwards () {
+    string dir = tempDir ();
+
+    {
+        MotionHistory writer;
+        writer.open (dir, true);
+        appendRows (writer, BASE_NS, 10, 1000000000ULL);
+    }
+
+    {
+        // The old segment is too old to append to, so this rotates.
+        MotionHistory writer;
+        writer.open (dir, true);
+        history_row_t row;
+        memset (&row, 0, sizeof (row));
+        row.timestamp = BASE_NS - 10 * MINUTE_NS;
+        check (writer.append (row), "append after the clock stepped back");
+        check (row.timestamp == BASE_NS + 9 * 1000000000ULL, "timestamp clamped to the newest segment");
+    }
+
+    MotionHistory reader;
+    reader.open (dir, false);
+    const vector<history_segment_info_t>& segments = reader.segments ();
+    check (segments.size () == 2, "second segment created");
+    for (size_t i = 1; i < segments.size (); i++) {
+        check (segments[i - 1].firstTimestamp < segments[i].firstTimestamp, "segments stay sorted");
+    }
+
+    removeDir (dir);
+}
+
+typedef struct {
+    WiseIPC*        server;
+    MotionHistory*  history;
+    volatile bool   stop;
+} history_server_t;
+
+/* What robe does with a CONTROL_HISTORY frame. */
+static void
+queryCallback (WiseIPC* ipc, int client, const unsigned char* data, uint32_t len, void* priv) {
+    history_server_t*    server = (history_server_t*) priv;
+    history_query_wire_t query;
+    Json::OutputBuffer   reply;
+
+    if (len != sizeof (query)) {
+        return;
+    }
+    memcpy (&query, data, sizeof (query));
+
+    historyQueryToJson (reply, *server->history, query, ipc->maxMessage ());
+    vector<struct iovec> parts (reply.chunkCount ());
+    reply.toIovec (&parts[0], parts.size ());
+    ipc->sendMsgv (client, &parts[0], parts.size ());
+}
+
+static void *
+queryServer (void* arg) {
+    history_server_t* server = (history_server_t*) arg;
+
+    while (!server->stop) {
+        server->server->poll (10);
+    }
+
+    return NULL;
+}
+
+static bool
+query (WiseIPC& client, uint16_t buckets, uint64_t from, uint64_t to, Json::Value& reply) {
+    history_query_wire_t  wire;
+    vector<unsigned char> msg;
+    Json::Reader          reader;
+
+    memset (&wire, 0, sizeof (wire));
+    wire.control = CONTROL_HISTORY;
+    wire.buckets = buckets;
+    wire.from    = from;
+    wire.to      = to;
+
+    if (!client.sendMsg (&wire, sizeof (wire)) || client.readMsg (msg) <= 0) {
+        return false;
+    }
+
+    const char* text = (const char*) &msg[0];
+    return reader.parse (text, text + msg.size (), reply, false);
+}
+
+/*
+ * History replies over SEQPACKET have to fit one packet; the rest is one
+ * "next" away.
+ */
+static void
+testSeqpacketQuery () {
+    string           dir = tempDir ();
+    char             path[64];
+    MotionHistory    writer;
+    MotionHistory    history;
+    history_server_t server;
+    pthread_t        thread;
+    Json::Value      reply;
+
+    writer.open (dir, true);
+    appendRows (writer, BASE_NS, 2000, 1000000000ULL);
+    history.open (dir, false);
+
+    snprintf (path, sizeof (path), "/tmp/robe-history-%d.sock", getpid ());
+    WiseIPC ipc (path, IPC_SEQPACKET);
+    WiseIPC client (path, IPC_SEQPACKET);
+
+    server.server  = &ipc;
+    server.history = &history;
+    server.stop    = false;
+    ipc.setMessageCallback (queryCallback, &server);
+    check (ipc.setServer () == SUCCESS, "seqpacket server up");
+    pthread_create (&thread, NULL, queryServer, &server);
+    check (client.setClient () == 0, "seqpacket client connected");
+
+    uint64_t end  = BASE_NS + 2000 * 1000000000ULL;
+    uint64_t from = BASE_NS;
+    uint64_t rows = 0;
+    int      replies;
+    for (replies = 0; replies < 100; replies++) {
+        if (!query (client, 0, from, end, reply)) {
+            check (false, "rows reply over seqpacket");
+            break;
+        }
+        for (Json::ArrayIndex i = 0; i < reply["rows"].size (); i++) {
+            check (reply["rows"][i][0].asUInt64 () == BASE_NS + rows * 1000000000ULL, "rows continue at next");
+            rows++;
+        }
+        if (!reply["truncated"].asBool ()) {
+            break;
+        }
+        from = reply["next"].asUInt64 ();
+    }
+    check (replies > 0, "rows reply truncated to a packet");
+    check (rows == 2000, "every row reached through next");
+
+    check (query (client, QUERY_MAX_BUCKETS, BASE_NS, end, reply), "buckets reply over seqpacket");
+    uint32_t fit = reply["count"].size ();
+    check (reply["truncated"].asBool () && fit > 0 && fit < QUERY_MAX_BUCKETS, "buckets cut to a packet");
+    check (reply["next"].asUInt64 () == reply["from"].asUInt64 () + fit * reply["bucket_ns"].asUInt64 (),
+           "buckets continue at next");
+    check (reply["joints"][3]["mean"].size () == fit, "every series cut alike");
+
+    server.stop = true;
+    pthread_join (thread, NULL);
+    unlink (path);
+    removeDir (dir);
+}
+
+int
+main () {
+    testTornRollup ();
+    testClockBackwards ();
+    testSeqpacketQuery ();
+
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,737 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+/*
+ * Regression checks for the bundled jsoncpp. Prints each failure and exits
+ * non-zero when there was one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+#include "command.h"
+
+using namespace std;
+
+static int failures = 0;
+
+/* Every operator new in the process, for the checks that nothing allocates. */
+static volatile unsigned long allocations = 0;
+
+void*
+operator new (size_t size) {
+    __atomic_fetch_add (&allocations, 1, __ATOMIC_RELAXED);
+    void* memory = malloc (size ? size : 1);
+    if (memory == NULL) {
+        throw std::bad_alloc ();
+    }
+    return memory;
+}
+
+void
+operator delete (void* memory) {
+    free (memory);
+}
+
+#if __cplusplus >= 201402L
+void
+operator delete (void* memory, size_t) {
+    free (memory);
+}
+#endif
+
+static void
+check (bool ok, const char* what) {
+    if (!ok) {
+        fprintf (stderr, "FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+/*
+ * Members read out of order get inserted into the middle of a FlatMap,
+ * which shifts the ones after them; their comments have to move along.
+ */
+static void
+testCommentsOutOfOrder () {
+    const char*  text = "{\"b\":2, // about b\n"
+                        "\"c\":3, // about c\n"
+                        "\"a\":1 // about a\n"
+                        "}";
+    Json::Reader reader;
+    Json::Value  root;
+
+    check (reader.parse (text, root), "commented document parses");
+
+    string out = Json::StyledWriter ().write (root);
+    check (out.find ("about a") != string::npos, "comment on a survives");
+    check (out.find ("about b") != string::npos, "comment on b survives");
+    check (out.find ("about c") != string::npos, "comment on c survives");
+
+    Json::Value copy = root["b"];
+    check (copy.hasComment (Json::commentAfterOnSameLine), "copy keeps the comment");
+}
+
+/*
+ * A comment set on a null value stays when the value becomes an array.
+ */
+static void
+testCommentOnPromotion () {
+    Json::Value value;
+
+    value.setComment ("// list", Json::commentBefore);
+    value[0u] = 1;
+    check (value.hasComment (Json::commentBefore), "comment kept when null becomes an array");
+}
+
+/*
+ * The shortest digits that read back, and of those the closest: the last
+ * digit must not drift once the fraction runs past ten digits.
+ */
+static void
+testClosestDouble () {
+    Json::FastWriter writer;
+
+    check (writer.write (Json::Value (0.1 + 0.2)) == "0.30000000000000004\n", "0.1 + 0.2 closest digits");
+    check (writer.write (Json::Value (0.1)) == "0.1\n", "0.1 shortest digits");
+    check (writer.write (Json::Value (1e-7)) == "1e-07\n", "1e-7 shortest digits");
+}
+
+/*
+ * Truncating back into an earlier chunk keeps what came before it and
+ * writes on from there.
+ */
+static void
+testOutputTruncate () {
+    Json::OutputBuffer out;
+    string             text;
+
+    for (int i = 0; i < 3000; i++) {
+        text += (char) ('a' + i % 26);
+    }
+    out.append (text.data (), text.size ());
+    out.append (text.data (), text.size ());
+    check (out.chunkCount () > 1, "output spans chunks");
+
+    out.truncate (5000);
+    check (out.size () == 5000 && out.toString () == (text + text).substr (0, 5000), "truncated across chunks");
+    out.append ("end", 3);
+    check (out.toString () == (text + text).substr (0, 5000) + "end", "append after truncate");
+
+    out.truncate (4096);
+    check (out.toString () == (text + text).substr (0, 4096), "truncated at a chunk edge");
+    out.append ('!');
+    check (out.toString () == (text + text).substr (0, 4096) + "!", "append after edge truncate");
+
+    out.truncate (0);
+    check (out.empty () && out.chunkCount () == 0, "truncated to nothing");
+}
+
+/* The document reads text in place, so text has to outlive it. */
+static bool
+lazyParses (Json::LazyDocument& doc, const char* text, size_t length) {
+    return doc.parse (text, text + length);
+}
+
+static bool
+lazyParses (Json::LazyDocument& doc, const char* text) {
+    return lazyParses (doc, text, strlen (text));
+}
+
+/*
+ * Every proper prefix of a document is truncated, and structure, numbers
+ * and anything past the root are checked, not just skipped.
+ */
+static void
+testLazyRejects () {
+    const char*        whole = "{\"a\":[1,-2.5e3,\"x\\\"y\",true,false,null],\"b\":{\"c\":{}}}";
+    const char*        bad[] = {
+        "", "   ", "{", "[1,]", "[,1]", "{\"a\":}", "{\"a\" 1}", "{\"a\":1,}", "{a:1}",
+        "{\"a\":1]", "[1}", "01", "1.", "-", "1e", "+1", ".5", "tru", "nul", "True",
+        "\"abc", "\"\\\"", "[1] 2", "{} x", "// comment\n1", "1 /* c */", "[\"a\" \"b\"]",
+    };
+    Json::LazyDocument doc;
+
+    check (lazyParses (doc, whole), "whole document parses");
+    for (size_t length = 0; length < strlen (whole); length++) {
+        if (lazyParses (doc, whole, length)) {
+            fprintf (stderr, "  prefix of %u bytes\n", (unsigned) length);
+            check (false, "truncated document rejected");
+        }
+    }
+
+    for (size_t i = 0; i < sizeof (bad) / sizeof (bad[0]); i++) {
+        if (lazyParses (doc, bad[i])) {
+            fprintf (stderr, "  %s\n", bad[i]);
+            check (false, "malformed document rejected");
+        }
+    }
+    check (!doc.getFormattedErrorMessages ().empty (), "rejection explained");
+
+    check (lazyParses (doc, "[1]") && doc.getFormattedErrorMessages ().empty (), "document reused after an error");
+}
+
+/*
+ * Escapes are decoded when the value is read, in values and member names.
+ */
+static void
+testLazyEscapes () {
+    Json::LazyDocument doc;
+
+    check (lazyParses (doc, "{\"s\":\"a\\\"b\\\\c\\/d\\u00e9\\n\\ud83d\\ude00\",\"k\\u0065y\":7,\"plain\":\"p\"}"),
+           "escaped document parses");
+
+    Json::LazyValue root = doc.root ();
+    check (root["s"].asString () == "a\"b\\c/d\xc3\xa9\n\xf0\x9f\x98\x80", "escapes decoded");
+    check (root["key"].asInt () == 7, "escaped member name found");
+    check (root["plain"].asString () == "p", "plain string read as is");
+    check (root.toValue ()["s"] == root["s"].asString (), "toValue decodes escapes too");
+}
+
+/*
+ * A member or element that is not there reads as null, at any depth.
+ */
+static void
+testLazyMissing () {
+    Json::LazyDocument doc;
+
+    check (lazyParses (doc, "{\"a\":{\"b\":[1,2]},\"n\":null}"), "document parses");
+
+    Json::LazyValue root = doc.root ();
+    check (root["nope"].isNull () && root["nope"].type () == Json::nullValue, "missing member is null");
+    check (!root.isMember ("nope") && root.isMember ("n"), "isMember tells missing from null");
+    check (root["nope"].asInt () == 0 && root["nope"].asString () == "" && !root["nope"].asBool (),
+           "missing member converts like null");
+    check (root["a"]["x"]["y"].isNull (), "missing below missing is null");
+    check (root["a"]["b"][2u].isNull () && root["a"]["b"][1u].asInt () == 2, "element past the end is null");
+    check (root["a"]["b"]["b"].isNull () && root["a"][0u].isNull (), "wrong container kind is null");
+    check (root["nope"].size () == 0 && root["nope"].toValue ().isNull (), "missing member is empty");
+    check (Json::LazyDocument ().root ().isNull (), "unparsed document is null");
+}
+
+/*
+ * get() the way commandFromJson uses it on robe's commands.
+ */
+static void
+testLazyCommandDefaults () {
+    Json::LazyDocument doc;
+    command_t          cmd;
+
+    check (lazyParses (doc, "{\"handler\":1,\"x\":2.5,\"y\":-3}"), "coordinate parses");
+    Json::LazyValue root = doc.root ();
+    check (root.get ("handler", 0).asInt () == 1, "handler read");
+    check (root.get ("x", 0).asFloat () == 2.5f && root.get ("y", 0).asFloat () == -3.0f, "coordinates read");
+    check (root.get ("z", 0).asFloat () == 0.0f && root.get ("p", 0).asFloat () == 0.0f, "missing coordinates default");
+    check (root.get ("z", 9).asInt () == 9 && root.get ("z", "d").asString () == "d", "default returned as given");
+
+    check (commandFromJson ("{\"handler\":2,\"id\":3,\"angle\":120}", cmd) &&
+           cmd.handler == 2 && cmd.id == 3 && cmd.angle == 120, "servo command decoded");
+    check (commandFromJson ("{\"handler\":1,\"x\":2,\"y\":3,\"z\":4}", cmd) &&
+           cmd.x == 2 && cmd.y == 3 && cmd.z == 4 && cmd.p == 0, "coordinate command without p");
+    check (commandFromJson ("{\"handler\":2}", cmd) && cmd.id == 0 && cmd.angle == 0, "servo command without fields");
+    check (!commandFromJson ("{\"id\":3}", cmd), "command without handler rejected");
+    check (!commandFromJson ("{\"handler\":2,", cmd), "truncated command rejected");
+}
+
+/*
+ * Writes every event down and builds the Value they describe.
+ */
+class RecordingHandler : public Json::ReaderHandler {
+    public:
+        string      events;
+        Json::Value root;
+
+        bool onStartObject () { events += "{"; return open (Json::Value (Json::objectValue)); }
+        bool onKey (const char* begin, const char* end) {
+            key.assign (begin, end);
+            events += "k:" + key + ";";
+            return true;
+        }
+        bool onEndObject () { events += "}"; path.pop_back (); return true; }
+        bool onStartArray () { events += "["; return open (Json::Value (Json::arrayValue)); }
+        bool onEndArray () { events += "]"; path.pop_back (); return true; }
+        bool onString (const char* begin, const char* end) {
+            events += "s:" + string (begin, end) + ";";
+            return add (Json::Value (begin, end));
+        }
+        bool onInt (Json::LargestInt value) { return number ("i", Json::Value (value)); }
+        bool onUInt (Json::LargestUInt value) { return number ("u", Json::Value (value)); }
+        bool onReal (double value) { return number ("r", Json::Value (value)); }
+        bool onBool (bool value) { events += value ? "true;" : "false;"; return add (Json::Value (value)); }
+        bool onNull () { events += "null;"; return add (Json::Value ()); }
+
+    private:
+        bool number (const char* kind, const Json::Value& value) {
+            events += kind + value.toStyledString ();
+            return add (value);
+        }
+
+        Json::Value& slot () {
+            if (path.empty ()) {
+                return root;
+            }
+            Json::Value& parent = *path.back ();
+            return parent.isArray () ? parent[parent.size ()] : parent[key];
+        }
+
+        bool add (const Json::Value& value) {
+            slot () = value;
+            return true;
+        }
+
+        bool open (const Json::Value& container) {
+            Json::Value& value = slot ();
+            value = container;
+            path.push_back (&value);
+            return true;
+        }
+
+        vector<Json::Value*> path;
+        string               key;
+};
+
+/* Feeds text in pieces cut at the given offsets. */
+static bool
+feedSplit (Json::EventReader& reader, const string& text, const size_t* cuts, int count) {
+    size_t start = 0;
+
+    for (int i = 0; i <= count; i++) {
+        size_t end = (i < count) ? cuts[i] : text.size ();
+        if (!reader.feed (text.data () + start, text.data () + end)) {
+            return false;
+        }
+        start = end;
+    }
+
+    return reader.finish ();
+}
+
+/*
+ * Any way the input is cut, strings, escapes, numbers, literals and
+ * comments included, the events are the same, and they describe what
+ * Reader reads.
+ */
+static void
+testEventSplits () {
+    const string text = "// leading comment\n"
+                        "{\"name\": \"a\\\"b\\\\c\\u00e9\\ud83d\\ude00\\n\",\n"
+                        " \"ints\": [0, -1, 42, 9223372036854775807, -9223372036854775808, 18446744073709551615],\n"
+                        " /* block\n comment */ \"reals\": [-2.5e-3, 1E+10, 0.125, 3.0],\n"
+                        " \"flags\": [true, false, null],   // trailing\n"
+                        " \"nested\": {\"\\u0041\": [[], {}, [{\"x\": \"\"}]]}}\n";
+    Json::Reader     reader;
+    Json::Value      expected;
+    RecordingHandler whole;
+    Json::EventReader wholeReader (whole);
+
+    check (reader.parse (text, expected), "Reader parses the document");
+    check (feedSplit (wholeReader, text, NULL, 0), "document read in one piece");
+    check (whole.root == expected, "events describe what Reader reads");
+
+    bool sameOnce  = true;
+    bool sameTwice = true;
+    bool sameBytes = true;
+    for (size_t cut = 0; cut <= text.size (); cut++) {
+        RecordingHandler  handler;
+        Json::EventReader split (handler);
+
+        if (!feedSplit (split, text, &cut, 1) || handler.events != whole.events) {
+            fprintf (stderr, "  split at %u\n", (unsigned) cut);
+            sameOnce = false;
+        }
+    }
+    for (size_t first = 0; first <= text.size (); first += 7) {
+        for (size_t second = first; second <= text.size (); second++) {
+            RecordingHandler  handler;
+            Json::EventReader split (handler);
+            size_t            cuts[2] = { first, second };
+
+            if (!feedSplit (split, text, cuts, 2) || handler.events != whole.events) {
+                sameTwice = false;
+            }
+        }
+    }
+    {
+        RecordingHandler  handler;
+        Json::EventReader split (handler);
+        vector<size_t>    cuts;
+
+        for (size_t cut = 1; cut < text.size (); cut++) {
+            cuts.push_back (cut);
+        }
+        sameBytes = feedSplit (split, text, &cuts[0], cuts.size ()) && handler.events == whole.events &&
+                    handler.root == expected;
+    }
+    check (sameOnce, "same events split at every offset");
+    check (sameTwice, "same events split at two offsets");
+    check (sameBytes, "same events fed a byte at a time");
+}
+
+/* "* Line L, Column C" of a formatted error. */
+static string
+errorLocation (const string& message) {
+    return message.substr (0, message.find ('\n'));
+}
+
+/*
+ * Invalid input fails where Reader says it does, wherever it was cut.
+ */
+static void
+testEventErrors () {
+    const char* bad[] = {
+        "{\n  \"a\": [1, 2,, 3]\n}",
+        "[1, \"abc\\q\"]",
+        "{\"a\" 1}",
+        "[1, 2}",
+        "[tru]",
+        "{\"a\": [1, 2]\n\n  \"b\": 3}",
+        "[\"\\ud800x\"]",
+    };
+
+    for (size_t i = 0; i < sizeof (bad) / sizeof (bad[0]); i++) {
+        string       text = bad[i];
+        Json::Reader reader;
+        Json::Value  value;
+
+        check (!reader.parse (text, value), "Reader rejects the input");
+        string expected = errorLocation (reader.getFormattedErrorMessages ());
+
+        bool same = true;
+        for (size_t cut = 0; cut <= text.size (); cut++) {
+            RecordingHandler  handler;
+            Json::EventReader split (handler);
+
+            if (feedSplit (split, text, &cut, 1) || errorLocation (split.getFormattedErrorMessages ()) != expected) {
+                fprintf (stderr, "  %s split at %u: %s\n", bad[i], (unsigned) cut,
+                         split.getFormattedErrorMessages ().c_str ());
+                same = false;
+                break;
+            }
+        }
+        check (same, "error located like Reader at every split");
+    }
+
+    // Unlike Reader, a second document is an error.
+    string text = "[1]\n [2]";
+    bool   same = true;
+    for (size_t cut = 0; cut <= text.size (); cut++) {
+        RecordingHandler  handler;
+        Json::EventReader split (handler);
+
+        if (feedSplit (split, text, &cut, 1) || errorLocation (split.getFormattedErrorMessages ()) != "* Line 2, Column 2") {
+            same = false;
+        }
+    }
+    check (same, "data after the document rejected at every split");
+}
+
+/* A size class nothing else in this test allocates from. */
+#define POOL_TEST_SIZE  900
+#define POOL_THREADS    4
+#define POOL_BLOCKS     500
+
+typedef struct {
+    vector<void*>           blocks;
+    Json::ValueAllocator*   pool;
+    void*                   kept;
+} pool_job_t;
+
+static void*
+releaseBlocks (void* arg) {
+    pool_job_t* job = (pool_job_t*) arg;
+
+    for (size_t i = 0; i < job->blocks.size (); i++) {
+        Json::ValueAllocator::releaseBlock (job->blocks[i]);
+    }
+
+    return NULL;
+}
+
+/*
+ * Blocks freed by other threads go on the owner's remote list and come back
+ * to the owner, every one exactly once, when its free list runs dry.
+ */
+static void
+testPoolRemoteFree () {
+    Json::ValueAllocatorScope scope (Json::ValueAllocator::threadPool ());
+    pool_job_t                jobs[POOL_THREADS];
+    pthread_t                 threads[POOL_THREADS];
+    vector<void*>             freed;
+
+    for (int t = 0; t < POOL_THREADS; t++) {
+        for (int i = 0; i < POOL_BLOCKS; i++) {
+            jobs[t].blocks.push_back (Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE));
+            freed.push_back (jobs[t].blocks.back ());
+        }
+    }
+    for (int t = 0; t < POOL_THREADS; t++) {
+        pthread_create (&threads[t], NULL, releaseBlocks, &jobs[t]);
+    }
+    for (int t = 0; t < POOL_THREADS; t++) {
+        pthread_join (threads[t], NULL);
+    }
+
+    vector<void*> again;
+    for (size_t i = 0; i < freed.size (); i++) {
+        again.push_back (Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE));
+    }
+    sort (freed.begin (), freed.end ());
+    sort (again.begin (), again.end ());
+    check (again == freed, "remotely freed blocks drained back to the owner");
+
+    for (size_t i = 0; i < again.size (); i++) {
+        Json::ValueAllocator::releaseBlock (again[i]);
+    }
+}
+
+static void*
+useAndExit (void* arg) {
+    pool_job_t* job = (pool_job_t*) arg;
+
+    job->pool = Json::ValueAllocator::threadPool ();
+    Json::ValueAllocatorScope scope (job->pool);
+    job->blocks.push_back (Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE));
+    job->kept = Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE);
+    Json::ValueAllocator::releaseBlock (job->blocks.back ());
+
+    return NULL;
+}
+
+static void*
+adopt (void* arg) {
+    pool_job_t* job = (pool_job_t*) arg;
+
+    job->pool = Json::ValueAllocator::threadPool ();
+    Json::ValueAllocatorScope scope (job->pool);
+    job->blocks.push_back (Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE));
+    job->blocks.push_back (Json::ValueAllocator::allocateBlock (POOL_TEST_SIZE));
+
+    return NULL;
+}
+
+/*
+ * The pool of a thread that exits, with a block still out, goes to the
+ * next thread, along with what was freed into it before and after.
+ */
+static void
+testPoolOrphan () {
+    pool_job_t first;
+    pool_job_t next;
+    pthread_t  thread;
+
+    pthread_create (&thread, NULL, useAndExit, &first);
+    pthread_join (thread, NULL);
+
+    // Freed while no thread owns the pool.
+    Json::ValueAllocator::releaseBlock (first.kept);
+
+    pthread_create (&thread, NULL, adopt, &next);
+    pthread_join (thread, NULL);
+
+    check (next.pool == first.pool, "exited thread's pool adopted");
+    sort (next.blocks.begin (), next.blocks.end ());
+    vector<void*> expected;
+    expected.push_back (first.blocks[0]);
+    expected.push_back (first.kept);
+    sort (expected.begin (), expected.end ());
+    check (next.blocks == expected, "adopted pool serves its freed blocks");
+
+    for (size_t i = 0; i < next.blocks.size (); i++) {
+        Json::ValueAllocator::releaseBlock (next.blocks[i]);
+    }
+}
+
+static const char* arenaDocument =
+    "{\"handler\":1,\"samples\":[1.5,2.5,3.5,4.5],\"a long member name past interning limits, surely\":"
+    "{\"text\":\"a string long enough to need its own block of storage\",\"list\":[[1],[2,3],{\"x\":null}]}}";
+
+/*
+ * A document parsed into an arena is the same as one on the heap, and
+ * reset() takes all of it back without walking it.
+ */
+static void
+testArenaDocument () {
+    Json::ValueArena arena (1024);
+    Json::Reader     reader;
+    Json::Value      heap;
+    size_t           used = 0;
+
+    check (reader.parse (arenaDocument, heap), "heap document parses");
+    for (int round = 0; round < 3; round++) {
+        {
+            Json::ValueAllocatorScope scope (&arena);
+            Json::Value&              doc = *arena.newValue ();
+
+            check (reader.parse (arenaDocument, doc), "arena document parses");
+            check (doc == heap, "arena document equals heap document");
+            doc["samples"].append (5.5);
+            check (doc["samples"].size () == 5, "arena document grows");
+        }
+        check (arena.used () > 0, "arena used");
+        check (round == 0 || arena.used () == used, "same use every round");
+        used = arena.used ();
+        arena.reset ();
+        check (arena.used () == 0, "reset empties the arena");
+    }
+}
+
+/*
+ * Values from the system allocator, the thread pool and an arena in one
+ * tree, edited and torn down outside any scope: every block goes back to
+ * where it came from.
+ */
+static void
+testMixedAllocators () {
+    Json::ValueArena arena;
+    Json::Value      root (Json::objectValue);
+    string           text (200, 't');
+
+    root["system"] = text;
+    {
+        Json::ValueAllocatorScope scope (&arena);
+        Json::Value               branch (Json::objectValue);
+
+        branch["text"] = text;
+        branch["list"].append (text);
+        root["arena"].swap (branch);
+    }
+    {
+        Json::ValueAllocatorScope scope (Json::ValueAllocator::threadPool ());
+        Json::Value               branch (Json::arrayValue);
+
+        branch.append (text);
+        root["pool"].swap (branch);
+    }
+
+    // Grown and overwritten with the system allocator current again.
+    for (int i = 0; i < 20; i++) {
+        root["arena"]["list"].append (i);
+        root["pool"].append (text);
+    }
+    root["arena"]["text"] = "short";
+    root["system"]        = root["arena"];
+
+    check (root["arena"]["list"].size () == 21 && root["arena"]["list"][0u] == text, "arena branch edited");
+    check (root["pool"].size () == 21 && root["pool"][20u] == text, "pool branch edited");
+    check (root["system"] == root["arena"], "copied across allocators");
+
+    Json::Value copy = root;
+    root = Json::Value ();
+    check (copy["system"]["text"] == "short", "copy outlives the original");
+}
+
+/*
+ * With one slot every path collides: a hit allocates nothing, a different
+ * path evicts it, and coming back compiles it again. Results stay right
+ * throughout.
+ */
+static void
+testPathCacheCollision () {
+    Json::Reader    reader;
+    Json::Value     root;
+    Json::PathCache cache (1);
+
+    check (reader.parse ("{\"arm\":{\"joints\":[10,20,30]},\"name\":\"robe\"}", root), "path document parses");
+
+    unsigned long before = allocations;
+    check (cache.get (".arm.joints[1]").resolve (root).asInt () == 20, "first lookup");
+    check (allocations != before, "miss compiles");
+
+    before = allocations;
+    check (cache.get (".arm.joints[1]").resolve (root).asInt () == 20, "second lookup");
+    check (allocations == before, "hit allocates nothing");
+
+    before = allocations;
+    check (cache.get (".name").resolve (root).asString () == "robe", "colliding lookup");
+    check (allocations != before, "colliding path evicts");
+
+    before = allocations;
+    check (cache.get (".arm.joints[1]").resolve (root).asInt () == 20, "lookup after eviction");
+    check (allocations != before, "evicted path compiled again");
+
+    Json::PathCache roomy;
+    roomy.get (".arm.joints[2]");
+    before = allocations;
+    check (roomy.get (".arm.joints[2]").resolve (root).asInt () == 30 && allocations == before,
+           "hit in a larger cache allocates nothing");
+}
+
+/*
+ * A % needs an argument of its kind; without one the path finds nothing,
+ * and the cache has no way to pass one.
+ */
+static void
+testPathArguments () {
+    Json::Reader    reader;
+    Json::Value     root;
+    Json::PathCache cache;
+
+    check (reader.parse ("{\"a\":{\"b\":[1,2]}}", root), "path document parses");
+
+    check (Json::Path (".a.%[%]", "b", 1u).resolve (root).asInt () == 2, "% arguments resolve");
+    check (Json::Path (".a.%").find (root) == 0, "missing key argument rejected");
+    check (Json::Path (".a.b[%]").find (root) == 0, "missing index argument rejected");
+    check (Json::Path (".a.%", 0u).find (root) == 0, "index for a key rejected");
+    check (Json::Path (".a.b[%]", "b").find (root) == 0, "key for an index rejected");
+    check (Json::Path (".a.b[1").find (root) == 0, "unclosed bracket rejected");
+    check (cache.get (".a.%").find (root) == 0, "cached % key rejected");
+    check (cache.get (".a.b[%]").find (root) == 0, "cached % index rejected");
+    check (cache.get (".a.%").resolve (root, 7).asInt () == 7, "rejected path gives the default");
+}
+
+/*
+ * find() is 0, and resolve() null, for anything not there.
+ */
+static void
+testPathMissing () {
+    Json::Reader reader;
+    Json::Value  root;
+
+    check (reader.parse ("{\"a\":{\"b\":[1,2]},\"s\":\"text\",\"n\":null}", root), "path document parses");
+
+    check (Json::Path (".").find (root) == &root, "root path finds the root");
+    check (Json::Path (".n").find (root) != 0 && Json::Path (".n").find (root)->isNull (), "null member found");
+    check (Json::Path (".x").find (root) == 0, "missing key");
+    check (Json::Path (".a.x.y").find (root) == 0, "missing key below a missing key");
+    check (Json::Path (".a.b[2]").find (root) == 0, "index past the end");
+    check (Json::Path (".a.b[4294967295]").find (root) == 0, "largest index");
+    check (Json::Path (".a[0]").find (root) == 0, "index into an object");
+    check (Json::Path (".a.b.c").find (root) == 0, "key into an array");
+    check (Json::Path (".s.c").find (root) == 0 && Json::Path (".s[0]").find (root) == 0, "into a string");
+    check (Json::Path (".n.c").find (root) == 0 && Json::Path (".n[0]").find (root) == 0, "into null");
+    check (Json::Path (".a.b[5]").resolve (root).isNull (), "resolve of a missing path is null");
+}
+
+int
+main () {
+    testCommentsOutOfOrder ();
+    testCommentOnPromotion ();
+    testClosestDouble ();
+    testOutputTruncate ();
+    testLazyRejects ();
+    testLazyEscapes ();
+    testLazyMissing ();
+    testLazyCommandDefaults ();
+    testEventSplits ();
+    testEventErrors ();
+    if (Json::ValueAllocator::threadPool () != Json::ValueAllocator::system ()) {
+        testPoolRemoteFree ();
+        testPoolOrphan ();
+    }
+    testArenaDocument ();
+    testMixedAllocators ();
+    testPathCacheCollision ();
+    testPathArguments ();
+    testPathMissing ();
+
+    return (failures == 0) ? 0 : 1;
+}
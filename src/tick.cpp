@@ -0,0 +1,159 @@
+/*
+ * Author: Yevgeniy Kiveisha <yevgeniy.kiveisha@intel.com>
+ * Copyright (c) 2014 Intel Corporation.
+ */
+
+#include <stdio.h>
+#include <cstring>
+#include <vector>
+
+#include "tick.h"
+
+using namespace std;
+
+static const char* jointNames[] = { "base", "shoulder", "elbow", "whrist" };
+
+TickProfiler::TickProfiler () {
+    this->ticks      = 0;
+    this->misses     = 0;
+    this->deadlineNs = TICK_DEADLINE_US * 1000ULL;
+    this->tracing    = false;
+    this->head       = 0;
+}
+
+void
+TickProfiler::setDeadline (int us) {
+    this->deadlineNs = us * 1000ULL;
+}
+
+void
+TickProfiler::setTracing (bool enabled) {
+    this->tracing = enabled;
+}
+
+void
+TickProfiler::trace (const tick_trace_t& event) {
+    uint64_t head = this->head;
+
+    this->events[head & (TICK_TRACE_SIZE - 1)] = event;
+    __atomic_store_n (&this->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void
+TickProfiler::tick (uint8_t joint, uint16_t width, uint64_t scheduled, uint64_t actual) {
+    uint64_t late = (actual > scheduled) ? actual - scheduled : 0;
+
+    this->jitter.record (late);
+    __atomic_store_n (&this->ticks, this->ticks + 1, __ATOMIC_RELAXED);
+    if (late > this->deadlineNs) {
+        __atomic_store_n (&this->misses, this->misses + 1, __ATOMIC_RELAXED);
+    }
+
+    if (this->tracing) {
+        tick_trace_t event = { scheduled, actual, width, joint, TICK_EVENT_STEP };
+        this->trace (event);
+    }
+}
+
+void
+TickProfiler::command (uint8_t handler, uint64_t start, uint64_t end) {
+    if (this->tracing) {
+        tick_trace_t event = { start, end, handler, 0, TICK_EVENT_COMMAND };
+        this->trace (event);
+    }
+}
+
+uint64_t
+TickProfiler::getTicks () {
+    return __atomic_load_n (&this->ticks, __ATOMIC_RELAXED);
+}
+
+uint64_t
+TickProfiler::getMisses () {
+    return __atomic_load_n (&this->misses, __ATOMIC_RELAXED);
+}
+
+LatencyHistogram&
+TickProfiler::getJitter () {
+    return this->jitter;
+}
+
+/*
+ * {"ticks":N,"misses":N,"deadline_us":N,"p50":ns,"p99":ns,"p999":ns,"max":ns}
+ */
+int
+TickProfiler::toJson (char* buffer, size_t size) {
+    int len = snprintf (buffer, size,
+                        "{\"ticks\":%llu,\"misses\":%llu,\"deadline_us\":%llu,"
+                        "\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+                        (unsigned long long) this->getTicks (),
+                        (unsigned long long) this->getMisses (),
+                        (unsigned long long) this->deadlineNs / 1000,
+                        (unsigned long long) this->jitter.percentile (50.0),
+                        (unsigned long long) this->jitter.percentile (99.0),
+                        (unsigned long long) this->jitter.percentile (99.9),
+                        (unsigned long long) this->jitter.max ());
+
+    return (len > 0 && (size_t) len < size) ? len : -1;
+}
+
+/*
+ * Chrome trace-event JSON: one track per joint with a slice from when each
+ * step was due to when it ran (so late steps stand out as wide slices), an
+ * instant event per deadline miss and a "motion" track with a slice per
+ * command. Returns the number of events written or -1.
+ */
+int
+TickProfiler::dumpChromeTrace (const char* path) {
+    vector<tick_trace_t> copy (TICK_TRACE_SIZE);
+    uint64_t             end   = __atomic_load_n (&this->head, __ATOMIC_ACQUIRE);
+    uint64_t             start = (end > TICK_TRACE_SIZE) ? end - TICK_TRACE_SIZE : 0;
+
+    for (uint64_t i = start; i < end; i++) {
+        copy[i - start] = this->events[i & (TICK_TRACE_SIZE - 1)];
+    }
+
+    // Anything the motion thread lapped while we copied may be torn.
+    uint64_t after = __atomic_load_n (&this->head, __ATOMIC_ACQUIRE);
+    uint64_t first = (after > TICK_TRACE_SIZE && after - TICK_TRACE_SIZE > start) ? after - TICK_TRACE_SIZE : start;
+
+    FILE* file = fopen (path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+
+    fprintf (file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf (file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"robe\"}}");
+    fprintf (file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":100,\"args\":{\"name\":\"motion\"}}");
+    for (int joint = 0; joint < 4; joint++) {
+        fprintf (file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                 joint, jointNames[joint]);
+    }
+
+    int written = 0;
+    for (uint64_t i = first; i < end; i++) {
+        const tick_trace_t& e = copy[i - start];
+        double ts  = e.scheduled / 1000.0;
+        double dur = (e.actual > e.scheduled) ? (e.actual - e.scheduled) / 1000.0 : 0;
+
+        if (e.type == TICK_EVENT_COMMAND) {
+            fprintf (file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":100,\"ts\":%.3f,\"dur\":%.3f}",
+                     (e.value == 1) ? "COORDINATE" : "SERVO", ts, dur);
+        } else {
+            fprintf (file, ",\n{\"name\":\"step\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                           "\"args\":{\"width\":%u,\"late_us\":%.3f}}",
+                     e.joint, ts, dur, e.value, dur);
+            if (e.actual - e.scheduled > this->deadlineNs && e.actual > e.scheduled) {
+                fprintf (file, ",\n{\"name\":\"deadline miss\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                         e.joint, e.actual / 1000.0);
+                written++;
+            }
+        }
+        written++;
+    }
+
+    fprintf (file, "\n]}\n");
+    fclose (file);
+
+    return written;
+}
@@ -3,62 +3,894 @@
  * Copyright (c) 2014 Intel Corporation.
  */
 
+#include <errno.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <limits.h>
 #include <iostream>
+#include <cstring>
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #include "uipc.h"
 
+#define IPC_READ_BUDGET     (64 * 1024)     /* per client per wakeup */
+#define IPC_MAX_PENDING     (1024 * 1024)   /* unsent bytes per client */
+
 using namespace std;
 
-WiseIPC::WiseIPC (string socket_path) {
-    this->socketPath = socket_path;
+static ssize_t
+sendIov (int fd, struct iovec* iov, int count) {
+    struct msghdr msg;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = count;
+
+    return sendmsg (fd, &msg, MSG_NOSIGNAL);
+}
+
+/*
+ * Blocking write of the whole iovec chain, resuming after partial writes.
+ */
+static bool
+sendAll (int fd, struct iovec* iov, int count) {
+    int index = 0;
+
+    while (index < count) {
+        ssize_t written = sendIov (fd, &iov[index], (count - index < IOV_MAX) ? count - index : IOV_MAX);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        while (index < count && (size_t) written >= iov[index].iov_len) {
+            written -= iov[index].iov_len;
+            index++;
+        }
+
+        if (index < count) {
+            iov[index].iov_base = (unsigned char*) iov[index].iov_base + written;
+            iov[index].iov_len -= written;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * Send up to count packets with as few sendmmsg calls as possible. Returns
+ * the number of packets the kernel took (which is short of count only for
+ * a non-blocking socket that filled up) or -1 when nothing could be sent.
+ */
+static int
+sendPackets (int fd, const struct iovec* msgs, int count) {
+    struct mmsghdr hdrs[IPC_BATCH];
+    int sent = 0;
+
+    while (sent < count) {
+        int batch = (count - sent < IPC_BATCH) ? count - sent : IPC_BATCH;
+
+        memset (hdrs, 0, sizeof (hdrs[0]) * batch);
+        for (int i = 0; i < batch; i++) {
+            hdrs[i].msg_hdr.msg_iov    = (struct iovec*) &msgs[sent + i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int written = sendmmsg (fd, hdrs, batch, MSG_NOSIGNAL);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            return (sent > 0) ? sent : -1;
+        }
+
+        sent += written;
+    }
+
+    return sent;
+}
+
+/*
+ * recv() that also picks up a descriptor passed with SCM_RIGHTS. Any
+ * descriptor is closed when the caller did not ask for one.
+ */
+static ssize_t
+recvWithFd (int sock, void* data, size_t len, int* fd) {
+    struct msghdr   msg;
+    struct iovec    iov;
+    union {
+        struct cmsghdr  align;
+        char            buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    iov.iov_base = data;
+    iov.iov_len  = len;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+
+    ssize_t count = recvmsg (sock, &msg, MSG_CMSG_CLOEXEC);
+    if (count <= 0) {
+        return count;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int received;
+            memcpy (&received, CMSG_DATA(cmsg), sizeof (received));
+
+            if (fd != NULL && *fd == -1) {
+                *fd = received;
+            } else {
+                close (received);
+            }
+        }
+    }
+
+    return count;
+}
+
+static int
+setNonBlocking (int fd) {
+    int flags = fcntl (fd, F_GETFL, 0);
+    if (flags == -1) {
+        return -1;
+    }
+
+    return fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static bool
+readFull (int fd, unsigned char* data, size_t len) {
+    size_t offset = 0;
+
+    while (offset < len) {
+        ssize_t count = read (fd, data + offset, len - offset);
+        if (count == 0) {
+            return false;
+        }
+
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        offset += count;
+    }
+
+    return true;
+}
+
+WiseIPC::WiseIPC (string socket_path, int mode) {
+    this->socketPath    = socket_path;
+    this->mode          = mode;
+    this->fd_sock       = -1;
+    this->fd_epoll      = -1;
+    this->onMessage     = NULL;
+    this->onConnect     = NULL;
+    this->onDisconnect  = NULL;
+    this->priv          = NULL;
 }
 
 WiseIPC::~WiseIPC () {
+    while (!this->clients.empty ()) {
+        this->closeClient (this->clients.begin()->first);
+    }
+
+    if (this->fd_epoll != -1) {
+        close (this->fd_epoll);
+    }
+
     if (this->fd_sock != -1) {
         close (this->fd_sock);
     }
 }
 
-void 
-WiseIPC::setBuffer (unsigned char * buff) {
-    this->buff = buff;
+void
+WiseIPC::setMessageCallback (ipc_message_callback_t callback, void* priv) {
+    this->onMessage = callback;
+    this->priv      = priv;
+}
+
+void
+WiseIPC::setClientCallbacks (ipc_client_callback_t onConnect, ipc_client_callback_t onDisconnect) {
+    this->onConnect     = onConnect;
+    this->onDisconnect  = onDisconnect;
 }
 
 int
-WiseIPC::listenIPC () {
-    int client = -1;
+WiseIPC::poll (int timeoutMs) {
+    struct epoll_event events[IPC_MAX_EVENTS];
 
-    if ( (client = accept(this->fd_sock, NULL, NULL)) == -1) {
-        return -1;
+    int count = epoll_wait (this->fd_epoll, events, IPC_MAX_EVENTS, timeoutMs);
+    if (count == -1) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == this->fd_sock) {
+            this->acceptClients ();
+            continue;
+        }
+
+        // The client may have been closed by a callback earlier in this batch.
+        map<int, client_t*>::iterator it = this->clients.find (fd);
+        if (it == this->clients.end ()) {
+            continue;
+        }
+
+        client_t* client = it->second;
+        bool      alive  = true;
+
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            alive = this->readClient (client);
+        }
+
+        if (alive && (events[i].events & EPOLLOUT)) {
+            if (this->clients.find (fd) == this->clients.end ()) {
+                continue;
+            }
+            alive = this->flushClient (client);
+        }
+
+        if (!alive) {
+            this->closeClient (fd);
+        }
     }
 
-    return client;
+    return count;
 }
 
+int
+WiseIPC::acceptClients () {
+    int accepted = 0;
+
+    for (;;) {
+        int fd = accept (this->fd_sock, NULL, NULL);
+        if (fd == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (setNonBlocking (fd) == -1) {
+            close (fd);
+            continue;
+        }
+
+        client_t* client = new client_t;
+        client->fd      = fd;
+        client->rlen    = 0;
+        client->wpos    = 0;
+        client->writing = false;
+        if (this->mode == IPC_STREAM) {
+            client->rbuf.resize (IPC_READ_CHUNK);
+        }
+
+        struct epoll_event ev;
+        ev.events  = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl (this->fd_epoll, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            close (fd);
+            delete client;
+            continue;
+        }
+
+        this->clients[fd] = client;
+        accepted++;
+
+        if (this->onConnect != NULL) {
+            this->onConnect (this, fd, this->priv);
+        }
+    }
+
+    return accepted;
+}
+
+/*
+ * Drain what the socket has (up to IPC_READ_BUDGET so one chatty client
+ * cannot starve the rest) and dispatch every complete frame. Returns false
+ * when the client has to be dropped.
+ */
 bool
-WiseIPC::sendMsg (unsigned int len) {
-    if (this->fd_sock == -1) {
+WiseIPC::readClient (client_t* client) {
+    if (this->mode == IPC_SEQPACKET) {
+        return this->readPackets (client);
+    }
+
+    int     fd      = client->fd;
+    bool    eof     = false;
+    size_t  budget  = IPC_READ_BUDGET;
+
+    while (budget > 0) {
+        if (client->rbuf.size () - client->rlen < IPC_READ_CHUNK) {
+            client->rbuf.resize (client->rlen + IPC_READ_CHUNK);
+        }
+
+        size_t  room  = client->rbuf.size () - client->rlen;
+        ssize_t count = read (fd, &client->rbuf[client->rlen], (room < budget) ? room : budget);
+        if (count > 0) {
+            client->rlen += count;
+            budget       -= count;
+            continue;
+        }
+
+        if (count == 0) {
+            eof = true;
+            break;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+
         return false;
     }
 
-    write(this->fd_sock, this->buff, len);
+    size_t offset = 0;
+    while (client->rlen - offset >= IPC_HEADER_SIZE) {
+        uint32_t len;
+        memcpy (&len, &client->rbuf[offset], IPC_HEADER_SIZE);
+
+        if (len > IPC_MAX_MESSAGE) {
+            return false;
+        }
+
+        if (client->rlen - offset - IPC_HEADER_SIZE < len) {
+            // Size the buffer for the whole frame once instead of growing it chunk by chunk.
+            if (client->rbuf.size () < IPC_HEADER_SIZE + len) {
+                memmove (&client->rbuf[0], &client->rbuf[offset], client->rlen - offset);
+                client->rlen -= offset;
+                offset = 0;
+                client->rbuf.resize (IPC_HEADER_SIZE + len);
+            }
+            break;
+        }
+
+        if (this->onMessage != NULL) {
+            this->onMessage (this, fd, &client->rbuf[offset + IPC_HEADER_SIZE], len, this->priv);
+            if (this->clients.find (fd) == this->clients.end ()) {
+                return true; /* closed from the callback */
+            }
+        }
+
+        offset += IPC_HEADER_SIZE + len;
+    }
+
+    if (offset > 0) {
+        memmove (&client->rbuf[0], &client->rbuf[offset], client->rlen - offset);
+        client->rlen -= offset;
+    }
+
+    if (client->rlen == 0 && client->rbuf.size () > IPC_READ_BUDGET) {
+        vector<unsigned char> (IPC_READ_CHUNK).swap (client->rbuf);
+    }
+
+    return !eof;
+}
+
+/*
+ * IPC_SEQPACKET counterpart of readClient. Readiness comes from epoll and
+ * each recvmmsg call then drains up to IPC_BATCH queued messages into the
+ * shared packet buffer, so there is no need to ask the kernel how much is
+ * pending beforehand.
+ */
+bool
+WiseIPC::readPackets (client_t* client) {
+    struct mmsghdr  hdrs[IPC_BATCH];
+    struct iovec    iov[IPC_BATCH];
+    int             fd      = client->fd;
+    size_t          budget  = IPC_READ_BUDGET;
+
+    if (this->packets.empty ()) {
+        this->packets.resize (IPC_BATCH * IPC_MAX_PACKET);
+    }
+
+    while (budget > 0) {
+        memset (hdrs, 0, sizeof (hdrs));
+        for (int i = 0; i < IPC_BATCH; i++) {
+            iov[i].iov_base = &this->packets[i * IPC_MAX_PACKET];
+            iov[i].iov_len  = IPC_MAX_PACKET;
+            hdrs[i].msg_hdr.msg_iov    = &iov[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int count = recvmmsg (fd, hdrs, IPC_BATCH, MSG_DONTWAIT, NULL);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true;
+            }
+
+            return false;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (hdrs[i].msg_len == 0 || (hdrs[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+                return false; /* hung up, or a message over IPC_MAX_PACKET */
+            }
+
+            if (this->onMessage != NULL) {
+                this->onMessage (this, fd, (unsigned char*) iov[i].iov_base, hdrs[i].msg_len, this->priv);
+                if (this->clients.find (fd) == this->clients.end ()) {
+                    return true; /* closed from the callback */
+                }
+            }
+
+            budget -= (hdrs[i].msg_len < budget) ? hdrs[i].msg_len : budget;
+        }
+
+        if (count < IPC_BATCH) {
+            return true;
+        }
+    }
+
+    return true;
+}
+
+bool
+WiseIPC::flushClient (client_t* client) {
+    if (this->mode == IPC_SEQPACKET) {
+        return this->flushPackets (client);
+    }
+
+    while (client->wpos < client->wbuf.size ()) {
+        ssize_t count = send (client->fd, &client->wbuf[client->wpos],
+                              client->wbuf.size () - client->wpos, MSG_NOSIGNAL);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            return false;
+        }
+
+        client->wpos += count;
+    }
+
+    if (client->wpos == client->wbuf.size ()) {
+        client->wbuf.clear ();
+        client->wpos = 0;
+    }
+
+    this->updateEvents (client);
+    return true;
+}
+
+/*
+ * Queued frames are stored length-prefixed in both modes; in IPC_SEQPACKET
+ * mode the prefix is only used to find the packet boundaries again.
+ */
+bool
+WiseIPC::flushPackets (client_t* client) {
+    struct iovec msgs[IPC_BATCH];
+
+    while (client->wpos < client->wbuf.size ()) {
+        int     count  = 0;
+        size_t  offset = client->wpos;
+
+        while (count < IPC_BATCH && offset < client->wbuf.size ()) {
+            uint32_t len;
+            memcpy (&len, &client->wbuf[offset], IPC_HEADER_SIZE);
+            msgs[count].iov_base = &client->wbuf[offset + IPC_HEADER_SIZE];
+            msgs[count].iov_len  = len;
+            offset += IPC_HEADER_SIZE + len;
+            count++;
+        }
+
+        int sent = sendPackets (client->fd, msgs, count);
+        if (sent == -1) {
+            return false;
+        }
+
+        for (int i = 0; i < sent; i++) {
+            client->wpos += IPC_HEADER_SIZE + msgs[i].iov_len;
+        }
+
+        if (sent < count) {
+            break;
+        }
+    }
+
+    if (client->wpos == client->wbuf.size ()) {
+        client->wbuf.clear ();
+        client->wpos = 0;
+    }
+
+    this->updateEvents (client);
     return true;
 }
 
 void
-WiseIPC::readMsg (int socket, unsigned int len) {
-    memset (this->buff, 0, len);
-    read (socket, this->buff, len);
+WiseIPC::updateEvents (client_t* client) {
+    struct epoll_event ev;
+    bool writing = !client->wbuf.empty ();
+
+    if (writing == client->writing) {
+        return;
+    }
+
+    ev.events  = EPOLLIN | (writing ? (uint32_t) EPOLLOUT : 0u);
+    ev.data.fd = client->fd;
+    epoll_ctl (this->fd_epoll, EPOLL_CTL_MOD, client->fd, &ev);
+    client->writing = writing;
+}
+
+/*
+ * Lay out [length, payload] iovec pairs for IPC_STREAM mode in the shared
+ * scratch vectors. Returns the number of iovecs.
+ */
+int
+WiseIPC::frameMsgs (const struct iovec* msgs, int count) {
+    this->lengths.resize (count);
+    this->iovs.resize (count * 2);
+
+    for (int i = 0; i < count; i++) {
+        this->lengths[i]            = msgs[i].iov_len;
+        this->iovs[i * 2].iov_base  = &this->lengths[i];
+        this->iovs[i * 2].iov_len   = IPC_HEADER_SIZE;
+        this->iovs[i * 2 + 1]       = msgs[i];
+    }
+
+    return count * 2;
+}
+
+void
+WiseIPC::closeClient (int fd) {
+    map<int, client_t*>::iterator it = this->clients.find (fd);
+    if (it == this->clients.end ()) {
+        return;
+    }
+
+    delete it->second;
+    this->clients.erase (it);
+
+    epoll_ctl (this->fd_epoll, EPOLL_CTL_DEL, fd, NULL);
+    close (fd);
+
+    if (this->onDisconnect != NULL) {
+        this->onDisconnect (this, fd, this->priv);
+    }
+}
+
+bool
+WiseIPC::sendMsg (int fd, const void* data, uint32_t len) {
+    struct iovec msg;
+
+    msg.iov_base = (void*) data;
+    msg.iov_len  = len;
+
+    return this->sendMsgs (fd, &msg, 1);
+}
+
+/*
+ * Server side send. Tries to hand the whole batch to the kernel in one
+ * call (sendmsg over the framed iovec chain, or sendmmsg in IPC_SEQPACKET
+ * mode) and only queues what it did not take; EPOLLOUT is armed while
+ * there is anything queued. Fails without queueing anything when the
+ * client already has too much pending.
+ */
+bool
+WiseIPC::sendMsgs (int fd, const struct iovec* msgs, int count) {
+    map<int, client_t*>::iterator it = this->clients.find (fd);
+    if (it == this->clients.end ()) {
+        return false;
+    }
+
+    client_t*   client  = it->second;
+    size_t      total   = 0;
+    int         sentMsgs = 0;
+    size_t      partial  = 0;   /* bytes of msgs[sentMsgs] frame already sent */
+
+    for (int i = 0; i < count; i++) {
+        if (msgs[i].iov_len > ((this->mode == IPC_SEQPACKET) ? IPC_MAX_PACKET : IPC_MAX_MESSAGE)) {
+            return false;
+        }
+        total += IPC_HEADER_SIZE + msgs[i].iov_len;
+    }
+
+    if (client->wbuf.size () - client->wpos + total > IPC_MAX_PENDING) {
+        return false;
+    }
+
+    if (client->wbuf.empty ()) {
+        if (this->mode == IPC_SEQPACKET) {
+            if ((sentMsgs = sendPackets (fd, msgs, count)) == -1) {
+                return false;
+            }
+        } else {
+            int     iovCount = this->frameMsgs (msgs, count);
+            ssize_t written;
+
+            while ((written = sendIov (fd, &this->iovs[0], (iovCount < IOV_MAX) ? iovCount : IOV_MAX)) == -1 && errno == EINTR);
+            if (written == -1) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                written = 0;
+            }
+
+            while (sentMsgs < count && (size_t) written >= IPC_HEADER_SIZE + msgs[sentMsgs].iov_len) {
+                written -= IPC_HEADER_SIZE + msgs[sentMsgs].iov_len;
+                sentMsgs++;
+            }
+            partial = written;
+        }
+
+        if (sentMsgs == count) {
+            return true;
+        }
+    }
+
+    for (int i = sentMsgs; i < count; i++) {
+        uint32_t             len     = msgs[i].iov_len;
+        const unsigned char* header  = (const unsigned char*) &len;
+        const unsigned char* payload = (const unsigned char*) msgs[i].iov_base;
+        size_t               skip    = (i == sentMsgs) ? partial : 0;
+
+        if (skip < IPC_HEADER_SIZE) {
+            client->wbuf.insert (client->wbuf.end (), header + skip, header + IPC_HEADER_SIZE);
+            client->wbuf.insert (client->wbuf.end (), payload, payload + len);
+        } else {
+            client->wbuf.insert (client->wbuf.end (), payload + (skip - IPC_HEADER_SIZE), payload + len);
+        }
+    }
+
+    this->updateEvents (client);
+    return true;
+}
+
+/*
+ * Server side send of one message gathered from parts, such as the chunks
+ * of a Json::OutputBuffer, so a large reply is never joined up first. What
+ * the kernel does not take is queued as with sendMsgs.
+ */
+bool
+WiseIPC::sendMsgv (int fd, const struct iovec* parts, int count) {
+    map<int, client_t*>::iterator it = this->clients.find (fd);
+    if (it == this->clients.end ()) {
+        return false;
+    }
+
+    client_t*   client  = it->second;
+    size_t      total   = 0;
+    size_t      written = 0;    /* bytes of the frame, header included, already sent */
+
+    for (int i = 0; i < count; i++) {
+        total += parts[i].iov_len;
+    }
+
+    if (total > ((this->mode == IPC_SEQPACKET) ? IPC_MAX_PACKET : IPC_MAX_MESSAGE) ||
+        client->wbuf.size () - client->wpos + IPC_HEADER_SIZE + total > IPC_MAX_PENDING) {
+        return false;
+    }
+
+    uint32_t len = total;
+
+    if (client->wbuf.empty ()) {
+        ssize_t sent;
+
+        if (this->mode == IPC_SEQPACKET) {
+            // One packet: the kernel takes all of it or nothing.
+            while ((sent = sendIov (fd, (struct iovec*) parts, count)) == -1 && errno == EINTR);
+            if (sent != -1) {
+                return true;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return false;
+            }
+        } else {
+            this->iovs.resize (count + 1);
+            this->iovs[0].iov_base = &len;
+            this->iovs[0].iov_len  = IPC_HEADER_SIZE;
+            copy (parts, parts + count, this->iovs.begin () + 1);
+
+            while ((sent = sendIov (fd, &this->iovs[0], (count + 1 < IOV_MAX) ? count + 1 : IOV_MAX)) == -1 && errno == EINTR);
+            if (sent == -1) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    return false;
+                }
+                sent = 0;
+            }
+
+            if ((size_t) sent == IPC_HEADER_SIZE + total) {
+                return true;
+            }
+            written = sent;
+        }
+    }
+
+    const unsigned char* header = (const unsigned char*) &len;
+
+    if (written < IPC_HEADER_SIZE) {
+        client->wbuf.insert (client->wbuf.end (), header + written, header + IPC_HEADER_SIZE);
+        written = 0;
+    } else {
+        written -= IPC_HEADER_SIZE;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const unsigned char* payload = (const unsigned char*) parts[i].iov_base;
+
+        if (written >= parts[i].iov_len) {
+            written -= parts[i].iov_len;
+            continue;
+        }
+        client->wbuf.insert (client->wbuf.end (), payload + written, payload + parts[i].iov_len);
+        written = 0;
+    }
+
+    this->updateEvents (client);
+    return true;
+}
+
+/*
+ * Send one message with a file descriptor attached (SCM_RIGHTS). Only
+ * possible while nothing is queued for the client, otherwise the
+ * descriptor could end up attached to the wrong frame.
+ */
+bool
+WiseIPC::sendFd (int client, int fd, const void* data, uint32_t len) {
+    map<int, client_t*>::iterator it = this->clients.find (client);
+    if (it == this->clients.end () || !it->second->wbuf.empty ()) {
+        return false;
+    }
+
+    struct msghdr   msg;
+    struct iovec    iov[2];
+    int             iovCount = 0;
+    union {
+        struct cmsghdr  align;
+        char            buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    if (this->mode == IPC_STREAM) {
+        iov[iovCount].iov_base = &len;
+        iov[iovCount].iov_len  = IPC_HEADER_SIZE;
+        iovCount++;
+    }
+    iov[iovCount].iov_base = (void*) data;
+    iov[iovCount].iov_len  = len;
+    iovCount++;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov        = iov;
+    msg.msg_iovlen     = iovCount;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy (CMSG_DATA(cmsg), &fd, sizeof (fd));
+
+    ssize_t written;
+    while ((written = sendmsg (client, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR);
+    if (written == -1) {
+        return false;
+    }
+
+    size_t total = (this->mode == IPC_STREAM) ? IPC_HEADER_SIZE + len : len;
+    if ((size_t) written < total) {
+        // The descriptor went out with the first byte, queue the rest as plain data.
+        client_t*            c       = it->second;
+        const unsigned char* header  = (const unsigned char*) &len;
+        const unsigned char* payload = (const unsigned char*) data;
+
+        if (written < (ssize_t) IPC_HEADER_SIZE) {
+            c->wbuf.insert (c->wbuf.end (), header + written, header + IPC_HEADER_SIZE);
+            c->wbuf.insert (c->wbuf.end (), payload, payload + len);
+        } else {
+            c->wbuf.insert (c->wbuf.end (), payload + (written - IPC_HEADER_SIZE), payload + len);
+        }
+        this->updateEvents (c);
+    }
+
+    return true;
+}
+
+/*
+ * Client side send, blocks until the whole message is written.
+ */
+bool
+WiseIPC::sendMsg (const void* data, uint32_t len) {
+    struct iovec msg;
+
+    msg.iov_base = (void*) data;
+    msg.iov_len  = len;
+
+    return this->sendMsgs (&msg, 1);
+}
+
+bool
+WiseIPC::sendMsgs (const struct iovec* msgs, int count) {
+    if (this->fd_sock == -1) {
+        return false;
+    }
+
+    if (this->mode == IPC_SEQPACKET) {
+        return sendPackets (this->fd_sock, msgs, count) == count;
+    }
+
+    int iovCount = this->frameMsgs (msgs, count);
+    return sendAll (this->fd_sock, &this->iovs[0], iovCount);
+}
+
+/*
+ * Client side receive, blocks until a whole frame arrived. Returns the
+ * payload length, or -1 when the connection is gone. When fd is given it
+ * receives a descriptor passed along with the message, or -1.
+ */
+int
+WiseIPC::readMsg (vector<unsigned char>& msg, int* fd) {
+    uint32_t len;
+    ssize_t  count;
+
+    if (fd != NULL) {
+        *fd = -1;
+    }
+
+    if (this->mode == IPC_SEQPACKET) {
+        msg.resize (IPC_MAX_PACKET);
+        while ((count = recvWithFd (this->fd_sock, &msg[0], IPC_MAX_PACKET, fd)) == -1 && errno == EINTR);
+        if (count <= 0) {
+            return -1;
+        }
+
+        msg.resize (count);
+        return count;
+    }
+
+    // A passed descriptor rides on the first byte of its frame.
+    while ((count = recvWithFd (this->fd_sock, &len, IPC_HEADER_SIZE, fd)) == -1 && errno == EINTR);
+    if (count <= 0 || !readFull (this->fd_sock, (unsigned char*) &len + count, IPC_HEADER_SIZE - count) ||
+        len > IPC_MAX_MESSAGE) {
+        return -1;
+    }
+
+    msg.resize (len);
+    if (len > 0 && !readFull (this->fd_sock, &msg[0], len)) {
+        return -1;
+    }
+
+    return len;
 }
 
 int
 WiseIPC::setServer () {
-    if ( (this->fd_sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+    if ( (this->fd_sock = socket(AF_UNIX, (this->mode == IPC_SEQPACKET) ? SOCK_SEQPACKET : SOCK_STREAM, 0)) == -1) {
         return ERROR_OPEN_SOCKET;
     }
-    
+
     memset(&this->addr, 0, sizeof(this->addr));
     this->addr.sun_family = AF_UNIX;
     strncpy(this->addr.sun_path, this->socketPath.c_str(), sizeof(this->addr.sun_path) - 1);
@@ -69,19 +901,30 @@ WiseIPC::setServer () {
         return ERROR_BIND_SOCKET;
     }
 
-    if (listen(this->fd_sock, 5) == -1) {
+    if (setNonBlocking (this->fd_sock) == -1 || listen(this->fd_sock, SOMAXCONN) == -1) {
         return ERROR_LISTEN_SOCKET;
     }
 
+    if ((this->fd_epoll = epoll_create (IPC_MAX_EVENTS)) == -1) {
+        return ERROR_EPOLL;
+    }
+
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = this->fd_sock;
+    if (epoll_ctl (this->fd_epoll, EPOLL_CTL_ADD, this->fd_sock, &ev) == -1) {
+        return ERROR_EPOLL;
+    }
+
 	return SUCCESS;
 }
 
 int
 WiseIPC::setClient () {
-    if ( (this->fd_sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+    if ( (this->fd_sock = socket(AF_UNIX, (this->mode == IPC_SEQPACKET) ? SOCK_SEQPACKET : SOCK_STREAM, 0)) == -1) {
         return ERROR_OPEN_SOCKET;
     }
-    
+
     memset(&this->addr, 0, sizeof(this->addr));
     this->addr.sun_family = AF_UNIX;
     strncpy(this->addr.sun_path, this->socketPath.c_str(), sizeof(this->addr.sun_path) - 1);
@@ -90,11 +933,19 @@ WiseIPC::setClient () {
 }
 
 int
-WiseIPC::getUnreadDataLength () {
-	int error;
-	int value = 0;
-	
-	error = ioctl (this->fd_sock, SIOCINQ, &value);
-	
-	return value;
+WiseIPC::getSocket () {
+    return this->fd_sock;
+}
+
+int
+WiseIPC::getClientCount () {
+    return this->clients.size ();
+}
+
+/*
+ * Largest payload one message can carry in this mode.
+ */
+uint32_t
+WiseIPC::maxMessage () {
+    return (this->mode == IPC_SEQPACKET) ? IPC_MAX_PACKET : IPC_MAX_MESSAGE;
 }